@@ -0,0 +1,52 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  hardware/gpio.h
+
+Host stand-in for the Pico SDK GPIO functions, only the outputs the mock
+buses watch do anything.  Inputs only have edge interrupts, the harness raises
+an edge with host_gpio_raise_edge() and the raw handlers added for the pin run
+if the edge is enabled.
+
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/irq.h"
+
+void gpio_put(uint32_t gpio, bool value);
+
+enum gpio_dir {
+	GPIO_IN = 0,
+	GPIO_OUT = 1
+};
+
+enum gpio_irq_level {
+	GPIO_IRQ_EDGE_FALL = 0x4,
+	GPIO_IRQ_EDGE_RISE = 0x8
+};
+
+void gpio_init(uint32_t gpio);
+void gpio_set_dir(uint32_t gpio, bool out);
+void gpio_add_raw_irq_handler(uint32_t gpio, void (*handler)(void));
+void gpio_set_irq_enabled(uint32_t gpio, uint32_t events, bool enabled);
+uint32_t gpio_get_irq_event_mask(uint32_t gpio);
+void gpio_acknowledge_irq(uint32_t gpio, uint32_t events);
+
+//Harness side, latches a rising edge on the pin and runs its handlers if it is enabled
+void host_gpio_raise_edge(uint32_t gpio);
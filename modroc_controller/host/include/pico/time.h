@@ -0,0 +1,62 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pico/time.h
+
+Host stand-in for the Pico SDK time functions, driven by host_clock_set().
+Repeating timers run from the clock moving past them, the way the alarm
+interrupt would preempt the flight loop.
+
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint64_t absolute_time_t;
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+	int64_t delay_us;
+	uint64_t due_time;
+	repeating_timer_callback_t callback;
+	void *user_data;
+	repeating_timer_t *next;  //Running timers
+};
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t time);
+
+//The period runs from one call to the next, a negative delay is the same here
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+	repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+//Harness side, moves the virtual clock
+void host_clock_set(uint64_t time_us);
+
+/* Host side stand-in for a peripheral's completion interrupt, the callback runs
+   once the clock reaches due_time.  It can move the alarm's due_time on and
+   return true to run again, the alarm is dropped when it returns false.
+*/
+void host_add_alarm(uint64_t due_time, repeating_timer_callback_t callback, void *user_data,
+	repeating_timer_t *out);
@@ -0,0 +1,41 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pico/util/queue.h
+
+Host stand-in for the Pico SDK queue, a plain ring buffer since the replay
+harness runs both sides on one thread.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+	uint8_t *data;
+	uint32_t element_size;
+	uint32_t element_count;  //One more than it holds so full and empty differ
+	uint32_t write_index;
+	uint32_t read_index;
+} queue_t;
+
+void queue_init(queue_t *q, unsigned int element_size, unsigned int element_count);
+bool queue_try_add(queue_t *q, const void *data);
+bool queue_try_remove(queue_t *q, void *data);
+
+//Nothing else can empty the queue, so a full one ends the replay
+void queue_add_blocking(queue_t *q, const void *data);
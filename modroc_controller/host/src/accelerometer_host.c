@@ -0,0 +1,102 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  accelerometer_host.c
+
+Host version of the accelerometer interface for kinematics.c.  The single
+accelerometer reads back the trace's acceleration records, each update takes
+the latest one at or before the virtual clock.
+
+*/
+
+#include "pico/stdlib.h"
+#include "accelerometer.h"
+#include "accelerometer_host.h"
+
+static const Trace_t *host_trace = NULL;
+static bool initialized = false;
+static size_t trace_index;  //Of the record in sample
+static Accelerometer_Sample_t sample;
+
+void accelerometer_host_set_trace(const Trace_t *trace)
+{
+	host_trace = trace;
+}
+
+Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin)
+{
+	(void)spi;
+	(void)chip_select;
+	(void)interrupt_pin;
+	Error_Returns to_return = RPi_NotInitialized;
+	if (!initialized && (host_trace != NULL) && (host_trace->acceleration_count > 0))
+	{
+		initialized = true;
+		*id = 0;
+		to_return = accelerometer_reset(*id);
+	}
+	return to_return;
+}
+
+Error_Returns accelerometer_reset(uint32_t id)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (initialized && (id == 0))
+	{
+		trace_index = 0;
+		sample.sequence = 0;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns accelerometer_update(uint32_t id)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (initialized && (id == 0))
+	{
+		const Trace_Acceleration_t *records = host_trace->accelerations;
+		uint64_t now = time_us_64();
+		size_t index = trace_index;
+		
+		while (((index + 1) < host_trace->acceleration_count) && (records[index + 1].time_stamp <= now))
+		{
+			index++;
+		}
+		if ((records[index].time_stamp <= now) && ((index != trace_index) || (sample.sequence == 0)))
+		{
+			sample.acceleration[0] = records[index].acceleration[0];
+			sample.acceleration[1] = records[index].acceleration[1];
+			sample.acceleration[2] = records[index].acceleration[2];
+			sample.time_stamp = (uint32_t)records[index].time_stamp;
+			sample.sequence++;
+			trace_index = index;
+		}
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns accelerometer_get_sample(uint32_t id, Accelerometer_Sample_t *sample_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (initialized && (id == 0))
+	{
+		*sample_ptr = sample;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
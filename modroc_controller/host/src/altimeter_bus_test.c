@@ -0,0 +1,322 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altimeter_bus_test.c
+
+Runs the altimeter over four simulated BME280s, two on each of i2c0 and i2c1,
+and checks how their asynchronous reads share the buses.
+
+Every chip converts on the same schedule from the same trace, so each wants its
+read on the same loop pass as the other on its bus.  get_filtered_readings()
+starts from the next barometer every pass, which has to put each chip at the
+head of its bus's queue about half the time rather than leave one always
+waiting behind the other.  With the barometers alternating between buses the
+rotation is even, each bus's pair swaps places every other pass.  Reads on the
+two buses have to overlap on the virtual clock.
+
+Each new sample's time stamp has to sit in the middle of the window the driver
+knows the conversion finished in.  The chip model says when the conversion the
+read latched really finished, the error against that is checked on average
+and at its worst.
+
+With --freeze the last chip stops converting when the ascent profile goes on
+but keeps answering with its last conversion.  The driver may only take a few
+repeats of it as new samples, and the altimeter has to drop it within
+BUS_TEST_FREEZE_BOUND and carry on with the other three.  Its times aren't
+checked once it is frozen, nor its bus's sharing.
+
+Exits with EXIT_FAILURE if any of those checks fail.
+
+    altimeter_bus_test <trace> [--freeze]
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "altimeter.h"
+#include "barometer.h"
+#include "bme280.h"
+#include "bme280_sim.h"
+#include "i2c_async_host.h"
+#include "mock_i2c.h"
+#include "trace.h"
+
+#define BUS_TEST_BAROMETERS		4
+#define BUS_TEST_ADC_HUMIDITY	0x6A00
+#define BUS_TEST_LOOP_PERIOD	500  //In microseconds
+#define BUS_TEST_PHASE_TIME		10000000  //On each sampling profile, in microseconds
+#define BUS_TEST_MINIMUM_SHARE	4  //Each chip is at least a quarter of its bus's queued reads
+/* The driver only knows a conversion finished between two reads, with the
+   later one's transfer on top.  Reads are a loop pass apart at most once one is
+   expected, so the time stamp is within half a pass and a transfer of the
+   truth, and within a transfer on average.
+*/
+#define BUS_TEST_MEAN_BOUND		250  //In microseconds
+#define BUS_TEST_ERROR_BOUND	(BUS_TEST_LOOP_PERIOD / 2 + 250)
+#define BUS_TEST_FROZEN			(BUS_TEST_BAROMETERS - 1)  //The chip --freeze stops
+//The conversion it finished before it froze, if it wasn't read yet, and the repeats the driver takes
+#define BUS_TEST_FROZEN_SAMPLES	(1 + BME280_MAXIMUM_REPEATS)
+//Five stale spells of ten ascent periods, and the repeats the driver takes first
+#define BUS_TEST_FREEZE_BOUND	1000000  //In microseconds
+
+typedef struct Bus_Test_Source_S {
+	const Trace_t *trace;
+	size_t index;
+} Bus_Test_Source_t;
+
+typedef struct Bus_Test_Barometer_S {
+	i2c_inst_t *i2c;
+	uint8_t address;
+} Bus_Test_Barometer_t;
+
+//Alternating between the buses, see the top of the file
+static const Bus_Test_Barometer_t barometer_layout[BUS_TEST_BAROMETERS] = {
+	{i2c0, MOCK_I2C_ADDRESS},
+	{i2c1, MOCK_I2C_ADDRESS},
+	{i2c0, MOCK_I2C_SECOND_ADDRESS},
+	{i2c1, MOCK_I2C_SECOND_ADDRESS}
+};
+
+typedef struct Bus_Test_Timing_S {
+	uint32_t sample_count;
+	double total_error;  //Sample time less the true conversion time, in microseconds
+	int64_t maximum_error;  //Largest magnitude
+} Bus_Test_Timing_t;
+
+//Same as the replay's, the air is what the last trace sample at or before time says
+static void read_trace(void *context, uint64_t time, BME280_Sim_Reading_t *reading)
+{
+	Bus_Test_Source_t *source = (Bus_Test_Source_t *)context;
+	const Trace_t *trace = source->trace;
+	
+	while ((source->index > 0) && (trace->samples[source->index].time_stamp > time))
+	{
+		source->index--;
+	}
+	while (((source->index + 1) < trace->sample_count) && (trace->samples[source->index + 1].time_stamp <= time))
+	{
+		source->index++;
+	}
+	reading->adc_pressure = (int32_t)trace->samples[source->index].adc_pressure;
+	reading->adc_temperature = (int32_t)trace->samples[source->index].adc_temperature;
+	reading->adc_humidity = BUS_TEST_ADC_HUMIDITY;
+}
+
+//Checks the time stamp of each new sample from the first count chips against when they really converted
+static void check_sample_times(const uint32_t *barometer_ids, uint32_t count, uint32_t *last_times,
+	Bus_Test_Timing_t *timing)
+{
+	for (uint32_t index = 0; index < count; index++)
+	{
+		uint32_t sample_time;
+		if ((barometer_get_sample_time(barometer_ids[index], &sample_time) != RPi_Success) ||
+			(sample_time == last_times[index]))
+		{
+			continue;
+		}
+		last_times[index] = sample_time;
+		
+		//Nothing has read the chip since the sample was latched, the model still has its conversion
+		bme280_sim_select(index);
+		int64_t error = (int64_t)sample_time - (int64_t)(uint32_t)bme280_sim_get_conversion_time();
+		timing->sample_count++;
+		timing->total_error += (double)error;
+		if (llabs(error) > llabs(timing->maximum_error))
+		{
+			timing->maximum_error = error;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int to_return = EXIT_FAILURE;
+	Trace_t trace;
+	
+	do
+	{
+		const char *trace_path = NULL;
+		bool freeze = false;
+		for (int index = 1; index < argc; index++)
+		{
+			if (strcmp(argv[index], "--freeze") == 0)
+			{
+				freeze = true;
+			}
+			else
+			{
+				trace_path = argv[index];
+			}
+		}
+		if (trace_path == NULL)
+		{
+			printf("usage: %s <trace> [--freeze]\n", argv[0]);
+			break;
+		}
+		if (!trace_load(trace_path, &trace))
+		{
+			break;
+		}
+		
+		Bus_Test_Source_t sources[BUS_TEST_BAROMETERS];
+		uint32_t barometer_ids[BUS_TEST_BAROMETERS];
+		Error_Returns status = RPi_Success;
+		host_clock_set(trace.samples[0].time_stamp);
+		for (uint32_t index = 0; (index < BUS_TEST_BAROMETERS) && (status == RPi_Success); index++)
+		{
+			const Bus_Test_Barometer_t *layout_ptr = &barometer_layout[index];
+			sources[index].trace = &trace;
+			sources[index].index = 0;
+			bme280_sim_select(index);
+			bme280_sim_init(trace.calibration, trace.humidity_calibration, read_trace, &sources[index]);
+			if ((index > 0) && !mock_i2c_attach(layout_ptr->i2c, layout_ptr->address, index))
+			{
+				status = RPi_InvalidParam;  //Chip 0 is on i2c0 already
+				break;
+			}
+			status = barometer_init(&barometer_ids[index], layout_ptr->i2c, layout_ptr->address);
+		}
+		if (status == RPi_Success)
+		{
+			status = altimeter_initialize(barometer_ids, BUS_TEST_BAROMETERS);
+		}
+		if (status != RPi_Success)
+		{
+			printf("altimeter_bus_test: initialization failed: %u\n", status);
+			break;
+		}
+		
+		//The pad profile, then the ascent one's faster conversions
+		Bus_Test_Timing_t timing;
+		memset(&timing, 0, sizeof(timing));
+		uint32_t last_times[BUS_TEST_BAROMETERS] = {0};
+		uint64_t start_time = trace.samples[0].time_stamp;
+		uint64_t end_time = start_time + (2 * BUS_TEST_PHASE_TIME);
+		uint64_t freeze_time = 0;
+		uint64_t drop_time = 0;
+		uint32_t frozen_samples = 0;
+		uint32_t checked_count = BUS_TEST_BAROMETERS;
+		bool ascent = false;
+		for (uint64_t now = start_time; (now < end_time) && (status == RPi_Success); now += BUS_TEST_LOOP_PERIOD)
+		{
+			host_clock_set(now);
+			if (!ascent && ((now - start_time) >= BUS_TEST_PHASE_TIME))
+			{
+				status = altimeter_set_sampling_profile(barometer_profile_ascent);
+				ascent = true;
+				if (freeze)
+				{
+					bme280_sim_select(BUS_TEST_FROZEN);
+					bme280_sim_freeze();
+					freeze_time = now;
+					checked_count = BUS_TEST_FROZEN;
+				}
+			}
+			if (status == RPi_Success)
+			{
+				status = altimeter_update_altitude();
+			}
+			if ((freeze_time != 0) && (drop_time == 0) && (altimeter_get_barometer_count() < BUS_TEST_BAROMETERS))
+			{
+				drop_time = now;
+			}
+			uint32_t frozen_time;
+			if ((freeze_time != 0) &&
+				(barometer_get_sample_time(barometer_ids[BUS_TEST_FROZEN], &frozen_time) == RPi_Success) &&
+				(frozen_time != last_times[BUS_TEST_FROZEN]))
+			{
+				last_times[BUS_TEST_FROZEN] = frozen_time;
+				frozen_samples++;
+			}
+			check_sample_times(barometer_ids, checked_count, last_times, &timing);
+		}
+		if (status != RPi_Success)
+		{
+			printf("altimeter_bus_test: update failed: %u\n", status);
+			break;
+		}
+		
+		printf("altimeter_bus_test: %s, %u barometers on i2c0 and i2c1\n", trace_path, BUS_TEST_BAROMETERS);
+		for (uint32_t index = 0; index < BUS_TEST_BAROMETERS; index++)
+		{
+			const Bus_Test_Barometer_t *layout_ptr = &barometer_layout[index];
+			printf("barometer %u  i2c%u 0x%02X  %6u reads, %6u queued\n", index, i2c_hw_index(layout_ptr->i2c),
+				layout_ptr->address, i2c_async_host_get_read_count(layout_ptr->i2c, layout_ptr->address),
+				i2c_async_host_get_queued_count(layout_ptr->i2c, layout_ptr->address));
+		}
+		double mean_error = timing.sample_count ? (timing.total_error / timing.sample_count) : 0.0;
+		printf("%u reads overlapped the other bus\n", i2c_async_host_get_overlap_count());
+		printf("%u samples, time stamp error mean %.1f us, maximum %lld us\n", timing.sample_count, mean_error,
+			(long long)timing.maximum_error);
+		if (freeze)
+		{
+			printf("barometer %u froze, %u new samples after, dropped %.3f s later, %u barometers left\n",
+				BUS_TEST_FROZEN, frozen_samples, drop_time ? (drop_time - freeze_time) / 1e6 : -1.0,
+				altimeter_get_barometer_count());
+		}
+		
+		to_return = EXIT_SUCCESS;
+		if (freeze && ((drop_time == 0) || ((drop_time - freeze_time) > BUS_TEST_FREEZE_BOUND) ||
+			(altimeter_get_barometer_count() != BUS_TEST_FROZEN)))
+		{
+			printf("altimeter_bus_test: the frozen barometer wasn't dropped within %d us, or others were\n",
+				BUS_TEST_FREEZE_BOUND);
+			to_return = EXIT_FAILURE;
+		}
+		if (freeze && (frozen_samples > BUS_TEST_FROZEN_SAMPLES))
+		{
+			printf("altimeter_bus_test: the frozen barometer's repeats were taken as new samples\n");
+			to_return = EXIT_FAILURE;
+		}
+		for (uint32_t index = 0; index < BUS_TEST_BAROMETERS; index++)
+		{
+			if (freeze && ((index % 2) == (BUS_TEST_FROZEN % 2)))
+			{
+				continue;  //Its bus is left to the other chip once it is dropped
+			}
+			//The other chip on the bus is two slots on
+			const Bus_Test_Barometer_t *layout_ptr = &barometer_layout[index];
+			const Bus_Test_Barometer_t *other_ptr = &barometer_layout[(index + 2) % BUS_TEST_BAROMETERS];
+			uint32_t queued = i2c_async_host_get_queued_count(layout_ptr->i2c, layout_ptr->address);
+			uint32_t bus_queued = queued + i2c_async_host_get_queued_count(other_ptr->i2c, other_ptr->address);
+			if ((bus_queued == 0) || ((queued * BUS_TEST_MINIMUM_SHARE) < bus_queued))
+			{
+				printf("altimeter_bus_test: barometer %u waited behind the other on its bus %u times of %u\n",
+					index, queued, bus_queued);
+				to_return = EXIT_FAILURE;
+			}
+		}
+		if (i2c_async_host_get_overlap_count() == 0)
+		{
+			printf("altimeter_bus_test: the buses never transferred at the same time\n");
+			to_return = EXIT_FAILURE;
+		}
+		if ((timing.sample_count == 0) || (fabs(mean_error) > BUS_TEST_MEAN_BOUND) ||
+			(llabs(timing.maximum_error) > BUS_TEST_ERROR_BOUND))
+		{
+			printf("altimeter_bus_test: sample times are off the conversions by more than %d us on average"
+				" or %d us at worst\n", BUS_TEST_MEAN_BOUND, BUS_TEST_ERROR_BOUND);
+			to_return = EXIT_FAILURE;
+		}
+		
+		trace_free(&trace);
+	} while(0);
+	
+	return to_return;
+}
@@ -0,0 +1,622 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altimeter_replay.c
+
+Replays a barometer trace through the altimeter on the host and reports what
+it cost and how well it did.
+
+The simulated BME280 in bme280_sim.c measures the trace's raw ADC samples on
+the virtual clock with the timing, filtering and resolution its registers are
+set up for, so the real bme280.c, barometer.c and altimeter.c run unchanged and
+see the chip they would in flight.  flight_monitor.c is linked in too, each loop
+pass is a pass of its flight loop, with its logging timers run off the virtual
+clock and its messages drained the way the output task would.  A trace's
+acceleration records are played through the accelerometer kinematics.c reads,
+so its samples reach the altimeter's estimator too.  With --spi
+the chip is set up on the mock SPI bus instead of I2C, and --bus-errors fails
+that many transactions per million once the chip is set up.  The wall clock
+time of the replay is reported as loop passes per second for benchmarking.
+
+--record writes each published altitude to a file with the estimator's
+velocity at the time, one "<sequence> <time us> <altitude mm> <velocity mm/s>"
+line apiece.  --compare reads one back and checks this replay's against it, a
+replay built with another Kalman backend on the same trace and options has to
+publish the same altitudes to within BACKEND_ERROR_BOUND, and BACKEND_RMS_BOUND
+overall, and estimate the same velocities to within BACKEND_VELOCITY_ERROR_BOUND
+and BACKEND_VELOCITY_RMS_BOUND.
+
+Exits with EXIT_FAILURE if an SPI transfer went without the bus lock, if the
+altitude was converted other than once per published altitude, if, with no
+bus errors injected, any chip conversion wasn't read as exactly one new
+sample, or if the altitudes or velocities being compared disagree.
+
+    altimeter_replay_<backend> <trace> [--hypsometric] [--spi] [--loop-us <period>]
+        [--bus-errors <per million>] [--record <altitudes>] [--compare <altitudes>]
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "accelerometer.h"
+#include "accelerometer_host.h"
+#include "altimeter.h"
+#include "barometer.h"
+#include "bme280.h"
+#include "bme280_sim.h"
+#include "bme280_compensation.h"
+#include "flight_monitor.h"
+#include "kalman_math.h"
+#include "kinematics.h"
+#include "message.h"
+#include "mock_i2c.h"
+#include "mock_spi.h"
+#include "profile_host.h"
+#include "thermometer.h"
+#include "trace.h"
+
+#define DEFAULT_LOOP_PERIOD		500  //In microseconds
+#define REPLAY_ADC_HUMIDITY		0x6A00  //Traces don't carry humidity, a steady mid range reading
+/* How far apart Kalman backends can be on the same samples, in millimeters.
+   Fixed point's rounding only shows while the pressure filters chase liftoff,
+   about 0.3 m there on the synthetic flights, and is a few millimeters rms.
+   Its velocity drifts up to about 0.3 m/s from double's through the boost,
+   less than 0.1 m/s rms.
+*/
+#define BACKEND_ERROR_BOUND		500
+#define BACKEND_RMS_BOUND		20
+#define BACKEND_VELOCITY_ERROR_BOUND	500  //In millimeters/second
+#define BACKEND_VELOCITY_RMS_BOUND		150
+#define REFERENCE_MISSING		INT32_MIN
+
+#if KALMAN_BACKEND == KALMAN_BACKEND_DOUBLE
+#define BACKEND_NAME "double"
+#elif KALMAN_BACKEND == KALMAN_BACKEND_FLOAT
+#define BACKEND_NAME "float"
+#else
+#define BACKEND_NAME "fixed"
+#endif
+
+#if BME280_COMPENSATION == BME280_COMPENSATION_32BIT
+#define COMPENSATION_NAME "32 bit"
+#else
+#define COMPENSATION_NAME "64 bit"
+#endif
+
+typedef struct Detection_S {
+	bool found;
+	uint64_t time_stamp;  //In microseconds
+	int32_t altitude;  //In millimeters, filtered altitude when found
+} Detection_t;
+
+typedef struct Replay_Results_S {
+	Detection_t ready;
+	Detection_t liftoff;
+	Detection_t apogee;
+	Detection_t landing;
+	uint32_t ascent_log_count;
+	uint32_t descent_log_count;
+	double last_humidity;  //In percent relative humidity, from the last descent log
+	double squared_error;  //In millimeters squared
+	int32_t maximum_error;  //In millimeters
+	uint32_t error_count;
+	double squared_difference;  //From the reference altitudes, in millimeters squared
+	int32_t maximum_difference;  //In millimeters
+	uint32_t difference_count;
+	double squared_velocity_difference;  //In millimeters/second squared
+	int32_t maximum_velocity_difference;  //In millimeters/second
+	uint32_t missing_count;  //Published here but not in the reference, or the other way round
+} Replay_Results_t;
+
+//Altitudes and velocities recorded by another replay, indexed by sequence number
+typedef struct Replay_Reference_S {
+	int32_t *altitudes;  //In millimeters, REFERENCE_MISSING where none was recorded
+	int32_t *velocities;  //In millimeters/second
+	uint32_t count;
+} Replay_Reference_t;
+
+typedef struct Replay_Source_S {
+	const Trace_t *trace;
+	size_t index;  //Of the last sample measured, the chip measures forward in time
+} Replay_Source_t;
+
+//Source for the simulated chip, the air is what the last trace sample at or before time says
+static void read_trace(void *context, uint64_t time, BME280_Sim_Reading_t *reading)
+{
+	Replay_Source_t *source = (Replay_Source_t *)context;
+	const Trace_t *trace = source->trace;
+	
+	while ((source->index > 0) && (trace->samples[source->index].time_stamp > time))
+	{
+		source->index--;
+	}
+	while (((source->index + 1) < trace->sample_count) && (trace->samples[source->index + 1].time_stamp <= time))
+	{
+		source->index++;
+	}
+	reading->adc_pressure = (int32_t)trace->samples[source->index].adc_pressure;
+	reading->adc_temperature = (int32_t)trace->samples[source->index].adc_temperature;
+	reading->adc_humidity = REPLAY_ADC_HUMIDITY;
+}
+
+static bool load_reference(const char *path, Replay_Reference_t *reference)
+{
+	bool to_return = false;
+	uint32_t capacity = 0;
+	unsigned int sequence;
+	unsigned long long time_stamp;
+	int altitude;
+	int velocity;
+	
+	memset(reference, 0, sizeof(Replay_Reference_t));
+	FILE *input = fopen(path, "r");
+	do
+	{
+		if (input == NULL)
+		{
+			printf("altimeter_replay: can't open %s\n", path);
+			break;
+		}
+		
+		to_return = true;
+		while (to_return && (fscanf(input, "%u %llu %d %d", &sequence, &time_stamp, &altitude, &velocity) == 4))
+		{
+			if (sequence >= capacity)
+			{
+				uint32_t new_capacity = capacity ? (capacity * 2) : 1024;
+				new_capacity = (sequence >= new_capacity) ? (sequence + 1) : new_capacity;
+				int32_t *altitudes = realloc(reference->altitudes, new_capacity * sizeof(int32_t));
+				if (altitudes != NULL)
+				{
+					reference->altitudes = altitudes;
+				}
+				int32_t *velocities = realloc(reference->velocities, new_capacity * sizeof(int32_t));
+				if (velocities != NULL)
+				{
+					reference->velocities = velocities;
+				}
+				if ((altitudes == NULL) || (velocities == NULL))
+				{
+					to_return = false;
+					break;
+				}
+				for (uint32_t index = capacity; index < new_capacity; index++)
+				{
+					altitudes[index] = REFERENCE_MISSING;
+				}
+				capacity = new_capacity;
+			}
+			reference->altitudes[sequence] = altitude;
+			reference->velocities[sequence] = velocity;
+			reference->count = (sequence >= reference->count) ? (sequence + 1) : reference->count;
+		}
+		
+		if (!to_return || !feof(input) || (reference->count == 0))
+		{
+			printf("altimeter_replay: %s isn't a list of recorded altitudes and velocities\n", path);
+			to_return = false;
+		}
+	} while(0);
+	
+	if (input != NULL)
+	{
+		fclose(input);
+	}
+	return to_return;
+}
+
+static void compare_altitude(Replay_Reference_t *reference, Replay_Results_t *results, const Altimeter_Altitude_t *altitude,
+	int32_t velocity)
+{
+	if ((altitude->sequence >= reference->count) || (reference->altitudes[altitude->sequence] == REFERENCE_MISSING))
+	{
+		results->missing_count++;
+	}
+	else
+	{
+		int32_t difference = altitude->altitude - reference->altitudes[altitude->sequence];
+		results->squared_difference += (double)difference * difference;
+		results->maximum_difference = (abs(difference) > results->maximum_difference) ? abs(difference) :
+			results->maximum_difference;
+		results->difference_count++;
+		
+		difference = velocity - reference->velocities[altitude->sequence];
+		results->squared_velocity_difference += (double)difference * difference;
+		results->maximum_velocity_difference = (abs(difference) > results->maximum_velocity_difference) ?
+			abs(difference) : results->maximum_velocity_difference;
+		reference->altitudes[altitude->sequence] = REFERENCE_MISSING;  //Used up
+	}
+}
+
+//Counts the reference altitudes this replay never published
+static void count_unmatched(const Replay_Reference_t *reference, Replay_Results_t *results)
+{
+	for (uint32_t sequence = 0; sequence < reference->count; sequence++)
+	{
+		results->missing_count += (reference->altitudes[sequence] != REFERENCE_MISSING);
+	}
+}
+
+static double get_wall_time()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+static void detect(Detection_t *detection, uint64_t now)
+{
+	if (!detection->found)
+	{
+		Altimeter_Altitude_t altitude;
+		altimeter_get_altitude(&altitude);
+		detection->found = true;
+		detection->time_stamp = now;
+		detection->altitude = altitude.altitude;
+	}
+}
+
+//Follows the flight monitor's phase changes, the flight monitor itself tests for them
+static void track_flight_phase(Flight_Phase *phase_ptr, Replay_Results_t *results, uint64_t now)
+{
+	Flight_Phase phase = flight_monitor_get_phase();
+	
+	if (altimeter_is_ready())
+	{
+		detect(&results->ready, now);
+	}
+	if (phase != *phase_ptr)
+	{
+		switch (phase)
+		{
+			case phase_ascent:
+				detect(&results->liftoff, now);
+				break;
+			case phase_descent:
+				detect(&results->apogee, now);
+				break;
+			case phase_ground_idle:
+				detect(&results->landing, now);
+				break;
+			default:
+				break;
+		}
+		*phase_ptr = phase;
+	}
+}
+
+/* Drains the messages the output task would print, the flight monitor's log
+   lines are printed with the time they were sent.
+*/
+static void drain_messages(Replay_Results_t *results)
+{
+	Intertask_Param_Message_t param_entry;
+	Log_Message_t log_entry;
+	
+	while (message_log_get_params(&param_entry))
+	{
+		if (param_entry.message_type == message_log_descent_parameters)
+		{
+			results->last_humidity = param_entry.message.log_descent_parameters.humidity;
+			results->descent_log_count++;
+		}
+		else
+		{
+			results->ascent_log_count++;
+		}
+	}
+	while (message_get_log(&log_entry))
+	{
+		printf("%9.3f s: %s", log_entry.time_stamp / 1e3, log_entry.log_message);
+	}
+}
+
+static void report_detection(const char *name, const Detection_t *detection, bool has_truth,
+	uint64_t true_time, int32_t true_altitude)
+{
+	printf("%-20s", name);
+	if (!detection->found)
+	{
+		printf(" not detected\n");
+	}
+	else if (has_truth)
+	{
+		printf(" at %9.3f s, latency %8.1f ms, altitude error %8.3f m\n", detection->time_stamp / 1e6,
+			((int64_t)detection->time_stamp - (int64_t)true_time) / 1e3,
+			(detection->altitude - true_altitude) / 1e3);
+	}
+	else
+	{
+		printf(" at %9.3f s, altitude %8.3f m\n", detection->time_stamp / 1e6, detection->altitude / 1e3);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int to_return = EXIT_FAILURE;
+	const char *trace_path = NULL;
+	bool hypsometric = false;
+	bool spi = false;
+	uint32_t bus_errors = 0;
+	uint64_t loop_period = DEFAULT_LOOP_PERIOD;
+	const char *record_path = NULL;
+	const char *compare_path = NULL;
+	FILE *record = NULL;
+	Replay_Reference_t reference = {NULL, 0};
+	Trace_t trace;
+	
+	for (int index = 1; index < argc; index++)
+	{
+		if (strcmp(argv[index], "--hypsometric") == 0)
+		{
+			hypsometric = true;
+		}
+		else if (strcmp(argv[index], "--spi") == 0)
+		{
+			spi = true;
+		}
+		else if ((strcmp(argv[index], "--loop-us") == 0) && ((index + 1) < argc))
+		{
+			loop_period = strtoull(argv[++index], NULL, 0);
+		}
+		else if ((strcmp(argv[index], "--bus-errors") == 0) && ((index + 1) < argc))
+		{
+			bus_errors = (uint32_t)strtoul(argv[++index], NULL, 0);
+		}
+		else if ((strcmp(argv[index], "--record") == 0) && ((index + 1) < argc))
+		{
+			record_path = argv[++index];
+		}
+		else if ((strcmp(argv[index], "--compare") == 0) && ((index + 1) < argc))
+		{
+			compare_path = argv[++index];
+		}
+		else
+		{
+			trace_path = argv[index];
+		}
+	}
+	
+	do
+	{
+		if ((trace_path == NULL) || (loop_period == 0))
+		{
+			printf("usage: %s <trace> [--hypsometric] [--spi] [--loop-us <period>] [--bus-errors <per million>]"
+				" [--record <altitudes>] [--compare <altitudes>]\n", argv[0]);
+			break;
+		}
+		
+		if ((compare_path != NULL) && !load_reference(compare_path, &reference))
+		{
+			break;
+		}
+		if ((record_path != NULL) && ((record = fopen(record_path, "w")) == NULL))
+		{
+			printf("altimeter_replay: can't write %s\n", record_path);
+			break;
+		}
+		
+		if (!trace_load(trace_path, &trace))
+		{
+			break;
+		}
+		
+		Replay_Source_t source = {&trace, 0};
+		bme280_sim_init(trace.calibration, trace.humidity_calibration, read_trace, &source);
+		accelerometer_host_set_trace(&trace);
+		host_clock_set(trace.samples[0].time_stamp);
+		message_init();
+		
+		uint32_t barometer_id;
+		Error_Returns status = spi ? barometer_init_spi(&barometer_id, spi0, MOCK_SPI_CHIP_SELECT) :
+			barometer_init(&barometer_id, i2c0, MOCK_I2C_ADDRESS);
+		if (status == RPi_Success)
+		{
+			status = altimeter_initialize(&barometer_id, 1);
+		}
+		if (status == RPi_Success)
+		{
+			//Same chip the way hardware_platform.c sets it up
+			status = spi ? thermometer_init_spi(spi0, MOCK_SPI_CHIP_SELECT) : thermometer_init(i2c0, MOCK_I2C_ADDRESS);
+		}
+		uint32_t accelerometer_id = 0;
+		if (status == RPi_Success)
+		{
+			//A trace without accelerations is flown with no accelerometer fitted
+			uint32_t accelerometer_count = (accelerometer_init(&accelerometer_id, spi0, 0, 0) == RPi_Success) ? 1 : 0;
+			status = kinematics_initialize(&accelerometer_id, accelerometer_count);
+		}
+		if (status != RPi_Success)
+		{
+			printf("altimeter_replay: initialization failed: %u\n", status);
+			break;
+		}
+		altimeter_set_altitude_model(hypsometric ? altitude_model_hypsometric : altitude_model_standard);
+		bme280_sim_set_error_rate(bus_errors);
+		
+		Replay_Results_t results;
+		memset(&results, 0, sizeof(results));
+		Flight_Phase phase = phase_initial;
+		size_t sample_index = 0;
+		uint32_t last_sequence = 0;
+		uint32_t raw_log_count = 0;
+		uint32_t raw_batches_dropped = 0;
+		Barometer_Raw_Batch raw_batch;
+		uint64_t end_time = trace.samples[trace.sample_count - 1].time_stamp;
+		
+		status = RPi_Success;
+		uint32_t loop_count = 0;
+		double wall_start = get_wall_time();
+		for (uint64_t now = trace.samples[0].time_stamp; (now <= end_time) && (status == RPi_Success); now += loop_period)
+		{
+			while (((sample_index + 1) < trace.sample_count) && (trace.samples[sample_index + 1].time_stamp <= now))
+			{
+				sample_index++;
+			}
+			host_clock_set(now);
+			loop_count++;
+			
+			status = flight_monitor_update();
+			track_flight_phase(&phase, &results, now);
+			drain_messages(&results);
+			
+			//Drain and compensate the raw ascent log the way the output task on core 1 does
+			while (barometer_get_raw_batch(barometer_id, &raw_batch))
+			{
+				uint32_t pressure;
+				int32_t temperature;
+				for (uint32_t index = 0; index < raw_batch.count; index++)
+				{
+					barometer_compensate_raw_sample(barometer_id, &raw_batch.samples[index], &pressure, &temperature);
+				}
+				raw_log_count += raw_batch.count;
+				raw_batches_dropped += raw_batch.dropped;
+			}
+			
+			//Score each new altitude against the truth for the sample it came from
+			Altimeter_Altitude_t altitude;
+			altimeter_get_altitude(&altitude);
+			if (altimeter_is_ready() && (altitude.sequence != last_sequence) && trace.samples[sample_index].has_altitude)
+			{
+				int32_t error = altitude.altitude - trace.samples[sample_index].altitude;
+				results.squared_error += (double)error * error;
+				results.maximum_error = (abs(error) > results.maximum_error) ? abs(error) : results.maximum_error;
+				results.error_count++;
+			}
+			if (altitude.sequence != last_sequence)
+			{
+				Altimeter_State_t state;
+				altimeter_get_state(&state);
+				if (record != NULL)
+				{
+					fprintf(record, "%u %llu %d %d\n", altitude.sequence, (unsigned long long)now, altitude.altitude,
+						state.velocity);
+				}
+				if (reference.count > 0)
+				{
+					compare_altitude(&reference, &results, &altitude, state.velocity);
+				}
+			}
+			last_sequence = altitude.sequence;
+		}
+		double wall_time = get_wall_time() - wall_start;
+		
+		if (status != RPi_Success)
+		{
+			printf("altimeter_replay: flight_monitor_update failed: %u\n", status);
+			break;
+		}
+		
+		printf("altimeter_replay: %s, %s Kalman backend, %s pressure compensation, %s model, %s\n", trace_path,
+			BACKEND_NAME, COMPENSATION_NAME, hypsometric ? "hypsometric" : "standard", spi ? "SPI" : "I2C");
+		printf("%zu samples over %.1f s, loop period %llu us, %u conversions, %u %s transactions\n",
+			trace.sample_count, (end_time - trace.samples[0].time_stamp) / 1e6, (unsigned long long)loop_period,
+			altimeter_get_conversion_count(), spi ? mock_spi_get_transaction_count() : mock_i2c_get_transaction_count(),
+			spi ? "SPI" : "I2C");
+		printf("%u ascent logs, %u descent logs, last descent humidity %.1f%%\n", results.ascent_log_count,
+			results.descent_log_count, results.last_humidity);
+		printf("%u raw samples logged during ascent, %u batches dropped\n", raw_log_count, raw_batches_dropped);
+		Accelerometer_Sample_t acceleration;
+		if (accelerometer_get_sample(accelerometer_id, &acceleration) == RPi_Success)
+		{
+			printf("%u accelerometer samples of %zu\n", acceleration.sequence, trace.acceleration_count);
+		}
+		printf("%u chip conversions, %u read as new samples, %u altitudes published\n",
+			bme280_sim_get_conversion_count(), altimeter_get_sample_count(), last_sequence);
+		printf("%u bus errors injected, %u loop passes in %.3f s, %.0f loop passes/s\n\n",
+			bme280_sim_get_error_count(), loop_count, wall_time, loop_count / wall_time);
+		profile_report(stdout);
+		printf("\n");
+		
+		if (results.error_count > 0)
+		{
+			printf("altitude error       rms %8.3f m, maximum %8.3f m over %u samples\n",
+				sqrt(results.squared_error / results.error_count) / 1e3, results.maximum_error / 1e3,
+				results.error_count);
+		}
+		report_detection("ready", &results.ready, false, 0, 0);
+		report_detection("liftoff", &results.liftoff, false, 0, 0);
+		report_detection("apogee", &results.apogee, trace.has_apogee, trace.apogee_time, trace.apogee_altitude);
+		report_detection("landing", &results.landing, trace.has_landing, trace.landing_time, 0);
+		if (reference.count > 0)
+		{
+			count_unmatched(&reference, &results);
+			printf("backend difference   rms %8.3f m, maximum %8.3f m over %u altitudes, %u unmatched,"
+				" bounds %.3f m rms, %.3f m\n",
+				results.difference_count ? (sqrt(results.squared_difference / results.difference_count) / 1e3) : 0.0,
+				results.maximum_difference / 1e3, results.difference_count, results.missing_count,
+				BACKEND_RMS_BOUND / 1e3, BACKEND_ERROR_BOUND / 1e3);
+			printf("velocity difference  rms %8.3f m/s, maximum %8.3f m/s, bounds %.3f m/s rms, %.3f m/s\n",
+				results.difference_count ?
+					(sqrt(results.squared_velocity_difference / results.difference_count) / 1e3) : 0.0,
+				results.maximum_velocity_difference / 1e3, BACKEND_VELOCITY_RMS_BOUND / 1e3,
+				BACKEND_VELOCITY_ERROR_BOUND / 1e3);
+		}
+		
+		trace_free(&trace);
+		free(reference.altitudes);
+		free(reference.velocities);
+		if (record != NULL)
+		{
+			fclose(record);
+		}
+		if (mock_spi_get_lock_error_count() != 0)
+		{
+			printf("altimeter_replay: %u SPI transfers without the bus lock\n", mock_spi_get_lock_error_count());
+			break;
+		}
+		//Each published altitude costs one conversion, readers never add any
+		if (altimeter_get_conversion_count() != last_sequence)
+		{
+			printf("altimeter_replay: %u conversions for %u altitudes published\n", altimeter_get_conversion_count(),
+				last_sequence);
+			break;
+		}
+		/* Without bus errors every conversion the chip made should be read once, as
+		   a new sample, bar the ones in a longer run of repeats than the driver takes
+		   from a working chip.
+		*/
+		uint32_t expected_samples = bme280_sim_get_conversion_count() -
+			bme280_sim_get_repeat_count(BME280_MAXIMUM_REPEATS + 1);
+		if ((bus_errors == 0) && (altimeter_get_sample_count() != expected_samples))
+		{
+			printf("altimeter_replay: %u new samples read for %u chip conversions, %u expected\n",
+				altimeter_get_sample_count(), bme280_sim_get_conversion_count(), expected_samples);
+			break;
+		}
+		if ((reference.count > 0) && ((results.difference_count == 0) || (results.missing_count != 0) ||
+			(results.maximum_difference > BACKEND_ERROR_BOUND) ||
+			(results.squared_difference > ((double)BACKEND_RMS_BOUND * BACKEND_RMS_BOUND * results.difference_count))))
+		{
+			printf("altimeter_replay: altitudes differ from %s\n", compare_path);
+			break;
+		}
+		if ((reference.count > 0) && ((results.maximum_velocity_difference > BACKEND_VELOCITY_ERROR_BOUND) ||
+			(results.squared_velocity_difference >
+				((double)BACKEND_VELOCITY_RMS_BOUND * BACKEND_VELOCITY_RMS_BOUND * results.difference_count))))
+		{
+			printf("altimeter_replay: velocities differ from %s\n", compare_path);
+			break;
+		}
+		to_return = EXIT_SUCCESS;
+	} while(0);
+	
+	return to_return;
+}
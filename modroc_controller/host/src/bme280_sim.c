@@ -0,0 +1,389 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_sim.c
+
+The BME280 model described in bme280_sim.h.  The chip is brought up to date
+lazily, every register access first runs the conversions the virtual clock has
+passed since the last one, so it costs nothing while the driver isn't looking.
+
+*/
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "bme280_sim.h"
+
+#define BME280_SIM_REGISTER_COUNT		256
+#define BME280_SIM_CALIBRATION_REGISTER	0x88
+#define BME280_SIM_HUMIDITY_CALIBRATION_REGISTER	0xE1
+#define BME280_SIM_CHIP_ID_REGISTER		0xD0
+#define BME280_SIM_RESET_REGISTER		0xE0
+#define BME280_SIM_CTRL_HUMIDITY_REGISTER	0xF2
+#define BME280_SIM_STATUS_REGISTER		0xF3
+#define BME280_SIM_CTRL_MEASURE_REGISTER	0xF4
+#define BME280_SIM_CONFIG_REGISTER		0xF5
+#define BME280_SIM_PRESSURE_REGISTER	0xF7
+#define BME280_SIM_TEMPERATURE_REGISTER	0xFA
+#define BME280_SIM_HUMIDITY_REGISTER	0xFD
+#define BME280_SIM_REPEAT_BYTES			(BME280_SIM_HUMIDITY_REGISTER - BME280_SIM_PRESSURE_REGISTER)
+
+#define BME280_SIM_CHIP_ID				0x60
+#define BME280_SIM_RESET_WORD			0xB6
+#define BME280_SIM_MEASURING_BIT		0x08
+#define BME280_SIM_CONFIG_RESERVED_BIT	0x02
+#define BME280_SIM_SKIPPED_HUMIDITY		0x8000
+
+#define BME280_SIM_MODE_MASK			0x03
+#define BME280_SIM_SLEEP_MODE			0x00
+#define BME280_SIM_NORMAL_MODE			0x03  //01 and 10 are both forced mode
+#define BME280_SIM_OVERSAMPLE_MASK		0x07
+#define BME280_SIM_TEMPERATURE_SHIFT	5
+#define BME280_SIM_PRESSURE_SHIFT		2
+#define BME280_SIM_STANDBY_SHIFT		5
+#define BME280_SIM_FILTER_SHIFT			2
+#define BME280_SIM_OVERSAMPLE_LIMIT		5  //Settings above 16x are 16x
+
+//Datasheet typical measurement time, in microseconds
+#define BME280_SIM_MEASURE_BASE_TIME		1000
+#define BME280_SIM_MEASURE_OVERSAMPLE_TIME	2000
+#define BME280_SIM_MEASURE_SETUP_TIME		500
+
+#define BME280_SIM_ADC_BITS				20
+#define BME280_SIM_MINIMUM_BITS			16  //Resolution at 1x with the filter off
+#define BME280_SIM_CATCH_UP_CONVERSIONS	32  //Older conversions are counted but not run, the filter has settled
+#define BME280_SIM_MILLION				1000000
+#define BME280_SIM_REPEAT_RUNS			8  //Longer runs of identical conversions are counted with this one
+
+typedef struct BME280_Sim_S {
+	uint8_t registers[BME280_SIM_REGISTER_COUNT];
+	uint8_t ctrl_humidity;  //The one in use, ctrl_hum is only taken on a ctrl_meas write
+	uint64_t measure_start;  //Of the conversion running or next to run, in microseconds
+	uint32_t measure_time;  //In microseconds
+	uint32_t cycle_time;  //Measurement and standby in normal mode, in microseconds
+	bool filter_seeded;
+	double filtered_pressure;
+	double filtered_temperature;
+	BME280_Sim_Source source;
+	void *context;
+	uint32_t conversion_count;
+	uint64_t conversion_time;  //End of the one in the data registers
+	bool frozen;  //Data registers stopped updating
+	uint32_t repeat_run;  //Conversions in a row the same as the one before
+	uint32_t repeat_counts[BME280_SIM_REPEAT_RUNS];  //Conversions by how far into a run they were
+	uint32_t errors_per_million;
+	uint32_t forced_errors;
+	uint64_t error_seed;
+	uint32_t error_count;
+} BME280_Sim_t;
+
+static BME280_Sim_t chips[BME280_SIM_CHIP_COUNT];
+static BME280_Sim_t *chip = &chips[0];  //Selected by the bus
+
+//In microseconds, indexed by t_sb
+static const uint32_t standby_times[] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+
+static uint32_t get_mode()
+{
+	return chip->registers[BME280_SIM_CTRL_MEASURE_REGISTER] & BME280_SIM_MODE_MASK;
+}
+
+//An osrs field as a shift, 0 for 1x up to 4 for 16x, -1 when the measurement is skipped
+static int32_t get_oversample_shift(uint32_t setting)
+{
+	setting &= BME280_SIM_OVERSAMPLE_MASK;
+	if (setting > BME280_SIM_OVERSAMPLE_LIMIT)
+	{
+		setting = BME280_SIM_OVERSAMPLE_LIMIT;
+	}
+	return (int32_t)setting - 1;
+}
+
+static uint32_t get_oversample_time(int32_t shift, uint32_t setup_time)
+{
+	return (shift < 0) ? 0 : (BME280_SIM_MEASURE_OVERSAMPLE_TIME << shift) + setup_time;
+}
+
+static uint32_t get_filter_coefficient()
+{
+	uint32_t setting = (chip->registers[BME280_SIM_CONFIG_REGISTER] >> BME280_SIM_FILTER_SHIFT) & BME280_SIM_OVERSAMPLE_MASK;
+	return 1 << ((setting > 4) ? 4 : setting);
+}
+
+static void store_long(uint8_t register_address, int32_t value)
+{
+	chip->registers[register_address] = (uint8_t)(value >> 12);
+	chip->registers[register_address + 1] = (uint8_t)(value >> 4);
+	chip->registers[register_address + 2] = (uint8_t)((value << 4) & 0xF0);
+}
+
+//Filters a 20 bit reading the way config asks and drops the bits the oversampling doesn't resolve
+static int32_t filter_reading(double *filtered, int32_t reading, int32_t shift, uint32_t coefficient)
+{
+	int32_t to_return = reading;
+	if (coefficient > 1)
+	{
+		*filtered = chip->filter_seeded ? ((*filtered * (coefficient - 1)) + reading) / coefficient : reading;
+		to_return = (int32_t)(*filtered + 0.5);
+	}
+	else
+	{
+		*filtered = reading;
+		to_return &= ~((1 << (BME280_SIM_ADC_BITS - BME280_SIM_MINIMUM_BITS - shift)) - 1);
+	}
+	return to_return;
+}
+
+//One conversion, measuring at time, into the data registers
+static void convert(uint64_t time)
+{
+	uint8_t ctrl_measure = chip->registers[BME280_SIM_CTRL_MEASURE_REGISTER];
+	int32_t temperature_shift = get_oversample_shift(ctrl_measure >> BME280_SIM_TEMPERATURE_SHIFT);
+	int32_t pressure_shift = get_oversample_shift(ctrl_measure >> BME280_SIM_PRESSURE_SHIFT);
+	int32_t humidity_shift = get_oversample_shift(chip->ctrl_humidity);
+	uint32_t coefficient = get_filter_coefficient();
+	BME280_Sim_Reading_t reading;
+	
+	if (chip->frozen)
+	{
+		return;
+	}
+	chip->source(chip->context, time, &reading);
+	
+	int32_t pressure = BME280_SIM_SKIPPED;
+	int32_t temperature = BME280_SIM_SKIPPED;
+	int32_t humidity = BME280_SIM_SKIPPED_HUMIDITY;
+	if (temperature_shift >= 0)
+	{
+		temperature = filter_reading(&chip->filtered_temperature, reading.adc_temperature, temperature_shift, coefficient);
+	}
+	if (pressure_shift >= 0)
+	{
+		pressure = filter_reading(&chip->filtered_pressure, reading.adc_pressure, pressure_shift, coefficient);
+	}
+	if (humidity_shift >= 0)
+	{
+		humidity = reading.adc_humidity & 0xFFFF;  //No filter on humidity
+	}
+	chip->filter_seeded = true;
+	
+	uint8_t previous[BME280_SIM_REPEAT_BYTES];
+	memcpy(previous, &chip->registers[BME280_SIM_PRESSURE_REGISTER], sizeof(previous));
+	store_long(BME280_SIM_PRESSURE_REGISTER, pressure);
+	store_long(BME280_SIM_TEMPERATURE_REGISTER, temperature);
+	
+	//Pressure and temperature the same as last time, humidity isn't always read
+	bool repeat = (chip->conversion_count > 0) &&
+		(memcmp(previous, &chip->registers[BME280_SIM_PRESSURE_REGISTER], sizeof(previous)) == 0);
+	chip->repeat_run = repeat ? chip->repeat_run + 1 : 0;
+	chip->repeat_counts[(chip->repeat_run < BME280_SIM_REPEAT_RUNS) ? chip->repeat_run : BME280_SIM_REPEAT_RUNS - 1]++;
+	chip->registers[BME280_SIM_HUMIDITY_REGISTER] = (uint8_t)(humidity >> 8);
+	chip->registers[BME280_SIM_HUMIDITY_REGISTER + 1] = (uint8_t)humidity;
+	chip->conversion_time = chip->measure_start + chip->measure_time;
+	chip->conversion_count++;
+}
+
+//Runs the conversions that have finished by now
+static void update(uint64_t now)
+{
+	while ((get_mode() != BME280_SIM_SLEEP_MODE) && ((chip->measure_start + chip->measure_time) <= now))
+	{
+		if (get_mode() != BME280_SIM_NORMAL_MODE)
+		{
+			//Forced mode, one conversion and back to sleep
+			convert(chip->measure_start + (chip->measure_time / 2));
+			chip->registers[BME280_SIM_CTRL_MEASURE_REGISTER] &= ~BME280_SIM_MODE_MASK;
+			break;
+		}
+		
+		uint64_t behind = (now - chip->measure_start) / chip->cycle_time;
+		if (behind > BME280_SIM_CATCH_UP_CONVERSIONS)
+		{
+			behind -= BME280_SIM_CATCH_UP_CONVERSIONS;
+			chip->measure_start += behind * chip->cycle_time;
+			chip->conversion_count += (uint32_t)behind;
+		}
+		convert(chip->measure_start + (chip->measure_time / 2));
+		chip->measure_start += chip->cycle_time;
+	}
+}
+
+//A ctrl_meas write takes ctrl_hum and starts measuring straight away in forced or normal mode
+static void start_measuring(uint64_t now, uint8_t ctrl_measure)
+{
+	if (get_mode() == BME280_SIM_SLEEP_MODE)
+	{
+		chip->filter_seeded = false;  //The next conversion starts the filter over
+	}
+	chip->registers[BME280_SIM_CTRL_MEASURE_REGISTER] = ctrl_measure;
+	chip->ctrl_humidity = chip->registers[BME280_SIM_CTRL_HUMIDITY_REGISTER] & BME280_SIM_OVERSAMPLE_MASK;
+	chip->measure_time = BME280_SIM_MEASURE_BASE_TIME +
+		get_oversample_time(get_oversample_shift(ctrl_measure >> BME280_SIM_TEMPERATURE_SHIFT), 0) +
+		get_oversample_time(get_oversample_shift(ctrl_measure >> BME280_SIM_PRESSURE_SHIFT), BME280_SIM_MEASURE_SETUP_TIME) +
+		get_oversample_time(get_oversample_shift(chip->ctrl_humidity), BME280_SIM_MEASURE_SETUP_TIME);
+	chip->cycle_time = chip->measure_time +
+		standby_times[chip->registers[BME280_SIM_CONFIG_REGISTER] >> BME280_SIM_STANDBY_SHIFT];
+	chip->measure_start = now;
+}
+
+//Power on values, the calibration is in NVM and survives a reset
+static void reset()
+{
+	uint8_t calibration[BME280_SIM_CALIBRATION_BYTES];
+	uint8_t humidity_calibration[BME280_SIM_HUMIDITY_CALIBRATION_BYTES];
+	
+	memcpy(calibration, &chip->registers[BME280_SIM_CALIBRATION_REGISTER], sizeof(calibration));
+	memcpy(humidity_calibration, &chip->registers[BME280_SIM_HUMIDITY_CALIBRATION_REGISTER], sizeof(humidity_calibration));
+	memset(chip->registers, 0, sizeof(chip->registers));
+	memcpy(&chip->registers[BME280_SIM_CALIBRATION_REGISTER], calibration, sizeof(calibration));
+	memcpy(&chip->registers[BME280_SIM_HUMIDITY_CALIBRATION_REGISTER], humidity_calibration, sizeof(humidity_calibration));
+	
+	chip->registers[BME280_SIM_CHIP_ID_REGISTER] = BME280_SIM_CHIP_ID;
+	store_long(BME280_SIM_PRESSURE_REGISTER, BME280_SIM_SKIPPED);
+	store_long(BME280_SIM_TEMPERATURE_REGISTER, BME280_SIM_SKIPPED);
+	chip->registers[BME280_SIM_HUMIDITY_REGISTER] = (uint8_t)(BME280_SIM_SKIPPED_HUMIDITY >> 8);
+	chip->ctrl_humidity = 0;
+	chip->filter_seeded = false;
+}
+
+void bme280_sim_select(uint32_t index)
+{
+	if (index < BME280_SIM_CHIP_COUNT)
+	{
+		chip = &chips[index];
+	}
+}
+
+void bme280_sim_init(const uint8_t *calibration, const uint8_t *humidity_calibration,
+	BME280_Sim_Source source, void *context)
+{
+	memset(chip, 0, sizeof(BME280_Sim_t));
+	memcpy(&chip->registers[BME280_SIM_CALIBRATION_REGISTER], calibration, BME280_SIM_CALIBRATION_BYTES);
+	memcpy(&chip->registers[BME280_SIM_HUMIDITY_CALIBRATION_REGISTER], humidity_calibration,
+		BME280_SIM_HUMIDITY_CALIBRATION_BYTES);
+	chip->source = source;
+	chip->context = context;
+	chip->error_seed = 1;
+	reset();
+}
+
+uint8_t bme280_sim_read_register(uint8_t register_address)
+{
+	uint64_t now = time_us_64();
+	uint8_t to_return = 0;
+	
+	update(now);
+	if (register_address == BME280_SIM_STATUS_REGISTER)
+	{
+		bool measuring = (get_mode() != BME280_SIM_SLEEP_MODE) && (now >= chip->measure_start);
+		to_return = measuring ? BME280_SIM_MEASURING_BIT : 0;
+	}
+	else if (register_address != BME280_SIM_RESET_REGISTER)
+	{
+		to_return = chip->registers[register_address];
+	}
+	return to_return;
+}
+
+void bme280_sim_write_register(uint8_t register_address, uint8_t value)
+{
+	uint64_t now = time_us_64();
+	
+	update(now);
+	switch (register_address)
+	{
+		case BME280_SIM_RESET_REGISTER:
+			if (value == BME280_SIM_RESET_WORD)
+			{
+				reset();
+			}
+			break;
+		case BME280_SIM_CTRL_HUMIDITY_REGISTER:
+			chip->registers[register_address] = value;
+			break;
+		case BME280_SIM_CTRL_MEASURE_REGISTER:
+			start_measuring(now, value);
+			break;
+		case BME280_SIM_CONFIG_REGISTER:
+			//The datasheet says config writes in normal mode may be ignored, here they always are
+			if (get_mode() != BME280_SIM_NORMAL_MODE)
+			{
+				chip->registers[register_address] = value & ~BME280_SIM_CONFIG_RESERVED_BIT;
+			}
+			break;
+		default:
+			break;  //Read only
+	}
+}
+
+void bme280_sim_set_error_rate(uint32_t errors_per_million)
+{
+	chip->errors_per_million = errors_per_million;
+}
+
+void bme280_sim_fail_transactions(uint32_t count)
+{
+	chip->forced_errors = count;
+}
+
+bool bme280_sim_bus_error()
+{
+	bool to_return = false;
+	if (chip->forced_errors > 0)
+	{
+		chip->forced_errors--;
+		to_return = true;
+	}
+	else if (chip->errors_per_million > 0)
+	{
+		//xorshift64, the same sequence every run
+		chip->error_seed ^= chip->error_seed << 13;
+		chip->error_seed ^= chip->error_seed >> 7;
+		chip->error_seed ^= chip->error_seed << 17;
+		to_return = (chip->error_seed % BME280_SIM_MILLION) < chip->errors_per_million;
+	}
+	chip->error_count += to_return;
+	return to_return;
+}
+
+uint32_t bme280_sim_get_error_count()
+{
+	return chip->error_count;
+}
+
+uint32_t bme280_sim_get_conversion_count()
+{
+	return chip->conversion_count;
+}
+
+uint64_t bme280_sim_get_conversion_time()
+{
+	return chip->conversion_time;
+}
+
+void bme280_sim_freeze()
+{
+	chip->frozen = true;
+}
+
+uint32_t bme280_sim_get_repeat_count(uint32_t run)
+{
+	uint32_t to_return = 0;
+	for (uint32_t index = run; index < BME280_SIM_REPEAT_RUNS; index++)
+	{
+		to_return += chip->repeat_counts[index];
+	}
+	return to_return;
+}
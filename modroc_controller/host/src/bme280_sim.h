@@ -0,0 +1,91 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_sim.h
+
+Register level model of a BME280 for the host buses.  It has the chip's
+register map, the calibration at 0x88-0xA1 and 0xE1-0xE7, chip ID, reset,
+the ctrl_hum/status/ctrl_meas/config registers and the 0xF7-0xFE data burst.
+Sleep, forced and normal modes convert on the virtual clock with the
+datasheet's typical measurement times and standby times, the measuring bit in
+status is set while a conversion runs, and the IIR filter and the output
+resolution follow the config and oversampling settings.  Each conversion takes
+its raw ADC values from a source callback at the time it measures, so a trace
+is seen the way the chip would have seen the air.
+
+There are BME280_SIM_CHIP_COUNT chips, all the calls below are on the one last
+selected, chip 0 until another is.  mock_i2c.c and mock_spi.c select the chip
+they address, put it on their buses and ask it before every transaction
+whether to fail it, for testing the driver's error handling.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BME280_SIM_CALIBRATION_BYTES			26  //0x88 to 0xA1
+#define BME280_SIM_HUMIDITY_CALIBRATION_BYTES	7  //0xE1 to 0xE7
+#define BME280_SIM_SKIPPED						0x80000  //Data register value of a measurement that is turned off
+#define BME280_SIM_CHIP_COUNT					4
+
+//What the chip's ADCs would read, pressure and temperature are 20 bits and humidity 16
+typedef struct BME280_Sim_Reading_S {
+	int32_t adc_pressure;
+	int32_t adc_temperature;
+	int32_t adc_humidity;
+} BME280_Sim_Reading_t;
+
+//Fills in the reading for a conversion measuring at time, in microseconds of the virtual clock
+typedef void (*BME280_Sim_Source)(void *context, uint64_t time, BME280_Sim_Reading_t *reading);
+
+void bme280_sim_select(uint32_t index);
+
+//Powers the chip up in sleep mode with the calibration given
+void bme280_sim_init(const uint8_t *calibration, const uint8_t *humidity_calibration,
+	BME280_Sim_Source source, void *context);
+
+uint8_t bme280_sim_read_register(uint8_t register_address);
+
+void bme280_sim_write_register(uint8_t register_address, uint8_t value);
+
+/* Bus errors, a rate in failed transactions per million, drawn from a fixed
+   seed so a run repeats, and a number of transactions to fail straight away.
+*/
+void bme280_sim_set_error_rate(uint32_t errors_per_million);
+
+void bme280_sim_fail_transactions(uint32_t count);
+
+//Called by the buses at the start of each transaction, true when it is to fail
+bool bme280_sim_bus_error();
+
+uint32_t bme280_sim_get_error_count();
+
+//Conversions the chip has finished since start up, read or not
+uint32_t bme280_sim_get_conversion_count();
+
+//When the conversion in the data registers finished, in microseconds, 0 before the first
+uint64_t bme280_sim_get_conversion_time();
+
+/* The chip stops converting but keeps answering, every read from then on gets
+   the conversion already in the data registers.
+*/
+void bme280_sim_freeze();
+
+/* Conversions whose pressure and temperature came out the same as at least run
+   conversions in a row before them, up to runs of 7.
+*/
+uint32_t bme280_sim_get_repeat_count(uint32_t run);
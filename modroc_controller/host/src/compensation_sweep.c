@@ -0,0 +1,129 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  compensation_sweep.c
+
+Compares the BME280's 32 bit pressure compensation against the 64 bit one
+over calibrations spread across the ranges real parts come with, and over the
+whole temperature and pressure range the chip is specified for.  Exits with a
+failure if the 32 bit version is ever further out than the bound.
+
+    bme280_compensation_sweep [<calibrations>]
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bme280_compensation.h"
+
+#define DEFAULT_CALIBRATIONS	1000
+#define ERROR_BOUND				1000  //In pascals x 100, about 0.8 m at sea level
+#define ADC_MAXIMUM				((1 << 20) - 1)
+#define ADC_TEMPERATURE_STEPS	64
+#define ADC_PRESSURE_STEPS		512
+#define TEMPERATURE_MINIMUM		-4000  //Hundredths of a degree C, the chip's operating range
+#define TEMPERATURE_MAXIMUM		8500
+#define PRESSURE_MINIMUM		3000000  //Pascals x 100
+#define PRESSURE_MAXIMUM		11000000
+
+typedef struct Coefficient_Range_S {
+	int32_t minimum;
+	int32_t maximum;
+} Coefficient_Range;
+
+//dig_T1 to dig_P9, spanning the values seen in parts and Bosch's examples
+static const Coefficient_Range coefficient_ranges[] = {
+	{26000, 29500}, {25000, 28000}, {-1000, 1000},
+	{34000, 39000}, {-11500, -10000}, {2800, 3300}, {2500, 9500}, {-300, 300},
+	{-10, -5}, {9500, 16000}, {-15000, -10000}, {4000, 6500}
+};
+
+static uint32_t random_state = 1;
+
+static int32_t random_between(int32_t minimum, int32_t maximum)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return minimum + (int32_t)((random_state >> 8) % (uint32_t)(maximum - minimum + 1));
+}
+
+static void random_calibration(BME280_Calibration *calibration_ptr)
+{
+	unsigned char pressure_trim[BME280_PRESSURE_TRIM_BYTES];
+	unsigned char humidity_trim[BME280_HUMIDITY_TRIM_BYTES] = {0};
+	
+	for (uint32_t index = 0; index < (BME280_PRESSURE_TRIM_BYTES / 2); index++)
+	{
+		int32_t value = random_between(coefficient_ranges[index].minimum, coefficient_ranges[index].maximum);
+		pressure_trim[index * 2] = (unsigned char)value;
+		pressure_trim[(index * 2) + 1] = (unsigned char)(value >> 8);
+	}
+	bme280_calibration_unpack(calibration_ptr, pressure_trim, 0, humidity_trim);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t calibration_count = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEFAULT_CALIBRATIONS;
+	uint64_t point_count = 0;
+	double squared_error = 0.0;
+	int32_t maximum_error = 0;
+	int32_t maximum_error_pressure = 0;
+	int32_t maximum_error_temperature = 0;
+	BME280_Calibration calibration;
+	
+	for (uint32_t calibration_index = 0; calibration_index < calibration_count; calibration_index++)
+	{
+		random_calibration(&calibration);
+		for (int32_t adc_T = 0; adc_T <= ADC_MAXIMUM; adc_T += ADC_MAXIMUM / ADC_TEMPERATURE_STEPS)
+		{
+			int32_t t_fine = 0;
+			int32_t temperature = bme280_compensate_temperature(&calibration, adc_T, &t_fine);
+			if ((temperature <= TEMPERATURE_MINIMUM) || (temperature >= TEMPERATURE_MAXIMUM))
+			{
+				continue;
+			}
+			
+			for (int32_t adc_P = 0; adc_P <= ADC_MAXIMUM; adc_P += ADC_MAXIMUM / ADC_PRESSURE_STEPS)
+			{
+				int32_t reference = (int32_t)bme280_compensate_pressure_64bit(&calibration, adc_P, t_fine);
+				if ((reference <= PRESSURE_MINIMUM) || (reference >= PRESSURE_MAXIMUM))
+				{
+					continue;
+				}
+				
+				int32_t error = (int32_t)bme280_compensate_pressure_32bit(&calibration, adc_P, t_fine) - reference;
+				squared_error += (double)error * error;
+				point_count++;
+				if (abs(error) > abs(maximum_error))
+				{
+					maximum_error = error;
+					maximum_error_pressure = reference;
+					maximum_error_temperature = temperature;
+				}
+			}
+		}
+	}
+	
+	printf("bme280_compensation_sweep: %u calibrations, %llu points\n", calibration_count,
+		(unsigned long long)point_count);
+	if (point_count > 0)
+	{
+		printf("32 bit pressure error  rms %6.3f Pa, maximum %6.2f Pa at %.2f hPa and %.2f C, bound %.2f Pa\n",
+			sqrt(squared_error / point_count) / 100.0, maximum_error / 100.0, maximum_error_pressure / 10000.0,
+			maximum_error_temperature / 100.0, ERROR_BOUND / 100.0);
+	}
+	return ((point_count > 0) && (abs(maximum_error) <= ERROR_BOUND)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
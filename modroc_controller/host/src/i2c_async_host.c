@@ -0,0 +1,238 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  i2c_async_host.c
+
+Host version of the asynchronous I2C reads, with the firmware's queue on each
+of i2c0 and i2c1.  A read goes on the mock bus when it reaches the front of
+its bus's queue, which is when the chip's data registers are latched, and its
+callback runs from a host alarm once the bytes would have been clocked out at
+400 kHz.  The two buses run their reads at the same time on the virtual clock
+the way the DMA channels do, and i2c_async_wait() moves the clock on for as
+long as a blocking wait would have spun.  The reads each device gets, and how
+they share the buses, are counted for i2c_async_host.h.
+
+*/
+
+#include "pico/stdlib.h"
+#include "i2c_async.h"
+#include "i2c_async_host.h"
+
+#define I2C_ASYNC_BUS_COUNT			2
+#define I2C_ASYNC_BIT_TIME_NS		2500  //400 kHz
+#define I2C_ASYNC_BYTE_BITS			9  //With the acknowledge
+#define I2C_ASYNC_FRAMING_BITS		3  //Start, repeated start and stop
+#define I2C_ASYNC_HEADER_BYTES		3  //Address and register written, then the address to read
+#define I2C_ASYNC_NS_PER_US			1000
+#define I2C_ASYNC_ADDRESS_COUNT		128  //7 bit addresses
+
+typedef struct I2C_Async_Request_S {
+	uint8_t address;
+	uint8_t register_address;
+	uint8_t *buffer;
+	uint32_t length;
+	I2C_Async_Callback callback;
+	void *context;
+} I2C_Async_Request;
+
+typedef struct I2C_Async_Bus_S {
+	i2c_inst_t *i2c;
+	I2C_Async_Request current;
+	Error_Returns current_status;  //Known once the transfer is on the bus
+	I2C_Async_Request pending[I2C_ASYNC_QUEUE_DEPTH];  //Waiting behind current, oldest at first_pending
+	uint32_t first_pending;
+	uint32_t pending_count;
+	bool busy;  //Until the queue is empty
+	repeating_timer_t alarm;  //Due when current finishes
+	uint32_t read_counts[I2C_ASYNC_ADDRESS_COUNT];
+	uint32_t queued_counts[I2C_ASYNC_ADDRESS_COUNT];
+} I2C_Async_Bus;
+
+static I2C_Async_Bus async_buses[I2C_ASYNC_BUS_COUNT];
+static uint32_t overlap_count = 0;
+
+static I2C_Async_Bus *get_bus(i2c_inst_t *i2c)
+{
+	I2C_Async_Bus *bus_ptr = &async_buses[i2c_hw_index(i2c)];
+	return (bus_ptr->i2c == i2c) ? bus_ptr : NULL;
+}
+
+static uint64_t get_transfer_time(uint32_t length)
+{
+	uint64_t bits = I2C_ASYNC_FRAMING_BITS + ((uint64_t)(I2C_ASYNC_HEADER_BYTES + length) * I2C_ASYNC_BYTE_BITS);
+	return ((bits * I2C_ASYNC_BIT_TIME_NS) + I2C_ASYNC_NS_PER_US - 1) / I2C_ASYNC_NS_PER_US;
+}
+
+//Does the current request on the mock bus, returns when it finishes
+static uint64_t start_transfer(I2C_Async_Bus *bus_ptr)
+{
+	I2C_Async_Request *request_ptr = &bus_ptr->current;
+	for (uint32_t index = 0; index < I2C_ASYNC_BUS_COUNT; index++)
+	{
+		overlap_count += (&async_buses[index] != bus_ptr) && async_buses[index].busy;
+	}
+	bus_ptr->read_counts[request_ptr->address & (I2C_ASYNC_ADDRESS_COUNT - 1)]++;
+	bus_ptr->busy = true;
+	bus_ptr->current_status = RPi_Success;
+	if ((i2c_write_blocking(bus_ptr->i2c, request_ptr->address, &request_ptr->register_address, 1, true) ==
+		PICO_ERROR_GENERIC) ||
+		(i2c_read_blocking(bus_ptr->i2c, request_ptr->address, request_ptr->buffer, request_ptr->length, false) ==
+		PICO_ERROR_GENERIC))
+	{
+		bus_ptr->current_status = I2CS_Ack_Error;
+	}
+	return time_us_64() + get_transfer_time(request_ptr->length);
+}
+
+//Moves the oldest queued read to current, false if there isn't one
+static bool take_pending(I2C_Async_Bus *bus_ptr)
+{
+	bool to_return = false;
+	if (bus_ptr->pending_count > 0)
+	{
+		bus_ptr->current = bus_ptr->pending[bus_ptr->first_pending];
+		bus_ptr->first_pending = (bus_ptr->first_pending + 1) % I2C_ASYNC_QUEUE_DEPTH;
+		bus_ptr->pending_count--;
+		to_return = true;
+	}
+	return to_return;
+}
+
+//The completion interrupt, starts the next queued read before running the finished one's callback
+static bool complete_transfer(repeating_timer_t *rt)
+{
+	I2C_Async_Bus *bus_ptr = (I2C_Async_Bus *)rt->user_data;
+	I2C_Async_Request finished = bus_ptr->current;
+	Error_Returns status = bus_ptr->current_status;
+	bool to_return = take_pending(bus_ptr);
+	if (to_return)
+	{
+		rt->due_time = start_transfer(bus_ptr);
+	}
+	else
+	{
+		bus_ptr->busy = false;
+	}
+	
+	if (finished.callback != NULL)
+	{
+		finished.callback(finished.context, status);
+	}
+	return to_return;
+}
+
+Error_Returns i2c_async_init(i2c_inst_t *i2c)
+{
+	I2C_Async_Bus *bus_ptr = &async_buses[i2c_hw_index(i2c)];
+	bus_ptr->i2c = i2c;
+	return RPi_Success;
+}
+
+bool i2c_async_is_available(i2c_inst_t *i2c)
+{
+	return get_bus(i2c) != NULL;
+}
+
+Error_Returns i2c_async_read(i2c_inst_t *i2c, uint8_t address, uint8_t register_address,
+	uint8_t *buffer, uint32_t length, I2C_Async_Callback callback, void *context)
+{
+	Error_Returns to_return = RPi_Success;
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	I2C_Async_Request request = {address, register_address, buffer, length, callback, context};
+	
+	do
+	{
+		if (bus_ptr == NULL)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		if ((length == 0) || (length > I2C_ASYNC_MAXIMUM_READ))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		
+		if (!bus_ptr->busy)
+		{
+			bus_ptr->current = request;
+			host_add_alarm(start_transfer(bus_ptr), complete_transfer, bus_ptr, &bus_ptr->alarm);
+		}
+		else if (bus_ptr->pending_count < I2C_ASYNC_QUEUE_DEPTH)
+		{
+			bus_ptr->pending[(bus_ptr->first_pending + bus_ptr->pending_count) % I2C_ASYNC_QUEUE_DEPTH] = request;
+			bus_ptr->pending_count++;
+			bus_ptr->queued_counts[address & (I2C_ASYNC_ADDRESS_COUNT - 1)]++;
+		}
+		else
+		{
+			to_return = RPi_InUse;
+		}
+	} while(0);
+	return to_return;
+}
+
+bool i2c_async_is_busy(i2c_inst_t *i2c)
+{
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	return (bus_ptr != NULL) && bus_ptr->busy;
+}
+
+Error_Returns i2c_async_wait(i2c_inst_t *i2c, uint32_t timeout)
+{
+	Error_Returns to_return = RPi_Success;
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	if (bus_ptr != NULL)
+	{
+		uint64_t deadline = time_us_64() + timeout;
+		while (bus_ptr->busy && (bus_ptr->alarm.due_time <= deadline))
+		{
+			host_clock_set(bus_ptr->alarm.due_time);
+		}
+		
+		if (bus_ptr->busy)
+		{
+			//Timed out, abort everything queued
+			host_clock_set(deadline);
+			cancel_repeating_timer(&bus_ptr->alarm);
+			do
+			{
+				bus_ptr->busy = false;
+				if (bus_ptr->current.callback != NULL)
+				{
+					bus_ptr->current.callback(bus_ptr->current.context, I2CS_Clock_Timeout);
+				}
+			} while (take_pending(bus_ptr));
+			to_return = I2CS_Clock_Timeout;
+		}
+	}
+	return to_return;
+}
+
+uint32_t i2c_async_host_get_read_count(i2c_inst_t *i2c, uint8_t address)
+{
+	return async_buses[i2c_hw_index(i2c)].read_counts[address & (I2C_ASYNC_ADDRESS_COUNT - 1)];
+}
+
+uint32_t i2c_async_host_get_queued_count(i2c_inst_t *i2c, uint8_t address)
+{
+	return async_buses[i2c_hw_index(i2c)].queued_counts[address & (I2C_ASYNC_ADDRESS_COUNT - 1)];
+}
+
+uint32_t i2c_async_host_get_overlap_count()
+{
+	return overlap_count;
+}
@@ -0,0 +1,33 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  i2c_async_host.h
+
+What the host's asynchronous I2C buses saw, for tests of how reads share them.
+
+*/
+
+#pragma once
+#include <stdint.h>
+#include "hardware/i2c.h"
+
+//Reads of the device at address on the bus, and how many of them had to wait behind another
+uint32_t i2c_async_host_get_read_count(i2c_inst_t *i2c, uint8_t address);
+
+uint32_t i2c_async_host_get_queued_count(i2c_inst_t *i2c, uint8_t address);
+
+//Reads that went on the wire while the other bus was mid transfer
+uint32_t i2c_async_host_get_overlap_count();
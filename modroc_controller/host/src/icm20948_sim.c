@@ -0,0 +1,286 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_sim.h
+
+File:  icm20948_sim.c
+
+Register level ICM-20948 for the host SPI bus, see icm20948_sim.h.
+
+*/
+
+#include <string.h>
+#include "icm20948_sim.h"
+
+#define ICM20948_SIM_BANK_COUNT			4
+#define ICM20948_SIM_BANK_SIZE			0x80
+#define ICM20948_SIM_BANK_SHIFT			4
+
+//Bank 0
+#define ICM20948_SIM_WHO_AM_I_REGISTER		0x00
+#define ICM20948_SIM_USER_CTRL_REGISTER		0x03
+#define ICM20948_SIM_PWR_MGMT_1_REGISTER	0x06
+#define ICM20948_SIM_PWR_MGMT_2_REGISTER	0x07
+#define ICM20948_SIM_INT_ENABLE_REGISTER	0x10
+#define ICM20948_SIM_DMP_INT_STATUS_REGISTER	0x18
+#define ICM20948_SIM_INT_STATUS_REGISTER	0x19
+#define ICM20948_SIM_FIFO_RST_REGISTER		0x68
+#define ICM20948_SIM_FIFO_COUNTH_REGISTER	0x70
+#define ICM20948_SIM_FIFO_COUNTL_REGISTER	0x71
+#define ICM20948_SIM_FIFO_R_W_REGISTER		0x72
+#define ICM20948_SIM_MEM_START_ADDR_REGISTER	0x7C
+#define ICM20948_SIM_MEM_R_W_REGISTER		0x7D
+#define ICM20948_SIM_MEM_BANK_SEL_REGISTER	0x7E
+//Every bank
+#define ICM20948_SIM_REG_BANK_SEL_REGISTER	0x7F
+
+#define ICM20948_SIM_WHO_AM_I			0xEA
+#define ICM20948_SIM_PWR_MGMT_1_DEFAULT	0x41  //Asleep, auto selected clock
+#define ICM20948_SIM_DEVICE_RESET		0x80
+#define ICM20948_SIM_SLEEP				0x40
+#define ICM20948_SIM_DMP_EN				0x80
+#define ICM20948_SIM_FIFO_EN			0x40
+#define ICM20948_SIM_ACCEL_STANDBY		0x38
+#define ICM20948_SIM_DMP_INT1_EN		0x02
+#define ICM20948_SIM_DMP_INT			0x02
+
+#define ICM20948_SIM_FIFO_SIZE			1024
+//DMP data output control 1 and its accelerometer bit, the packet header uses the same bits
+#define ICM20948_SIM_DATA_OUT_CTL1		(4 * 16)
+#define ICM20948_SIM_ACCEL_SET			0x8000
+#define ICM20948_SIM_ACCEL_PACKET_SIZE	10  //Header, 3 axes and the ODR counter, all big endian
+
+typedef struct ICM20948_Sim_S {
+	uint8_t registers[ICM20948_SIM_BANK_COUNT][ICM20948_SIM_BANK_SIZE];
+	uint8_t bank;
+	uint8_t dmp_memory[ICM20948_SIM_DMP_MEMORY_SIZE];
+	bool dmp_written[ICM20948_SIM_DMP_MEMORY_SIZE];  //Over SPI since icm20948_sim_init()
+	uint8_t fifo[ICM20948_SIM_FIFO_SIZE];
+	uint32_t fifo_count;
+	uint16_t odr_counter;
+	ICM20948_Sim_Interrupt interrupt;
+	void *context;
+	uint32_t reset_count;
+} ICM20948_Sim_t;
+
+static ICM20948_Sim_t chip;
+
+static void reset()
+{
+	memset(chip.registers, 0, sizeof(chip.registers));
+	memset(chip.dmp_memory, 0, sizeof(chip.dmp_memory));
+	chip.bank = 0;
+	chip.fifo_count = 0;
+	chip.odr_counter = 0;
+	chip.registers[0][ICM20948_SIM_WHO_AM_I_REGISTER] = ICM20948_SIM_WHO_AM_I;
+	chip.registers[0][ICM20948_SIM_PWR_MGMT_1_REGISTER] = ICM20948_SIM_PWR_MGMT_1_DEFAULT;
+}
+
+//DMP memory address MEM_BANK_SEL and MEM_START_ADDR point at, the start address moves on after each byte
+static uint32_t next_memory_address()
+{
+	uint8_t *bank_ptr = chip.registers[0];
+	uint32_t address = ((uint32_t)bank_ptr[ICM20948_SIM_MEM_BANK_SEL_REGISTER] << 8) |
+		bank_ptr[ICM20948_SIM_MEM_START_ADDR_REGISTER];
+	
+	bank_ptr[ICM20948_SIM_MEM_START_ADDR_REGISTER]++;
+	return address % ICM20948_SIM_DMP_MEMORY_SIZE;
+}
+
+static uint8_t fifo_pop()
+{
+	uint8_t to_return = 0;
+	if (chip.fifo_count > 0)
+	{
+		to_return = chip.fifo[0];
+		chip.fifo_count--;
+		memmove(chip.fifo, &chip.fifo[1], chip.fifo_count);
+	}
+	return to_return;
+}
+
+static void fifo_push_short(uint16_t value)
+{
+	chip.fifo[chip.fifo_count++] = (uint8_t)(value >> 8);
+	chip.fifo[chip.fifo_count++] = (uint8_t)value;
+}
+
+void icm20948_sim_init(ICM20948_Sim_Interrupt interrupt, void *context)
+{
+	memset(&chip, 0, sizeof(chip));
+	chip.interrupt = interrupt;
+	chip.context = context;
+	reset();
+}
+
+uint8_t icm20948_sim_read_register(uint8_t register_address)
+{
+	uint8_t to_return = 0;
+	
+	if (register_address == ICM20948_SIM_REG_BANK_SEL_REGISTER)
+	{
+		to_return = (uint8_t)(chip.bank << ICM20948_SIM_BANK_SHIFT);
+	}
+	else if (register_address < ICM20948_SIM_BANK_SIZE)
+	{
+		to_return = chip.registers[chip.bank][register_address];
+		if (chip.bank == 0)
+		{
+			switch (register_address)
+			{
+				case ICM20948_SIM_DMP_INT_STATUS_REGISTER:
+				case ICM20948_SIM_INT_STATUS_REGISTER:
+					chip.registers[0][register_address] = 0;  //Cleared by reading
+					break;
+				case ICM20948_SIM_FIFO_COUNTH_REGISTER:
+					to_return = (uint8_t)(chip.fifo_count >> 8);
+					break;
+				case ICM20948_SIM_FIFO_COUNTL_REGISTER:
+					to_return = (uint8_t)chip.fifo_count;
+					break;
+				case ICM20948_SIM_FIFO_R_W_REGISTER:
+					to_return = fifo_pop();
+					break;
+				case ICM20948_SIM_MEM_R_W_REGISTER:
+					to_return = chip.dmp_memory[next_memory_address()];
+					break;
+				default:
+					break;
+			}
+		}
+	}
+	return to_return;
+}
+
+void icm20948_sim_write_register(uint8_t register_address, uint8_t value)
+{
+	if (register_address == ICM20948_SIM_REG_BANK_SEL_REGISTER)
+	{
+		chip.bank = (value >> ICM20948_SIM_BANK_SHIFT) % ICM20948_SIM_BANK_COUNT;
+	}
+	else if (register_address < ICM20948_SIM_BANK_SIZE)
+	{
+		if (chip.bank != 0)
+		{
+			chip.registers[chip.bank][register_address] = value;
+		}
+		else
+		{
+			switch (register_address)
+			{
+				case ICM20948_SIM_WHO_AM_I_REGISTER:
+				case ICM20948_SIM_FIFO_COUNTH_REGISTER:
+				case ICM20948_SIM_FIFO_COUNTL_REGISTER:
+					break;  //Read only
+				case ICM20948_SIM_PWR_MGMT_1_REGISTER:
+					if (value & ICM20948_SIM_DEVICE_RESET)
+					{
+						chip.reset_count++;
+						reset();
+					}
+					else
+					{
+						chip.registers[0][register_address] = value;
+					}
+					break;
+				case ICM20948_SIM_FIFO_RST_REGISTER:
+					if (value != 0)
+					{
+						chip.fifo_count = 0;
+					}
+					chip.registers[0][register_address] = value;
+					break;
+				case ICM20948_SIM_FIFO_R_W_REGISTER:
+					break;  //Only the DMP fills it here
+				case ICM20948_SIM_MEM_R_W_REGISTER:
+				{
+					uint32_t address = next_memory_address();
+					chip.dmp_memory[address] = value;
+					chip.dmp_written[address] = true;
+					break;
+				}
+				default:
+					chip.registers[0][register_address] = value;
+					break;
+			}
+		}
+	}
+}
+
+uint8_t icm20948_sim_next_register(uint8_t register_address)
+{
+	bool port = (chip.bank == 0) && ((register_address == ICM20948_SIM_FIFO_R_W_REGISTER) ||
+		(register_address == ICM20948_SIM_MEM_R_W_REGISTER));
+	return port ? register_address : register_address + 1;
+}
+
+bool icm20948_sim_push_acceleration(const int16_t acceleration[3])
+{
+	const uint8_t *bank_ptr = chip.registers[0];
+	uint16_t data_output = ((uint16_t)chip.dmp_memory[ICM20948_SIM_DATA_OUT_CTL1] << 8) |
+		chip.dmp_memory[ICM20948_SIM_DATA_OUT_CTL1 + 1];
+	bool produced = !(bank_ptr[ICM20948_SIM_PWR_MGMT_1_REGISTER] & ICM20948_SIM_SLEEP) &&
+		!(bank_ptr[ICM20948_SIM_PWR_MGMT_2_REGISTER] & ICM20948_SIM_ACCEL_STANDBY) &&
+		((bank_ptr[ICM20948_SIM_USER_CTRL_REGISTER] & (ICM20948_SIM_DMP_EN | ICM20948_SIM_FIFO_EN)) ==
+			(ICM20948_SIM_DMP_EN | ICM20948_SIM_FIFO_EN)) &&
+		(data_output & ICM20948_SIM_ACCEL_SET) &&
+		((chip.fifo_count + ICM20948_SIM_ACCEL_PACKET_SIZE) <= ICM20948_SIM_FIFO_SIZE);
+	
+	if (produced)
+	{
+		fifo_push_short(ICM20948_SIM_ACCEL_SET);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			fifo_push_short((uint16_t)acceleration[axis]);
+		}
+		fifo_push_short(chip.odr_counter++);
+		
+		chip.registers[0][ICM20948_SIM_INT_STATUS_REGISTER] |= ICM20948_SIM_DMP_INT;
+		if ((bank_ptr[ICM20948_SIM_INT_ENABLE_REGISTER] & ICM20948_SIM_DMP_INT1_EN) && (chip.interrupt != NULL))
+		{
+			chip.interrupt(chip.context);
+		}
+	}
+	return produced;
+}
+
+uint32_t icm20948_sim_get_fifo_count()
+{
+	return chip.fifo_count;
+}
+
+uint32_t icm20948_sim_get_reset_count()
+{
+	return chip.reset_count;
+}
+
+void icm20948_sim_load_dmp_memory(uint16_t address, const uint8_t *data, uint32_t size)
+{
+	for (uint32_t index = 0; index < size; index++)
+	{
+		chip.dmp_memory[(address + index) % ICM20948_SIM_DMP_MEMORY_SIZE] = data[index];
+	}
+}
+
+uint32_t icm20948_sim_count_dmp_written(uint16_t start, uint16_t end)
+{
+	uint32_t to_return = 0;
+	for (uint32_t address = start; (address < end) && (address < ICM20948_SIM_DMP_MEMORY_SIZE); address++)
+	{
+		to_return += chip.dmp_written[address];
+	}
+	return to_return;
+}
@@ -0,0 +1,74 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_sim.h
+
+File:  icm20948_sim.h
+
+Register level model of an ICM-20948 for the host SPI bus, enough of it for the
+InvenSense driver to bring the chip up and drain its DMP FIFO.  It has the four
+register banks, WHO_AM_I, the device reset, the sleep and accelerometer
+standby bits, the DMP memory behind MEM_BANK_SEL/MEM_START_ADDR/MEM_R_W, and
+the 1 KB FIFO with its count and reset registers.  A reset clears the DMP
+memory along with the registers, as powering the chip down would, and writes
+to DMP memory are recorded so a test can tell what the driver loaded.
+
+The DMP program isn't run.  The harness hands the model accelerometer samples
+instead and they only go in the FIFO the way the DMP would put them there: the
+chip awake, the accelerometer out of standby, the DMP and FIFO enabled and the
+DMP's data output control asking for the accelerometer.  The DMP interrupt is
+then flagged in INT_STATUS and INT1 pulses if it is enabled.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ICM20948_SIM_DMP_MEMORY_SIZE	0x4000
+
+//Called on each INT1 pulse, the harness raises the GPIO it is wired to
+typedef void (*ICM20948_Sim_Interrupt)(void *context);
+
+//Powers the chip up, asleep with the registers at their reset values and DMP memory clear
+void icm20948_sim_init(ICM20948_Sim_Interrupt interrupt, void *context);
+
+//Registers in the bank REG_BANK_SEL has selected
+uint8_t icm20948_sim_read_register(uint8_t register_address);
+
+void icm20948_sim_write_register(uint8_t register_address, uint8_t value);
+
+//The register the next byte of a burst goes to, FIFO_R_W and MEM_R_W stay put
+uint8_t icm20948_sim_next_register(uint8_t register_address);
+
+/* A raw accelerometer sample, in counts, into the FIFO as a DMP packet.  Returns
+   false if the chip isn't set up to produce it, it is dropped then.
+*/
+bool icm20948_sim_push_acceleration(const int16_t acceleration[3]);
+
+//Bytes in the FIFO the driver hasn't read
+uint32_t icm20948_sim_get_fifo_count();
+
+//Device resets through PWR_MGMT_1 since icm20948_sim_init()
+uint32_t icm20948_sim_get_reset_count();
+
+/* Puts what a previous boot left in DMP memory there without going over SPI, a
+   reset of the Pico alone doesn't clear it.
+*/
+void icm20948_sim_load_dmp_memory(uint16_t address, const uint8_t *data, uint32_t size);
+
+//Bytes of DMP memory from start up to end written over SPI since icm20948_sim_init()
+uint32_t icm20948_sim_count_dmp_written(uint16_t start, uint16_t end);
@@ -0,0 +1,351 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_sim.h
+
+File:  icm20948_test.c
+
+Brings the ICM-20948 up through icm20948.c and the InvenSense driver on the
+simulated chip in icm20948_sim.c, then flies a trace with the chip's samples
+feeding the altimeter beside a simulated BME280.
+
+Every sample period the trace's acceleration goes to the chip model, which
+only puts it in the DMP FIFO and pulses INT1 if the bring up left the chip
+awake with the accelerometer on and the DMP asking for it.  The flight loop's
+kinematics_update() then has to drain it through inv_icm20948_poll_sensor() and
+icm20948_data_handler() into the altimeter's estimator.  Every sample pushed,
+bar the first the driver drops after enabling the accelerometer, has to come
+out of accelerometer_get_sample() with the counts it went in with and the time
+INT1 fired, and once the altimeter is ready each has to be the estimator's
+latest update.
+
+The driver's bus statistics are reported as SPI transactions a sample, a second
+of flight and a second of host time through the chip select path.  Draining
+the FIFO can't take more than ICM_TEST_TRANSACTIONS_PER_SAMPLE.
+
+With --warm-boot the chip starts out holding the DMP image, with the variables
+below the program patched the way a previous boot's configuration leaves them,
+as it would after only the Pico was reset.  Bring up then has to leave the chip
+unreset and the program unwritten.  Without it bring up has to reset the chip
+and load the whole image.
+
+Exits with EXIT_FAILURE if any of those checks fail.
+
+    icm20948_test <trace> [--warm-boot]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "accelerometer.h"
+#include "altimeter.h"
+#include "barometer.h"
+#include "icm20948.h"
+#include "Icm20948Defs.h"
+#include "kinematics.h"
+#include "message.h"
+#include "bme280_sim.h"
+#include "icm20948_sim.h"
+#include "mock_i2c.h"
+#include "mock_spi.h"
+#include "trace.h"
+
+#define ICM_TEST_INTERRUPT_PIN		21
+#define ICM_TEST_ADC_HUMIDITY		0x6A00
+#define ICM_TEST_LOOP_PERIOD		500  //In microseconds
+#define ICM_TEST_SAMPLE_PERIOD		5000  //The DMP's, in microseconds
+#define ICM_TEST_STANDARD_GRAVITY	9807  //In millimeters/second2
+#define ICM_TEST_COUNT_LIMIT		32767
+#define ICM_TEST_SKIPPED_SAMPLES	1  //The driver drops the first after enabling a sensor
+#define ICM_TEST_DMP_PROGRAM_START	0x1000  //The DMP's variables are below it
+#define ICM_TEST_DMP_PATCH			0xA5
+//INT_STATUS, DMP_INT_STATUS, the FIFO count and the FIFO, the register bank is shadowed
+#define ICM_TEST_TRANSACTIONS_PER_SAMPLE	4
+
+typedef struct ICM_Test_Source_S {
+	const Trace_t *trace;
+	size_t index;
+} ICM_Test_Source_t;
+
+typedef struct ICM_Test_Results_S {
+	uint32_t pushed;
+	uint32_t dropped;  //By the chip, it wasn't set up to produce them
+	uint32_t received;
+	uint32_t mismatched;  //Values or time stamp not the ones pushed
+	uint32_t fed;  //Taken by the altimeter's estimator
+	uint32_t missed;  //New samples the estimator didn't take once ready
+} ICM_Test_Results_t;
+
+//Same as the replay's, the air is what the last trace sample at or before time says
+static const unsigned char dmp3_image[] = {
+#include "icm20948_img.dmp3a.h"
+};
+
+static void read_trace(void *context, uint64_t time, BME280_Sim_Reading_t *reading)
+{
+	ICM_Test_Source_t *source = (ICM_Test_Source_t *)context;
+	const Trace_t *trace = source->trace;
+	
+	while (((source->index + 1) < trace->sample_count) && (trace->samples[source->index + 1].time_stamp <= time))
+	{
+		source->index++;
+	}
+	reading->adc_pressure = (int32_t)trace->samples[source->index].adc_pressure;
+	reading->adc_temperature = (int32_t)trace->samples[source->index].adc_temperature;
+	reading->adc_humidity = ICM_TEST_ADC_HUMIDITY;
+}
+
+static void raise_interrupt(void *context)
+{
+	(void)context;
+	host_gpio_raise_edge(ICM_TEST_INTERRUPT_PIN);
+}
+
+//The trace's specific force at time in the chip's counts
+static void get_counts(const Trace_t *trace, size_t *index, uint64_t time, int16_t counts[3])
+{
+	const Trace_Acceleration_t *records = trace->accelerations;
+	
+	while (((*index + 1) < trace->acceleration_count) && (records[*index + 1].time_stamp <= time))
+	{
+		(*index)++;
+	}
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		int64_t value = ((int64_t)records[*index].acceleration[axis] * ICM20948_ACCELERATION_PER_G) /
+			ICM_TEST_STANDARD_GRAVITY;
+		value = (value > ICM_TEST_COUNT_LIMIT) ? ICM_TEST_COUNT_LIMIT : value;
+		value = (value < -ICM_TEST_COUNT_LIMIT) ? -ICM_TEST_COUNT_LIMIT : value;
+		counts[axis] = (int16_t)value;
+	}
+}
+
+static double get_wall_time()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+static void drain_messages()
+{
+	Log_Message_t log_entry;
+	while (message_get_log(&log_entry))
+	{
+		printf("%9.3f s: %s", log_entry.time_stamp / 1e3, log_entry.log_message);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int to_return = EXIT_FAILURE;
+	Trace_t trace;
+	
+	do
+	{
+		const char *trace_path = NULL;
+		bool warm_boot = false;
+		for (int index = 1; index < argc; index++)
+		{
+			if (strcmp(argv[index], "--warm-boot") == 0)
+			{
+				warm_boot = true;
+			}
+			else
+			{
+				trace_path = argv[index];
+			}
+		}
+		if (trace_path == NULL)
+		{
+			printf("usage: %s <trace> [--warm-boot]\n", argv[0]);
+			break;
+		}
+		if (!trace_load(trace_path, &trace))
+		{
+			break;
+		}
+		if (trace.acceleration_count == 0)
+		{
+			printf("icm20948_test: %s has no accelerations\n", trace_path);
+			break;
+		}
+		
+		ICM_Test_Source_t source = {&trace, 0};
+		uint32_t barometer_id;
+		uint32_t accelerometer_id;
+		host_clock_set(trace.samples[0].time_stamp);
+		message_init();
+		bme280_sim_init(trace.calibration, trace.humidity_calibration, read_trace, &source);
+		icm20948_sim_init(raise_interrupt, NULL);
+		if (warm_boot)
+		{
+			icm20948_sim_load_dmp_memory(DMP_LOAD_START, dmp3_image, sizeof(dmp3_image));
+			for (uint16_t address = DMP_LOAD_START; address < ICM_TEST_DMP_PROGRAM_START; address++)
+			{
+				uint8_t patch = ICM_TEST_DMP_PATCH;
+				icm20948_sim_load_dmp_memory(address, &patch, 1);
+			}
+		}
+		Error_Returns status = barometer_init(&barometer_id, i2c0, MOCK_I2C_ADDRESS);
+		if (status == RPi_Success)
+		{
+			status = altimeter_initialize(&barometer_id, 1);
+		}
+		if (status == RPi_Success)
+		{
+			status = accelerometer_init(&accelerometer_id, spi0, MOCK_SPI_ICM20948_CHIP_SELECT, ICM_TEST_INTERRUPT_PIN);
+		}
+		if (status == RPi_Success)
+		{
+			status = kinematics_initialize(&accelerometer_id, 1);
+		}
+		drain_messages();
+		if (status != RPi_Success)
+		{
+			printf("icm20948_test: initialization failed: %u\n", status);
+			break;
+		}
+		uint32_t resets = icm20948_sim_get_reset_count();
+		uint32_t image_written = icm20948_sim_count_dmp_written(DMP_LOAD_START, DMP_LOAD_START + sizeof(dmp3_image));
+		uint32_t program_written = icm20948_sim_count_dmp_written(ICM_TEST_DMP_PROGRAM_START,
+			DMP_LOAD_START + sizeof(dmp3_image));
+		
+		//Bring up's transactions aren't the flight's
+		ICM20948_Bus_Statistics start_statistics;
+		icm20948_get_bus_statistics(0, &start_statistics);
+		double wall_start = get_wall_time();
+		
+		ICM_Test_Results_t results;
+		memset(&results, 0, sizeof(results));
+		size_t acceleration_index = 0;
+		uint32_t last_sequence = 0;
+		int16_t pushed_counts[3] = {0};
+		uint64_t pushed_time = 0;
+		uint64_t next_sample = time_us_64();
+		uint64_t end_time = trace.samples[trace.sample_count - 1].time_stamp;
+		for (uint64_t now = time_us_64(); (now < end_time) && (status == RPi_Success); now += ICM_TEST_LOOP_PERIOD)
+		{
+			host_clock_set(now);
+			if (now >= next_sample)
+			{
+				next_sample += ICM_TEST_SAMPLE_PERIOD;
+				get_counts(&trace, &acceleration_index, now, pushed_counts);
+				pushed_time = now;
+				results.pushed++;
+				results.dropped += !icm20948_sim_push_acceleration(pushed_counts);
+			}
+			
+			status = altimeter_update_altitude();
+			if (status == RPi_Success)
+			{
+				status = kinematics_update();
+			}
+			drain_messages();
+			
+			Accelerometer_Sample_t sample;
+			if ((accelerometer_get_sample(accelerometer_id, &sample) != RPi_Success) ||
+				(sample.sequence == last_sequence))
+			{
+				continue;
+			}
+			results.received += sample.sequence - last_sequence;
+			last_sequence = sample.sequence;
+			
+			ICM20948_Acceleration acceleration;
+			icm20948_get_acceleration(0, &acceleration);
+			if ((acceleration.acceleration[0] != pushed_counts[0]) || (acceleration.acceleration[1] != pushed_counts[1]) ||
+				(acceleration.acceleration[2] != pushed_counts[2]) || (acceleration.time_stamp != pushed_time))
+			{
+				results.mismatched++;
+			}
+			
+			if (altimeter_is_ready())
+			{
+				Altimeter_State_t state;
+				altimeter_get_state(&state);
+				if (state.time_stamp == sample.time_stamp)
+				{
+					results.fed++;
+				}
+				else
+				{
+					results.missed++;
+				}
+			}
+		}
+		double wall_time = get_wall_time() - wall_start;
+		if (status != RPi_Success)
+		{
+			printf("icm20948_test: update failed: %u\n", status);
+			break;
+		}
+		ICM20948_Bus_Statistics statistics;
+		icm20948_get_bus_statistics(0, &statistics);
+		uint32_t transactions = statistics.transactions - start_statistics.transactions;
+		double flight_time = (end_time - trace.samples[0].time_stamp) / 1e6;
+		
+		printf("icm20948_test: %s%s\n", trace_path, warm_boot ? " warm boot" : "");
+		printf("%u chip resets, %u bytes of the DMP image written, %u of its program\n", resets, image_written,
+			program_written);
+		printf("%u samples pushed, %u dropped by the chip, %u received, %u not as pushed\n", results.pushed,
+			results.dropped, results.received, results.mismatched);
+		printf("%u fed to the altimeter, %u missed\n", results.fed, results.missed);
+		printf("%u SPI transactions, %.1f a sample, %.0f a second of flight, %.0f a second on the host\n",
+			transactions, results.pushed ? (double)transactions / results.pushed : 0.0, transactions / flight_time,
+			transactions / wall_time);
+		
+		to_return = EXIT_SUCCESS;
+		if (warm_boot && ((resets != 0) || (program_written != 0)))
+		{
+			printf("icm20948_test: the DMP image was still loaded but the chip was reset or reloaded\n");
+			to_return = EXIT_FAILURE;
+		}
+		if (!warm_boot && ((resets != 1) || (image_written != sizeof(dmp3_image))))
+		{
+			printf("icm20948_test: the chip wasn't reset and the whole DMP image loaded\n");
+			to_return = EXIT_FAILURE;
+		}
+		if ((results.pushed == 0) || (results.dropped != 0))
+		{
+			printf("icm20948_test: the chip wasn't left producing accelerometer samples\n");
+			to_return = EXIT_FAILURE;
+		}
+		if (((results.received + ICM_TEST_SKIPPED_SAMPLES) != results.pushed) || (results.mismatched != 0))
+		{
+			printf("icm20948_test: samples were lost or changed on the way out of the FIFO\n");
+			to_return = EXIT_FAILURE;
+		}
+		if (transactions > (ICM_TEST_TRANSACTIONS_PER_SAMPLE * results.pushed))
+		{
+			printf("icm20948_test: draining the FIFO took more than %u SPI transactions a sample\n",
+				ICM_TEST_TRANSACTIONS_PER_SAMPLE);
+			to_return = EXIT_FAILURE;
+		}
+		if ((results.fed == 0) || (results.missed != 0))
+		{
+			printf("icm20948_test: samples didn't reach the altimeter's estimator\n");
+			to_return = EXIT_FAILURE;
+		}
+		
+		trace_free(&trace);
+	} while(0);
+	
+	return to_return;
+}
@@ -0,0 +1,139 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  mock_i2c.c
+
+Host I2C buses with the simulated BME280s in bme280_sim.c on them, chip 0 at
+MOCK_I2C_ADDRESS on i2c0 and any others where mock_i2c_attach() puts them.  A
+transaction selects the chip addressed.  A one byte write sets that chip's
+register pointer and reads auto-increment from it, longer writes are register
+address/data pairs the way the BME280 takes them.  A transaction to an address
+nothing answers on, or one the chip is told to fail, is not acknowledged and
+does nothing.
+
+*/
+
+#include "hardware/i2c.h"
+#include "bme280_sim.h"
+#include "mock_i2c.h"
+
+typedef struct Mock_I2C_Device_S {
+	uint8_t address;
+	uint32_t chip;
+	uint8_t register_pointer;
+} Mock_I2C_Device_t;
+
+struct i2c_inst {
+	uint32_t index;
+	Mock_I2C_Device_t devices[MOCK_I2C_DEVICES_PER_BUS];
+	uint32_t device_count;
+	uint32_t transaction_count;
+};
+
+i2c_inst_t host_i2c0 = {0, {{MOCK_I2C_ADDRESS, 0, 0}}, 1, 0};
+i2c_inst_t host_i2c1 = {1, {{0}}, 0, 0};
+
+uint32_t i2c_hw_index(i2c_inst_t *i2c)
+{
+	return i2c->index;
+}
+
+static Mock_I2C_Device_t *find_device(i2c_inst_t *i2c, uint8_t addr)
+{
+	Mock_I2C_Device_t *to_return = NULL;
+	for (uint32_t index = 0; index < i2c->device_count; index++)
+	{
+		if (i2c->devices[index].address == addr)
+		{
+			to_return = &i2c->devices[index];
+			break;
+		}
+	}
+	return to_return;
+}
+
+bool mock_i2c_attach(i2c_inst_t *i2c, uint8_t address, uint32_t chip)
+{
+	bool to_return = (i2c->device_count < MOCK_I2C_DEVICES_PER_BUS) && (find_device(i2c, address) == NULL);
+	if (to_return)
+	{
+		Mock_I2C_Device_t *device_ptr = &i2c->devices[i2c->device_count++];
+		device_ptr->address = address;
+		device_ptr->chip = chip;
+		device_ptr->register_pointer = 0;
+	}
+	return to_return;
+}
+
+uint32_t mock_i2c_get_transaction_count()
+{
+	return host_i2c0.transaction_count + host_i2c1.transaction_count;
+}
+
+//Selects the chip addressed, NULL if there isn't one or it fails the transaction
+static Mock_I2C_Device_t *get_acknowledged_device(i2c_inst_t *i2c, uint8_t addr)
+{
+	Mock_I2C_Device_t *device_ptr = find_device(i2c, addr);
+	i2c->transaction_count++;
+	if (device_ptr != NULL)
+	{
+		bme280_sim_select(device_ptr->chip);
+		if (bme280_sim_bus_error())
+		{
+			device_ptr = NULL;
+		}
+	}
+	return device_ptr;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+	(void)nostop;
+	Mock_I2C_Device_t *device_ptr = get_acknowledged_device(i2c, addr);
+	if (device_ptr == NULL)
+	{
+		return PICO_ERROR_GENERIC;
+	}
+	
+	if (len == 1)
+	{
+		device_ptr->register_pointer = src[0];
+	}
+	else
+	{
+		for (size_t index = 0; (index + 1) < len; index += 2)
+		{
+			bme280_sim_write_register(src[index], src[index + 1]);
+		}
+	}
+	return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+	(void)nostop;
+	Mock_I2C_Device_t *device_ptr = get_acknowledged_device(i2c, addr);
+	if (device_ptr == NULL)
+	{
+		return PICO_ERROR_GENERIC;
+	}
+	
+	for (size_t index = 0; index < len; index++)
+	{
+		dst[index] = bme280_sim_read_register(device_ptr->register_pointer++);
+	}
+	return (int)len;
+}
@@ -0,0 +1,37 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  mock_i2c.h
+
+The host I2C buses the simulated BME280s sit on.  Chip 0 answers on i2c0 at
+MOCK_I2C_ADDRESS from start up, mock_i2c_attach() puts the other chips on a bus.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "hardware/i2c.h"
+
+#define MOCK_I2C_ADDRESS			0x76  //The address the chip answers on, SDO low
+#define MOCK_I2C_SECOND_ADDRESS		0x77  //SDO high, for a second chip on the bus
+#define MOCK_I2C_DEVICES_PER_BUS	2
+
+//Puts bme280_sim chip on the bus at address, false if the bus is full or the address taken
+bool mock_i2c_attach(i2c_inst_t *i2c, uint8_t address, uint32_t chip);
+
+//Number of I2C transactions, reads and writes, on both buses since start up
+uint32_t mock_i2c_get_transaction_count();
@@ -0,0 +1,208 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  mock_spi.c
+
+Host SPI bus with chip 0 of the simulated BME280s in bme280_sim.c on it, behind
+MOCK_SPI_CHIP_SELECT, and the ICM-20948 in icm20948_sim.c behind
+MOCK_SPI_ICM20948_CHIP_SELECT.  The first byte after chip select goes low is a
+register address with bit 7 set for a read, reads then auto-increment from it.
+For a BME280 write bit 7 is clear and the bytes are register address/data
+pairs, the chip puts bit 7 back on the address the way the BME280 does.  An
+ICM-20948 write is the address then a burst of data the same way a read is.
+SPI has no acknowledge, a transaction the BME280 is told to fail reads back
+0xFF the way a floating MISO would and its writes are lost.
+
+There are no DMA channels, spi_dma_init() reports none free and the drivers
+stay on the blocking transfers.
+
+There is only one core, so the spi_dma bus lock is a flag.  Taking it twice, or
+lowering the chip select without it, is counted as a lock error.
+
+*/
+
+#include "hardware/spi.h"
+#include "spi_dma.h"
+#include "bme280_sim.h"
+#include "icm20948_sim.h"
+#include "mock_spi.h"
+
+#define MOCK_SPI_READ_BIT	0x80
+
+typedef enum {
+	mock_spi_deselected,
+	mock_spi_address,  //Next byte is a register address
+	mock_spi_data,  //Next byte is written to the register
+	mock_spi_reading,
+	mock_spi_failed  //Ignored until deselected
+} Mock_SPI_State;
+
+typedef enum {
+	mock_spi_bme280,
+	mock_spi_icm20948
+} Mock_SPI_Device;
+
+struct spi_inst {
+	Mock_SPI_State state;
+	Mock_SPI_Device device;
+	uint8_t register_pointer;
+	uint32_t transaction_count;
+	bool locked;
+	uint32_t lock_errors;
+};
+
+spi_inst_t host_spi0;
+
+uint32_t mock_spi_get_transaction_count()
+{
+	return host_spi0.transaction_count;
+}
+
+uint32_t mock_spi_get_lock_error_count()
+{
+	return host_spi0.lock_errors;
+}
+
+void spi_dma_lock_bus(spi_inst_t *spi)
+{
+	spi->lock_errors += spi->locked;
+	spi->locked = true;
+}
+
+void spi_dma_unlock_bus(spi_inst_t *spi)
+{
+	spi->lock_errors += !spi->locked;
+	spi->locked = false;
+}
+
+Error_Returns spi_dma_init(spi_inst_t *spi)
+{
+	(void)spi;
+	return RPi_InsufficientResources;
+}
+
+bool spi_dma_is_available(spi_inst_t *spi)
+{
+	(void)spi;
+	return false;
+}
+
+Error_Returns spi_dma_write(spi_inst_t *spi, const uint8_t *src, uint32_t length)
+{
+	spi_write_blocking(spi, src, length);
+	return RPi_Success;
+}
+
+Error_Returns spi_dma_read(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, uint32_t length)
+{
+	spi_read_blocking(spi, repeated_tx_data, dst, length);
+	return RPi_Success;
+}
+
+void gpio_put(uint32_t gpio, bool value)
+{
+	if ((gpio == MOCK_SPI_CHIP_SELECT) || (gpio == MOCK_SPI_ICM20948_CHIP_SELECT))
+	{
+		host_spi0.lock_errors += !host_spi0.locked;
+		if (value)
+		{
+			host_spi0.state = mock_spi_deselected;
+		}
+		else if (host_spi0.state == mock_spi_deselected)
+		{
+			host_spi0.transaction_count++;
+			if (gpio == MOCK_SPI_ICM20948_CHIP_SELECT)
+			{
+				host_spi0.device = mock_spi_icm20948;
+				host_spi0.state = mock_spi_address;
+			}
+			else
+			{
+				host_spi0.device = mock_spi_bme280;
+				bme280_sim_select(0);
+				host_spi0.state = bme280_sim_bus_error() ? mock_spi_failed : mock_spi_address;
+			}
+		}
+	}
+}
+
+static void icm20948_write(spi_inst_t *spi, uint8_t value)
+{
+	if (spi->state == mock_spi_address)
+	{
+		spi->register_pointer = value & ~MOCK_SPI_READ_BIT;
+		spi->state = (value & MOCK_SPI_READ_BIT) ? mock_spi_reading : mock_spi_data;
+	}
+	else if (spi->state == mock_spi_data)
+	{
+		icm20948_sim_write_register(spi->register_pointer, value);
+		spi->register_pointer = icm20948_sim_next_register(spi->register_pointer);
+	}
+}
+
+static uint8_t icm20948_read(spi_inst_t *spi)
+{
+	uint8_t to_return = 0xFF;
+	if (spi->state == mock_spi_reading)
+	{
+		to_return = icm20948_sim_read_register(spi->register_pointer);
+		spi->register_pointer = icm20948_sim_next_register(spi->register_pointer);
+	}
+	return to_return;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+	for (size_t index = 0; (index < len) && (spi->device == mock_spi_icm20948); index++)
+	{
+		icm20948_write(spi, src[index]);
+	}
+	for (size_t index = 0; (index < len) && (spi->device == mock_spi_bme280); index++)
+	{
+		switch (spi->state)
+		{
+			case mock_spi_address:
+				spi->register_pointer = src[index] | MOCK_SPI_READ_BIT;
+				spi->state = (src[index] & MOCK_SPI_READ_BIT) ? mock_spi_reading : mock_spi_data;
+				break;
+			case mock_spi_data:
+				bme280_sim_write_register(spi->register_pointer, src[index]);
+				spi->state = mock_spi_address;
+				break;
+			default:
+				break;  //Not selected, or clocking out a read
+		}
+	}
+	return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len)
+{
+	(void)repeated_tx_data;
+	for (size_t index = 0; index < len; index++)
+	{
+		if (spi->device == mock_spi_icm20948)
+		{
+			dst[index] = icm20948_read(spi);
+		}
+		else
+		{
+			dst[index] = (spi->state == mock_spi_reading) ? bme280_sim_read_register(spi->register_pointer++) : 0xFF;
+		}
+	}
+	return (int)len;
+}
@@ -0,0 +1,35 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  mock_spi.h
+
+The simulated BME280 in bme280_sim.c and ICM-20948 in icm20948_sim.c seen
+from the host SPI bus.
+
+*/
+
+#pragma once
+#include <stdint.h>
+
+#define MOCK_SPI_CHIP_SELECT	20  //The pin the BME280 answers on
+#define MOCK_SPI_ICM20948_CHIP_SELECT	17
+
+//Number of SPI transactions, chip select assertions, since start up
+uint32_t mock_spi_get_transaction_count();
+
+//Bus lock taken twice or released when not held, or the chip select moved without it
+uint32_t mock_spi_get_lock_error_count();
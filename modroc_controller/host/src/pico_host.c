@@ -0,0 +1,288 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  pico_host.c
+
+Host versions of the Pico SDK time and interrupt functions.  The clock is
+virtual, set by the replay harness from the trace and advanced by sleeps, so
+replays are repeatable and run as fast as the host can go.  Repeating timers
+and the alarms host_add_alarm() sets are called as the clock passes them, before
+it reaches the new time.  GPIO edges the harness raises run the pin's raw
+handlers straight away, the way the IO_IRQ_BANK0 interrupt would preempt.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+
+#define MICROSECONDS_PER_MILLISECOND	1000
+#define HOST_SYSTEM_CLOCK_HZ	125000000
+#define HOST_GPIO_COUNT			30
+#define HOST_GPIO_HANDLERS		4
+
+static uint64_t host_clock = 0;  //In microseconds
+static repeating_timer_t *running_timers = NULL;
+
+typedef struct Host_GPIO_S {
+	uint32_t enabled_events;
+	uint32_t events;  //Latched until acknowledged
+} Host_GPIO_t;
+
+static Host_GPIO_t host_gpios[HOST_GPIO_COUNT];
+static void (*gpio_handlers[HOST_GPIO_HANDLERS])(void);  //Shared by every pin, as on the chip
+static uint32_t gpio_handler_count = 0;
+
+static repeating_timer_t *get_next_due(uint64_t time_us)
+{
+	repeating_timer_t *next_ptr = NULL;
+	for (repeating_timer_t *timer_ptr = running_timers; timer_ptr != NULL; timer_ptr = timer_ptr->next)
+	{
+		if ((timer_ptr->due_time <= time_us) && ((next_ptr == NULL) || (timer_ptr->due_time < next_ptr->due_time)))
+		{
+			next_ptr = timer_ptr;
+		}
+	}
+	return next_ptr;
+}
+
+void host_clock_set(uint64_t time_us)
+{
+	repeating_timer_t *timer_ptr;
+	while ((timer_ptr = get_next_due(time_us)) != NULL)
+	{
+		host_clock = timer_ptr->due_time;
+		timer_ptr->due_time += timer_ptr->delay_us;
+		if (!timer_ptr->callback(timer_ptr))
+		{
+			cancel_repeating_timer(timer_ptr);
+		}
+	}
+	host_clock = time_us;
+}
+
+void sleep_ms(uint32_t ms)
+{
+	host_clock_set(host_clock + ((uint64_t)ms * MICROSECONDS_PER_MILLISECOND));
+}
+
+void sleep_us(uint64_t us)
+{
+	host_clock_set(host_clock + us);
+}
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)host_clock;
+}
+
+uint64_t time_us_64(void)
+{
+	return host_clock;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+	return host_clock;
+}
+
+uint32_t to_ms_since_boot(absolute_time_t time)
+{
+	return (uint32_t)(time / MICROSECONDS_PER_MILLISECOND);
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+	repeating_timer_t *out)
+{
+	bool added = (delay_ms != 0);
+	if (added)
+	{
+		out->delay_us = (int64_t)abs(delay_ms) * MICROSECONDS_PER_MILLISECOND;
+		out->due_time = host_clock + out->delay_us;
+		out->callback = callback;
+		out->user_data = user_data;
+		out->next = running_timers;
+		running_timers = out;
+	}
+	return added;
+}
+
+void host_add_alarm(uint64_t due_time, repeating_timer_callback_t callback, void *user_data,
+	repeating_timer_t *out)
+{
+	out->delay_us = 0;
+	out->due_time = due_time;
+	out->callback = callback;
+	out->user_data = user_data;
+	out->next = running_timers;
+	running_timers = out;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+	bool found = false;
+	for (repeating_timer_t **link_ptr = &running_timers; *link_ptr != NULL; link_ptr = &(*link_ptr)->next)
+	{
+		if (*link_ptr == timer)
+		{
+			*link_ptr = timer->next;
+			found = true;
+			break;
+		}
+	}
+	return found;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+	(void)status;
+}
+
+void queue_init(queue_t *q, unsigned int element_size, unsigned int element_count)
+{
+	q->element_size = element_size;
+	q->element_count = element_count + 1;
+	q->data = calloc(q->element_count, element_size);
+	q->write_index = 0;
+	q->read_index = 0;
+}
+
+bool queue_try_add(queue_t *q, const void *data)
+{
+	uint32_t next_index = (q->write_index + 1) % q->element_count;
+	if (next_index == q->read_index)
+	{
+		return false;
+	}
+	memcpy(&q->data[q->write_index * q->element_size], data, q->element_size);
+	q->write_index = next_index;
+	return true;
+}
+
+void queue_add_blocking(queue_t *q, const void *data)
+{
+	if (!queue_try_add(q, data))
+	{
+		printf("queue_add_blocking: queue full, nothing is draining it\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+bool queue_try_remove(queue_t *q, void *data)
+{
+	if (q->read_index == q->write_index)
+	{
+		return false;
+	}
+	memcpy(data, &q->data[q->read_index * q->element_size], q->element_size);
+	q->read_index = (q->read_index + 1) % q->element_count;
+	return true;
+}
+
+void busy_wait_at_least_cycles(uint32_t minimum_cycles)
+{
+	(void)minimum_cycles;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+	(void)clk_index;
+	return HOST_SYSTEM_CLOCK_HZ;
+}
+
+void irq_set_enabled(unsigned int num, bool enabled)
+{
+	(void)num;
+	(void)enabled;
+}
+
+void gpio_init(uint32_t gpio)
+{
+	if (gpio < HOST_GPIO_COUNT)
+	{
+		memset(&host_gpios[gpio], 0, sizeof(Host_GPIO_t));
+	}
+}
+
+void gpio_set_dir(uint32_t gpio, bool out)
+{
+	(void)gpio;
+	(void)out;
+}
+
+void gpio_add_raw_irq_handler(uint32_t gpio, void (*handler)(void))
+{
+	(void)gpio;
+	bool added = false;
+	for (uint32_t index = 0; index < gpio_handler_count; index++)
+	{
+		added |= (gpio_handlers[index] == handler);
+	}
+	if (!added && (gpio_handler_count < HOST_GPIO_HANDLERS))
+	{
+		gpio_handlers[gpio_handler_count++] = handler;
+	}
+}
+
+void gpio_set_irq_enabled(uint32_t gpio, uint32_t events, bool enabled)
+{
+	if (gpio < HOST_GPIO_COUNT)
+	{
+		if (enabled)
+		{
+			host_gpios[gpio].enabled_events |= events;
+		}
+		else
+		{
+			host_gpios[gpio].enabled_events &= ~events;
+		}
+	}
+}
+
+uint32_t gpio_get_irq_event_mask(uint32_t gpio)
+{
+	return (gpio < HOST_GPIO_COUNT) ? (host_gpios[gpio].events & host_gpios[gpio].enabled_events) : 0;
+}
+
+void gpio_acknowledge_irq(uint32_t gpio, uint32_t events)
+{
+	if (gpio < HOST_GPIO_COUNT)
+	{
+		host_gpios[gpio].events &= ~events;
+	}
+}
+
+void host_gpio_raise_edge(uint32_t gpio)
+{
+	if ((gpio < HOST_GPIO_COUNT) && (host_gpios[gpio].enabled_events & GPIO_IRQ_EDGE_RISE))
+	{
+		host_gpios[gpio].events |= GPIO_IRQ_EDGE_RISE;
+		for (uint32_t index = 0; index < gpio_handler_count; index++)
+		{
+			gpio_handlers[index]();
+		}
+	}
+}
@@ -0,0 +1,71 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  profile_host.c
+
+Host implementation of the profile.h stage hooks, accumulates the monotonic
+clock time spent in each stage.  Host nanoseconds are not RP2040 cycles, the
+numbers are for comparing one build or change against another.
+
+*/
+
+#include <time.h>
+#include "profile.h"
+
+typedef struct Stage_Totals_S {
+	uint64_t start;
+	uint64_t total;  //In nanoseconds
+	uint32_t calls;
+} Stage_Totals_t;
+
+static Stage_Totals_t stage_totals[profile_stage_count];
+
+static const char *stage_names[profile_stage_count] = {
+	"compensation",
+	"filtering",
+	"conversion",
+	"estimation",
+	"log compensation"
+};
+
+static uint64_t get_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void profile_stage_begin(Profile_Stage stage)
+{
+	stage_totals[stage].start = get_time_ns();
+}
+
+void profile_stage_end(Profile_Stage stage)
+{
+	stage_totals[stage].total += get_time_ns() - stage_totals[stage].start;
+	stage_totals[stage].calls++;
+}
+
+void profile_report(FILE *output)
+{
+	fprintf(output, "%-18s %8s %12s %10s\n", "stage", "calls", "total us", "ns/call");
+	for (uint32_t stage = 0; stage < profile_stage_count; stage++)
+	{
+		Stage_Totals_t *totals = &stage_totals[stage];
+		fprintf(output, "%-18s %8u %12.1f %10.1f\n", stage_names[stage], totals->calls, totals->total / 1000.0,
+			totals->calls ? (double)totals->total / totals->calls : 0.0);
+	}
+}
@@ -0,0 +1,197 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  trace.c
+
+Loads the barometer traces described in trace.h.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+#define TRACE_LINE_LENGTH	256
+
+static bool parse_hex(const char *text, uint8_t *bytes, size_t length)
+{
+	bool to_return = (strlen(text) == (length * 2));
+	for (size_t index = 0; to_return && (index < length); index++)
+	{
+		unsigned int value;
+		to_return = (sscanf(&text[index * 2], "%2x", &value) == 1);
+		bytes[index] = (uint8_t)value;
+	}
+	return to_return;
+}
+
+//Makes room for one more item in a growing array
+static bool reserve(void **items, size_t count, size_t *capacity, size_t item_size)
+{
+	bool to_return = true;
+	if (count == *capacity)
+	{
+		size_t new_capacity = *capacity ? (*capacity * 2) : 1024;
+		void *new_items = realloc(*items, new_capacity * item_size);
+		if (new_items == NULL)
+		{
+			to_return = false;
+		}
+		else
+		{
+			*items = new_items;
+			*capacity = new_capacity;
+		}
+	}
+	return to_return;
+}
+
+static bool add_sample(Trace_t *trace, size_t *capacity, const Trace_Sample_t *sample)
+{
+	bool to_return = reserve((void **)&trace->samples, trace->sample_count, capacity, sizeof(Trace_Sample_t));
+	if (to_return)
+	{
+		trace->samples[trace->sample_count++] = *sample;
+	}
+	return to_return;
+}
+
+static bool add_acceleration(Trace_t *trace, size_t *capacity, const Trace_Acceleration_t *acceleration)
+{
+	bool to_return = reserve((void **)&trace->accelerations, trace->acceleration_count, capacity,
+		sizeof(Trace_Acceleration_t));
+	if (to_return)
+	{
+		trace->accelerations[trace->acceleration_count++] = *acceleration;
+	}
+	return to_return;
+}
+
+bool trace_load(const char *path, Trace_t *trace)
+{
+	bool to_return = false;
+	char line[TRACE_LINE_LENGTH];
+	size_t capacity = 0;
+	size_t acceleration_capacity = 0;
+	unsigned int line_number = 0;
+	
+	memset(trace, 0, sizeof(Trace_t));
+	FILE *input = fopen(path, "r");
+	do
+	{
+		if (input == NULL)
+		{
+			printf("trace_load(): can't open %s\n", path);
+			break;
+		}
+		
+		to_return = true;
+		while (to_return && (fgets(line, sizeof(line), input) != NULL))
+		{
+			char keyword[16];
+			char first[64];
+			char second[64];
+			unsigned long long time_stamp;
+			Trace_Sample_t sample;
+			
+			line_number++;
+			if ((line[0] == '#') || (sscanf(line, "%15s", keyword) != 1))
+			{
+				continue;
+			}
+			
+			if (strcmp(keyword, "sample") == 0)
+			{
+				int altitude;
+				int fields = sscanf(line, "%*s %llu %u %u %d", &time_stamp, &sample.adc_pressure,
+					&sample.adc_temperature, &altitude);
+				sample.time_stamp = time_stamp;
+				sample.altitude = altitude;
+				sample.has_altitude = (fields == 4);
+				to_return = (fields >= 3) && add_sample(trace, &capacity, &sample);
+			}
+			else if (strcmp(keyword, "acceleration") == 0)
+			{
+				Trace_Acceleration_t acceleration;
+				int x, y, z;
+				to_return = (sscanf(line, "%*s %llu %d %d %d", &time_stamp, &x, &y, &z) == 4);
+				acceleration.time_stamp = time_stamp;
+				acceleration.acceleration[0] = x;
+				acceleration.acceleration[1] = y;
+				acceleration.acceleration[2] = z;
+				to_return = to_return && add_acceleration(trace, &acceleration_capacity, &acceleration);
+			}
+			else if (strcmp(keyword, "calibration") == 0)
+			{
+				to_return = (sscanf(line, "%*s %63s %63s", first, second) == 2) &&
+					parse_hex(first, trace->calibration, TRACE_CALIBRATION_BYTES) &&
+					parse_hex(second, trace->humidity_calibration, TRACE_HUMIDITY_CALIBRATION_BYTES);
+				trace->has_calibration = to_return;
+			}
+			else if (strcmp(keyword, "apogee") == 0)
+			{
+				int altitude;
+				to_return = (sscanf(line, "%*s %llu %d", &time_stamp, &altitude) == 2);
+				trace->apogee_time = time_stamp;
+				trace->apogee_altitude = altitude;
+				trace->has_apogee = to_return;
+			}
+			else if (strcmp(keyword, "landing") == 0)
+			{
+				to_return = (sscanf(line, "%*s %llu", &time_stamp) == 1);
+				trace->landing_time = time_stamp;
+				trace->has_landing = to_return;
+			}
+			else
+			{
+				to_return = false;
+			}
+		}
+		
+		if (!to_return)
+		{
+			printf("trace_load(): %s line %u not understood\n", path, line_number);
+			break;
+		}
+		
+		if (!trace->has_calibration || (trace->sample_count == 0))
+		{
+			printf("trace_load(): %s needs a calibration line and samples\n", path);
+			to_return = false;
+		}
+	} while(0);
+	
+	if (input != NULL)
+	{
+		fclose(input);
+	}
+	if (!to_return)
+	{
+		trace_free(trace);
+	}
+	return to_return;
+}
+
+void trace_free(Trace_t *trace)
+{
+	free(trace->samples);
+	trace->samples = NULL;
+	trace->sample_count = 0;
+	free(trace->accelerations);
+	trace->accelerations = NULL;
+	trace->acceleration_count = 0;
+}
@@ -0,0 +1,78 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  trace.h
+
+Barometer traces replayed by the host harness.
+
+A trace is a text file, one record per line, '#' starts a comment:
+
+    calibration <hex bytes of 0x88-0xA1> <hex bytes of 0xE1-0xE7>
+    apogee <time us> <altitude mm>
+    landing <time us>
+    sample <time us> <raw pressure ADC> <raw temperature ADC> [<altitude mm>]
+    acceleration <time us> <x mm/s2> <y mm/s2> <z mm/s2>
+
+Samples are in time order and are the raw 20 bit ADC values the BME280 would
+have in its data registers.  The apogee, landing and sample altitudes are the
+ground truth and are optional, a trace recorded in flight won't have them.
+Accelerations are optional too and in time order, they are what the
+accelerometer reports: the specific force in the body frame with Z toward the
+nose, +9807 sitting on the pad.  tools/synthesize_flight_trace.py writes traces
+with all of them.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_CALIBRATION_BYTES				26  //0x88 to 0xA1
+#define TRACE_HUMIDITY_CALIBRATION_BYTES	7  //0xE1 to 0xE7
+
+typedef struct Trace_Sample_S {
+	uint64_t time_stamp;  //In microseconds
+	uint32_t adc_pressure;
+	uint32_t adc_temperature;
+	int32_t altitude;  //In millimeters, when has_altitude
+	bool has_altitude;
+} Trace_Sample_t;
+
+typedef struct Trace_Acceleration_S {
+	uint64_t time_stamp;  //In microseconds
+	int32_t acceleration[3];  //In millimeters/second2
+} Trace_Acceleration_t;
+
+typedef struct Trace_S {
+	uint8_t calibration[TRACE_CALIBRATION_BYTES];
+	uint8_t humidity_calibration[TRACE_HUMIDITY_CALIBRATION_BYTES];
+	bool has_calibration;
+	bool has_apogee;
+	bool has_landing;
+	uint64_t apogee_time;  //In microseconds
+	int32_t apogee_altitude;  //In millimeters
+	uint64_t landing_time;  //In microseconds
+	Trace_Sample_t *samples;
+	size_t sample_count;
+	Trace_Acceleration_t *accelerations;
+	size_t acceleration_count;
+} Trace_t;
+
+//Returns false, with the reason printed, if the file can't be read or parsed
+bool trace_load(const char *path, Trace_t *trace);
+
+void trace_free(Trace_t *trace);
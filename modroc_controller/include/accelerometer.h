@@ -30,12 +30,29 @@ Interface into the support software for a variety of accelerometers.
 
 #define ACCELEROMETER_NUMBER_SUPPORTED_DEVICES 1
 
-/*  Initializes a accelerometer with the given address on the specified I2C bus, 
-	if the maximum number of accelerometers are exceeded or the accelerometer chip fails 
+/*  Specific force in the body frame, Z runs along the airframe toward the nose
+	so it reads +1 g sitting on the pad.
+*/
+typedef struct Accelerometer_Sample_S
+{
+	int32_t acceleration[3];  //In millimeters/second2
+	uint32_t time_stamp;  //In microseconds since boot
+	uint32_t sequence;  //Incremented for every new sample
+} Accelerometer_Sample_t;
+
+/*  Initializes a accelerometer with the given chip select on the specified SPI bus, 
+	interrupt_pin is the GPIO its data ready interrupt is wired to.  If the maximum
+	number of accelerometers are exceeded or the accelerometer chip fails 
 	to initialize returns RPi_NotInitialized, otherwise RPi_Success is returned 
 	along with a valid ID.
 */
 	
-Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *i2c, uint32_t chip_select);
+Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin);
 
 Error_Returns accelerometer_reset(uint32_t id);
+
+//Collects any samples the chip has signalled are ready, cheap to call when there are none
+Error_Returns accelerometer_update(uint32_t id);
+
+//Returns the latest sample collected by accelerometer_update(), compare sequence numbers for new ones
+Error_Returns accelerometer_get_sample(uint32_t id, Accelerometer_Sample_t *sample);
@@ -20,12 +20,91 @@ Interface into the altitude calculation software.
 */
 
 #pragma once
+#include <stdbool.h>
 #include "common.h"
+#include "barometer.h"
+
+typedef enum {
+	altitude_model_standard,  //Standard atmosphere barometric formula
+	altitude_model_hypsometric  //Uses the temperature measured with each pressure
+} Altimeter_Altitude_Model;
+
+typedef struct Altimeter_State_S
+{
+	int32_t altitude;  //In millimeters above the base pressure
+	int32_t velocity;  //In millimeters/second, positive up
+	int32_t acceleration;  //In millimeters/second2, positive up, gravity removed
+	uint32_t time_stamp;  //In microseconds since boot
+} Altimeter_State_t;
+
+typedef struct Altimeter_Altitude_S
+{
+	int32_t altitude;  //In millimeters above the base pressure
+	uint32_t time_stamp;  //In microseconds since boot the sample was read
+	uint32_t sequence;  //Incremented for every new sample
+} Altimeter_Altitude_t;
 
 Error_Returns altimeter_initialize(uint32_t *barometer_id_array, uint32_t number_of_barometers);
 
+/*  Restarts the base pressure calibration and returns straight away, the
+	calibration is stepped by altimeter_update_altitude() and altimeter_is_ready()
+	returns false until it has converged.
+*/
 Error_Returns altimeter_reset();
 
+/*  Takes the current filtered pressure as the new base pressure without
+	restarting the filters, for re-zeroing on the pad as the weather changes.
+	Returns RPi_NotInitialized while calibrating.
+*/
+Error_Returns altimeter_rezero();
+
+bool altimeter_is_ready();
+
+/*  Moves every barometer to the sampling profile for the flight phase, new
+	samples are then only read as often as the barometers produce them.  Starts
+	out on barometer_profile_pad.
+*/
+Error_Returns altimeter_set_sampling_profile(Barometer_Sampling_Profile profile);
+
+/*  Has every barometer keep its raw samples for logging, see
+	barometer_set_raw_logging().  Compensating them is left to the logger.
+*/
+Error_Returns altimeter_set_raw_logging(bool enable);
+
+/*  Selects how pressure is converted to altitude, switching models carries on
+	from the current altitude.
+*/
+void altimeter_set_altitude_model(Altimeter_Altitude_Model model);
+
 Error_Returns altimeter_update_altitude();
 
 int32_t altimeter_get_delta();
+
+/*  Returns the filtered altitude cached from the latest barometer sample along
+	with when it was read and its sequence number, readers can compare sequence
+	numbers to tell whether a new sample has arrived.
+*/
+void altimeter_get_altitude(Altimeter_Altitude_t *altitude);
+
+/*  Number of times barometer readings have been converted to altitude, one per
+	new sample after calibration and one each time the base pressure is set.
+*/
+uint32_t altimeter_get_conversion_count();
+
+//Number of new samples read from the barometers, calibration ones included
+uint32_t altimeter_get_sample_count();
+
+//Number of barometers still being fused, failed or drifting ones are dropped until the next reset
+uint32_t altimeter_get_barometer_count();
+
+/*  Feeds a vertical acceleration reading taken at time_stamp (microseconds since
+	boot) into the altitude/velocity/acceleration estimator, kinematics_update()
+	calls it with each new accelerometer sample.  Returns RPi_NotInitialized
+	while calibrating, the estimator starts over once the base pressure is set.
+*/
+Error_Returns altimeter_update_acceleration(int32_t acceleration, uint32_t time_stamp);
+
+/*  Returns the latest altitude/velocity/acceleration estimate predicted forward
+	to the current time, does not wait for or read a sensor.
+*/
+void altimeter_get_state(Altimeter_State_t *state);
@@ -0,0 +1,46 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altitude_history.h
+Interface into the altitude history used to find the climb rate and predict apogee.
+
+*/
+
+#pragma once
+#include "common.h"
+
+//Number of samples the climb rate is fitted over
+#define ALTITUDE_HISTORY_CAPACITY 24
+//Samples needed before a climb rate is available
+#define ALTITUDE_HISTORY_MINIMUM_SAMPLES 4
+
+void altitude_history_reset();
+
+/*  Adds an altitude in millimeters read at time_stamp (microseconds since boot),
+	the oldest sample is dropped once the history is full.
+*/
+void altitude_history_add(int32_t altitude, uint32_t time_stamp);
+
+/*  Returns the least squares climb rate across the history in millimeters/second,
+	RPi_NotInitialized is returned until there are enough samples.
+*/
+Error_Returns altitude_history_get_climb_rate(int32_t *climb_rate_ptr);
+
+/*  Returns the time in milliseconds until the climb rate reaches zero when
+	decelerating at 1G.  Drag only shortens this so it is an upper bound, zero
+	is returned when already descending.
+*/
+Error_Returns altitude_history_get_time_to_apogee(uint32_t *time_ptr);
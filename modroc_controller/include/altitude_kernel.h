@@ -0,0 +1,71 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altitude_kernel.h
+Interface into the fixed point pressure to altitude conversion.
+
+Pressures are passed in pascals as unsigned Q24.8 values, altitudes are
+returned in millimeters.  The conversion is the barometric formula from the
+Bosch BMP180 datasheet, looked up in a table generated at build time by
+tools/generate_altitude_table.py and linearly interpolated.  For pressure
+ratios between 0.25 and 1.25 the result is within ALTITUDE_TABLE_MAXIMUM_ERROR_MM
+(under 50mm, worst at the 0.25 end) of the floating point formula, ratios
+outside that range are clamped to its ends.
+
+The hypsometric model works from ln of the same pressure ratio, looked up in a
+second generated table, and a temperature.  Its table error is within
+LOG_RATIO_TABLE_MAXIMUM_ERROR_MM at 300K.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define ALTITUDE_PRESSURE_FRACTION_BITS	8
+
+//Pressure ratio lookup layout, tools/generate_altitude_table.py has to match
+#define ALTITUDE_RATIO_FRACTION_BITS	30
+#define ALTITUDE_RATIO_MINIMUM			(1UL << (ALTITUDE_RATIO_FRACTION_BITS - 2))  //0.25
+#define ALTITUDE_INDEX_BITS				9
+#define ALTITUDE_INTERPOLATION_BITS		14
+#define ALTITUDE_LOG_FRACTION_BITS		23
+#define ALTITUDE_CLIMB_FRACTION_BITS	31
+
+/* Returns the value altitude_kernel_get_altitude() needs to compare pressures
+   against base_pressure.  This does a 64 bit divide so it should only be called
+   when the base pressure changes.  Base pressures below 32768 pascals are
+   not supported and return 0.
+*/
+uint32_t altitude_kernel_get_base_reciprocal(uint32_t base_pressure);
+
+/* Returns the altitude in millimeters of pressure above the base pressure
+   that base_reciprocal was calculated from.
+*/
+int32_t altitude_kernel_get_altitude(uint32_t pressure, uint32_t base_reciprocal);
+
+/* Returns ln of the ratio of pressure to the base pressure in Q8.23, clamped
+   to the same range as altitude_kernel_get_altitude().
+*/
+int32_t altitude_kernel_get_log_ratio(uint32_t pressure, uint32_t base_reciprocal);
+
+/* Returns the climb across a layer of air at temperature, in hundredths of a
+   degree C as the BME280 reports it, over which the log pressure ratio fell by
+   log_ratio_fall.  Summing this over each sample gives the hypsometric altitude
+   using the temperature actually measured along the way.  The climb is in
+   millimeters with ALTITUDE_CLIMB_FRACTION_BITS of fraction so the sum doesn't
+   pick up a rounding error every sample, shift it down to get millimeters.
+*/
+int64_t altitude_kernel_get_hypsometric_climb(int32_t log_ratio_fall, int32_t temperature);
@@ -24,11 +24,35 @@ Interface into the support software for a variety of barometric pressure chips.
 */
 
 #pragma once
+#include <stdbool.h>
 #include "hardware/i2c.h"
+#include "hardware/spi.h"
 
 #include "common.h"
 
-#define BAROMETER_NUMBER_SUPPORTED_DEVICES 2
+#define BAROMETER_NUMBER_SUPPORTED_DEVICES 4
+#define BAROMETER_RAW_BATCH_SIZE 16
+
+//Trade off between sample rate, noise and bus time/power for each flight phase
+typedef enum {
+	barometer_profile_pad,  //Low rate, high oversampling
+	barometer_profile_ascent,  //Highest output rate
+	barometer_profile_descent,  //Medium rate
+	barometer_profile_count
+} Barometer_Sampling_Profile;
+
+//Uncompensated reading as the chip gave it, for logging every sample cheaply
+typedef struct Barometer_Raw_Sample_S {
+	uint32_t time_stamp;  //When it was read, in microseconds since boot
+	int32_t raw_temperature;
+	int32_t raw_pressure;
+} Barometer_Raw_Sample;
+
+typedef struct Barometer_Raw_Batch_S {
+	uint32_t count;
+	uint32_t dropped;  //Batches lost just before this one because the reader fell behind
+	Barometer_Raw_Sample samples[BAROMETER_RAW_BATCH_SIZE];
+} Barometer_Raw_Batch;
 
 /*  Initializes a barometer with the given address on the specified I2C bus, 
 	if the maximum number of barometers are exceeded or the barometer chip fails 
@@ -38,6 +62,51 @@ Interface into the support software for a variety of barometric pressure chips.
 	
 Error_Returns barometer_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address);
 
+/*  Same as barometer_init() for a barometer on the SPI bus with the given chip
+	select.  The bus and the chip select pin have to be set up already, other
+	chips can share the bus on their own chip selects.
+*/
+Error_Returns barometer_init_spi(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
+
 Error_Returns barometer_reset(uint32_t id);
 
-Error_Returns barometer_get_current_pressure(uint32_t id, uint32_t *pressure_ptr);
+/*  Reprograms the barometer's oversampling, standby time and filtering for the
+	profile and returns how often, in microseconds, it will then have a new
+	sample.
+*/
+Error_Returns barometer_set_sampling_profile(uint32_t id, Barometer_Sampling_Profile profile, uint32_t *sample_period_ptr);
+
+/*  Returns the latest pressure the chip converted, new_sample_ptr is false if
+	the caller has already had it.  Drivers only go to the bus when the chip could
+	have a new sample, so this can be called every pass of the flight loop.
+	Drivers that read asynchronously return RPi_InUse while the reading is still
+	being transferred, call again later to pick it up.
+*/
+Error_Returns barometer_get_current_pressure(uint32_t id, uint32_t *pressure_ptr, bool *new_sample_ptr);
+
+/*  Returns the temperature, in hundredths of a degree C, the chip measured along
+	with the last pressure reading.  Nothing is read from the chip.
+*/
+Error_Returns barometer_get_last_temperature(uint32_t id, int32_t *temperature_ptr);
+
+/*  Returns when, in microseconds since boot, the last pressure reading was
+	measured.  Barometers convert on their own schedules and are read at
+	different times, this lets their readings be lined up with each other.
+*/
+Error_Returns barometer_get_sample_time(uint32_t id, uint32_t *time_stamp_ptr);
+
+/*  While raw logging is on every new sample the barometer reads is also kept,
+	uncompensated, in batches for barometer_get_raw_batch().  Turning it off
+	hands over the part filled batch.
+*/
+Error_Returns barometer_set_raw_logging(uint32_t id, bool enable);
+
+//Safe to call from the other core, returns false if there is no full batch waiting
+bool barometer_get_raw_batch(uint32_t id, Barometer_Raw_Batch *batch_ptr);
+
+/*  Compensates a logged sample with the barometer's calibration, safe to call
+	from the other core.  Pressure is pascals x 100, temperature hundredths of a
+	degree C.
+*/
+Error_Returns barometer_compensate_raw_sample(uint32_t id, const Barometer_Raw_Sample *sample_ptr,
+	uint32_t *pressure_ptr, int32_t *temperature_ptr);
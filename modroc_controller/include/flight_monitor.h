@@ -32,9 +32,24 @@ accelerometer reading.
 #include "common.h"
 #include "message.h"
 
+typedef enum {
+	phase_initial,
+	phase_pad_idle,
+	phase_ascent,
+	phase_descent,
+	phase_ground_idle
+} Flight_Phase;
+
 //Basic loop to handle monitoring and control of the flight
 //only returns if something fails
 void flight_monitor();
 
+/*  One pass of the flight monitor loop, steps the flight phase and updates the
+	altimeter and kinematics.  The host replay calls it in place of flight_monitor().
+*/
+Error_Returns flight_monitor_update();
+
+Flight_Phase flight_monitor_get_phase();
+
 void flight_monitor_set_timer_intervals(int32_t ascent_timer_interval_ms,
 	int32_t descent_timer_interval_ms);
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  kalman_math.h
+Arithmetic used by the altimeter Kalman filters.
+
+The number type is picked at build time by defining KALMAN_BACKEND to one of
+the KALMAN_BACKEND_ values below, the CMake cache variable ALTIMETER_KALMAN_BACKEND
+does this.  Filter code is written only in terms of Kalman_Value and these
+macros so it is identical for all three.  The Cortex-M0+ has no FPU so fixed
+point is the default, it is signed Q15.16 with 64 bit intermediate products,
+which limits every filter quantity to +/-32767.
+
+*/
+
+#pragma once
+#include "common.h"
+
+#define KALMAN_BACKEND_DOUBLE	0
+#define KALMAN_BACKEND_FLOAT	1
+#define KALMAN_BACKEND_FIXED	2
+
+#ifndef KALMAN_BACKEND
+#define KALMAN_BACKEND KALMAN_BACKEND_FIXED
+#endif
+
+#if KALMAN_BACKEND == KALMAN_BACKEND_FIXED
+
+typedef int32_t Kalman_Value;
+
+#define KALMAN_FRACTION_BITS	16
+#define KALMAN_ONE				(1L << KALMAN_FRACTION_BITS)
+
+//Only for compile time constants, it relies on the compiler folding the double
+#define KALMAN_CONSTANT(x)		((Kalman_Value)((x) * KALMAN_ONE + ((x) < 0 ? -0.5 : 0.5)))
+#define KALMAN_FROM_INT(x)		((Kalman_Value)((x) * KALMAN_ONE))
+#define KALMAN_TO_INT(x)		((int32_t)((x) >> KALMAN_FRACTION_BITS))
+
+/* Integer x / divisor and value * multiplier as integer, both done with a
+   multiply and shift.  The divisor reciprocal is folded at compile time so
+   no divide is generated.
+*/
+#define KALMAN_FROM_FRACTION(x, divisor)	((Kalman_Value)(((int64_t)(x) * \
+			(((1LL << (2 * KALMAN_FRACTION_BITS)) + (divisor) / 2) / (divisor))) >> KALMAN_FRACTION_BITS))
+#define KALMAN_TO_SCALED(x, multiplier)	((int32_t)(((int64_t)(x) * (multiplier)) >> KALMAN_FRACTION_BITS))
+
+#define KALMAN_MUL(a, b)		((Kalman_Value)(((int64_t)(a) * (b)) >> KALMAN_FRACTION_BITS))
+#define KALMAN_DIV(a, b)		((Kalman_Value)(((int64_t)(a) * KALMAN_ONE) / (b)))
+#define KALMAN_ABS(a)			((a) < 0 ? -(a) : (a))
+
+/* a * b * b / 2 for a time step b, in one product and shift so a step of a few
+   milliseconds doesn't square to nothing first.  Under a second the product
+   fits in 64 bits, longer steps square fine on their own.
+*/
+#define KALMAN_MUL_HALF_SQUARE(a, b)	(((b) < KALMAN_ONE) ? \
+			(Kalman_Value)(((int64_t)(a) * (b) * (b)) >> (2 * KALMAN_FRACTION_BITS + 1)) : \
+			(KALMAN_MUL(KALMAN_MUL(a, b), b) / 2))
+
+#else
+
+#if KALMAN_BACKEND == KALMAN_BACKEND_FLOAT
+typedef float Kalman_Value;
+#define KALMAN_ABS(a)			fabsf(a)
+#elif KALMAN_BACKEND == KALMAN_BACKEND_DOUBLE
+typedef double Kalman_Value;
+#define KALMAN_ABS(a)			fabs(a)
+#else
+#error "KALMAN_BACKEND must be KALMAN_BACKEND_DOUBLE, KALMAN_BACKEND_FLOAT or KALMAN_BACKEND_FIXED"
+#endif
+
+#include <math.h>
+
+#define KALMAN_CONSTANT(x)		((Kalman_Value)(x))
+#define KALMAN_FROM_INT(x)		((Kalman_Value)(x))
+#define KALMAN_TO_INT(x)		((int32_t)floor(x))
+#define KALMAN_FROM_FRACTION(x, divisor)	((Kalman_Value)(x) / (Kalman_Value)(divisor))
+#define KALMAN_TO_SCALED(x, multiplier)	((int32_t)floor((x) * (multiplier)))
+
+#define KALMAN_MUL(a, b)		((a) * (b))
+#define KALMAN_DIV(a, b)		((a) / (b))
+#define KALMAN_MUL_HALF_SQUARE(a, b)	((a) * (b) * (b) / 2)
+
+#endif
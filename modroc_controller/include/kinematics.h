@@ -26,3 +26,9 @@ Error_Returns kinematics_initialize(uint32_t *accelerometer_id_array, uint32_t n
 
 Error_Returns kinematics_reset();
 
+/*  Collects new samples from the accelerometers, called from the flight loop.
+	Each new sample's vertical acceleration is fed to the altimeter's estimator
+	once the altimeter is ready.
+*/
+Error_Returns kinematics_update();
+
@@ -44,14 +44,15 @@ typedef enum {
 typedef struct Log_Ascent_Parameters_S
 {
 	int32_t altitude;  //In meters
-	uint16_t z_acceleration;  // In meters/second2
-	uint16_t z_velocity;  //In meters/second
+	int16_t z_acceleration;  // In meters/second2
+	int16_t z_velocity;  //In meters/second
 } Log_Ascent_Parameters_t;
 
 typedef struct Log_Descent_Parameters_S
 {
 	int32_t altitude;  //In meters
 	double temperature;  // In degrees C
+	double humidity;  // In percent relative humidity
 } Log_Descent_Parameters_t;
 
 typedef struct Log_Message_S
@@ -0,0 +1,50 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  profile.h
+
+Hooks marking the stages of the altimeter pipeline so their cost can be
+measured.  They compile to nothing unless MODROC_PROFILE is defined, the host
+replay harness in host/ defines it and supplies the functions.
+
+*/
+
+#pragma once
+#include "common.h"
+
+typedef enum {
+	profile_stage_compensation,  //Raw ADC readings to pressure and temperature
+	profile_stage_filtering,  //Per barometer pressure Kalman filters
+	profile_stage_conversion,  //Pressure to altitude and barometer fusion
+	profile_stage_estimation,  //Altitude/velocity/acceleration estimator
+	profile_stage_log_compensation,  //Logged raw samples, on the output core
+	profile_stage_count
+} Profile_Stage;
+
+#ifdef MODROC_PROFILE
+
+void profile_stage_begin(Profile_Stage stage);
+void profile_stage_end(Profile_Stage stage);
+
+#define PROFILE_STAGE_BEGIN(stage)	profile_stage_begin(stage)
+#define PROFILE_STAGE_END(stage)	profile_stage_end(stage)
+
+#else
+
+#define PROFILE_STAGE_BEGIN(stage)
+#define PROFILE_STAGE_END(stage)
+
+#endif
@@ -26,16 +26,30 @@ and barometric pressure chips.
 
 #pragma once
 #include "hardware/i2c.h"
+#include <stdbool.h>
+#include "hardware/spi.h"
 
 #include "common.h"
 
 #define THERMOMETER_NUMBER_SUPPORTED_DEVICES 1
+#define THERMOMETER_HUMIDITY_SCALE 1024.0  //Chips report percent relative humidity x 1024
 
 /*  Initializes a thermometer with the given address on the specified I2C bus.  Only supports one thermometer so multiple calls will just be a no op.
 */
 	
 Error_Returns thermometer_init(i2c_inst_t *i2c, uint32_t address);
 
+//Same for a thermometer on the SPI bus with the given chip select
+Error_Returns thermometer_init_spi(spi_inst_t *spi, uint32_t chip_select);
+
 Error_Returns thermometer_reset();
 
 double thermometer_get_current_temperature();
+
+/*  Humidity is off to start with, turning it on makes each sample take a little
+	longer.  Returns RPi_NotInitialized if there is no thermometer.
+*/
+Error_Returns thermometer_set_humidity(bool enable);
+
+//Percent relative humidity, 0.0 while humidity is off
+double thermometer_get_current_humidity();
@@ -33,6 +33,14 @@ struct inv_icm20948;
 */
 int INV_EXPORT inv_icm20948_firmware_load(struct inv_icm20948 * s, const unsigned char *data, unsigned short size, unsigned short load_addr);
 
+/** @brief Checks whether DMP memory still holds the image's program, as it does after a reset of the host alone
+* @param[in] data  pointer where the image 
+* @param[in] size  size if the image
+* @param[in] load_addr  address the image was loaded at
+* @return 1 if the program is there, 0 if it has to be loaded
+*/
+int INV_EXPORT inv_icm20948_firmware_present(struct inv_icm20948 * s, const unsigned char *data, unsigned short size, unsigned short load_addr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,12 +40,13 @@ extern "C" {
 /* forward declaration */
 struct inv_icm20948;
 
-/** @brief Max size that can be read across I2C or SPI data lines */
-//#define INV_MAX_SERIAL_READ 16
-#define INV_MAX_SERIAL_READ 2
+/** @brief Max size that can be read across I2C or SPI data lines, the hardware FIFO size
+ *         so a full FIFO is drained in one burst by the DMA serif in icm20948.c */
+#define INV_MAX_SERIAL_READ 1024
 /** @brief Max size that can be written across I2C or SPI data lines */
-//#define INV_MAX_SERIAL_WRITE 16
-#define INV_MAX_SERIAL_WRITE 2
+#define INV_MAX_SERIAL_WRITE 1024
+/** @brief Register writes held by an open write batch before it is flushed to the chip */
+#define INV_WRITE_BATCH_SIZE 16
 
 void INV_EXPORT inv_icm20948_transport_init(struct inv_icm20948 * s);
 
@@ -159,6 +160,20 @@ int INV_EXPORT inv_icm20948_write_mems(struct inv_icm20948 * s, unsigned short r
 */
 int INV_EXPORT inv_icm20948_write_single_mems_reg_core(struct inv_icm20948 * s, uint16_t reg, const uint8_t data);
 
+/** @brief Opens a write batch, register writes made through inv_icm20948_write_single_mems_reg()
+*          and inv_icm20948_write_mems_reg() are queued instead of sent.  The queue goes out in
+*          order with one wake, one LP_EN toggle and a bank switch only where the bank changes,
+*          writes to following registers in a bank are merged into one burst.  Any read or DMP
+*          memory access flushes the queue first, power state changes are not queued.
+* @return 	   		0 in case of success, -1 if a batch is already open
+*/
+int INV_EXPORT inv_icm20948_write_batch_open(struct inv_icm20948 * s);
+
+/** @brief Sends any queued writes and closes the batch
+* @return 	   		0 in case of success
+*/
+int INV_EXPORT inv_icm20948_write_batch_commit(struct inv_icm20948 * s);
+
 #ifdef __cplusplus
 }
 #endif
@@ -176,6 +176,12 @@ typedef struct inv_icm20948 {
 	unsigned char reg;
 	unsigned char lastBank;
 	unsigned char lLastBankSelected;
+	struct {
+		uint16_t reg[INV_WRITE_BATCH_SIZE];
+		uint8_t data[INV_WRITE_BATCH_SIZE];
+		uint8_t count;
+		uint8_t open;
+	} write_batch;
 	/* augmented sensors*/
 	unsigned short sGravityOdrMs;
 	unsigned short sGrvOdrMs;
@@ -187,6 +193,9 @@ typedef struct inv_icm20948 {
 	unsigned short sOriOdrMs;
 	unsigned short sRvWuOdrMs;
 	unsigned short sOriWuOdrMs;
+	/* Time in us the MEMS IRQ fired, set by a platform interrupt handler ahead of
+	   polling, 0 timestamps the FIFO at poll time instead */
+	uint64_t irq_time_us;
 	/* Icm20649Setup */
 	short set_accuracy;
 	int new_accuracy;
@@ -26,6 +26,7 @@ and barometric pressure chip.
 
 #pragma once
 #include "hardware/i2c.h"
+#include "hardware/spi.h"
 
 #include "common.h"
 #include "barometer.h"
@@ -35,10 +36,42 @@ typedef int BME280_S32_t;
 typedef unsigned int BME280_U32_t;
 typedef long long signed int BME280_S64_t;
 
+/* Conversions that come out the same as the one before are taken as new ones
+   this many times in a row, after that the chip is taken as stuck and has no
+   new samples until its data changes.
+*/
+#define BME280_MAXIMUM_REPEATS	2
+
+//Returns the existing id if the chip at address on i2c was already initialized
 Error_Returns bme280_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address);
 
+//Same for a chip on spi, the chip select pin has to be an output held high
+Error_Returns bme280_init_spi(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
+
 Error_Returns bme280_reset(uint32_t id);
 
-Error_Returns bme280_get_current_pressure(uint32_t id, uint32_t *pressure_ptr);
+Error_Returns bme280_set_sampling_profile(uint32_t id, Barometer_Sampling_Profile profile, uint32_t *sample_period_ptr);
 
+Error_Returns bme280_get_current_pressure(uint32_t id, uint32_t *pressure_ptr, bool *new_sample_ptr);
+
+//Only reads the chip if it could have a newer sample than the last pressure read
 Error_Returns bme280_get_current_temperature(uint32_t id, int32_t *temperature_ptr);
+
+//Temperature compensated during the last bme280_get_current_pressure(), no bus traffic
+Error_Returns bme280_get_last_temperature(uint32_t id, int32_t *temperature_ptr);
+
+//Humidity is read in the same burst as pressure and temperature while it is on
+Error_Returns bme280_set_humidity(uint32_t id, bool enable);
+
+//Percent relative humidity x 1024, RPi_NotInitialized while humidity is off
+Error_Returns bme280_get_current_humidity(uint32_t id, uint32_t *humidity_ptr);
+
+//Halfway between the last time the chip was seen without the sample and when it was read
+Error_Returns bme280_get_sample_time(uint32_t id, uint32_t *time_stamp_ptr);
+
+Error_Returns bme280_set_raw_logging(uint32_t id, bool enable);
+
+bool bme280_get_raw_batch(uint32_t id, Barometer_Raw_Batch *batch_ptr);
+
+Error_Returns bme280_compensate_raw_sample(uint32_t id, const Barometer_Raw_Sample *sample_ptr,
+	uint32_t *pressure_ptr, int32_t *temperature_ptr);
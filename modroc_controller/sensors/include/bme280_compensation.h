@@ -0,0 +1,93 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_compensation.h
+
+Turns the BME 280's raw ADC readings into temperature, pressure and humidity using the
+calibration block read out of the chip.  Kept apart from the driver so samples
+can also be compensated later, away from the chip, from a copy of the block.
+
+Pressure compensation is picked at build time by defining BME280_COMPENSATION,
+the CMake cache variable BME280_PRESSURE_COMPENSATION does that for the firmware:
+	BME280_COMPENSATION_64BIT  Bosch's 64 bit integer version, 1/256 Pa resolution
+	BME280_COMPENSATION_32BIT  Bosch's 32 bit integer version, 1 Pa resolution but
+	                           no 64 bit divides, which the M0+ does in software
+
+*/
+
+#pragma once
+#include <stdint.h>
+
+#define BME280_COMPENSATION_64BIT	0
+#define BME280_COMPENSATION_32BIT	1
+
+#ifndef BME280_COMPENSATION
+#define BME280_COMPENSATION BME280_COMPENSATION_64BIT
+#endif
+
+#define BME280_PRESSURE_TRIM_BYTES	24  //dig_T1 to dig_P9 starting at 0x88
+#define BME280_HUMIDITY_TRIM_BYTES	7  //dig_H2 to dig_H6 starting at 0xE1
+
+typedef struct BME280_Calibration_S {
+	unsigned short dig_T1;
+	signed short dig_T2;
+	signed short dig_T3;
+
+	unsigned short dig_P1;
+	signed short dig_P2;
+	signed short dig_P3;
+	signed short dig_P4;
+	signed short dig_P5;
+	signed short dig_P6;
+	signed short dig_P7;
+	signed short dig_P8;
+	signed short dig_P9;
+
+	unsigned char dig_H1;
+	signed short dig_H2;
+	unsigned char dig_H3;
+	signed short dig_H4;
+	signed short dig_H5;
+	signed char dig_H6;
+	
+	//Terms that only depend on the calibration, worked out once when it is unpacked
+	int64_t p4_term_64bit;
+	int32_t p4_term_32bit;
+	int32_t p7_term_64bit;
+} BME280_Calibration;
+
+//Unpacks the calibration registers as read from the chip
+void bme280_calibration_unpack(BME280_Calibration *calibration_ptr, const unsigned char *pressure_trim,
+	unsigned char dig_H1, const unsigned char *humidity_trim);
+
+//Hundredths of a degree C, t_fine is what pressure and humidity compensation need
+int32_t bme280_compensate_temperature(const BME280_Calibration *calibration_ptr, int32_t adc_T, int32_t *t_fine_ptr);
+
+//Both return pascals x 100
+uint32_t bme280_compensate_pressure_64bit(const BME280_Calibration *calibration_ptr, int32_t adc_P, int32_t t_fine);
+uint32_t bme280_compensate_pressure_32bit(const BME280_Calibration *calibration_ptr, int32_t adc_P, int32_t t_fine);
+
+//Percent relative humidity x 1024, 32 bit only
+uint32_t bme280_compensate_humidity(const BME280_Calibration *calibration_ptr, int32_t adc_H, int32_t t_fine);
+
+#if BME280_COMPENSATION == BME280_COMPENSATION_32BIT
+#define bme280_compensate_pressure bme280_compensate_pressure_32bit
+#else
+#define bme280_compensate_pressure bme280_compensate_pressure_64bit
+#endif
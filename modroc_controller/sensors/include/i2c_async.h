@@ -0,0 +1,67 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  i2c_async.h
+
+Interface into the asynchronous I2C register reads.  A read is queued on the
+bus's DMA channels and returns straight away, the callback is run from the
+interrupt when it finishes so the caller can get on with other work while the
+bytes are on the wire.  Each bus runs its own reads, so devices on i2c0 and
+i2c1 can be read at the same time.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include "hardware/i2c.h"
+
+#include "common.h"
+
+#define I2C_ASYNC_MAXIMUM_READ	32  //Bytes in one read
+#define I2C_ASYNC_QUEUE_DEPTH	4  //Reads that can wait behind the one in progress
+
+//Run from interrupt context when a read finishes, status is RPi_Success or the bus error
+typedef void (*I2C_Async_Callback)(void *context, Error_Returns status);
+
+/*  Claims the DMA channels and interrupts for asynchronous reads on the bus,
+	calling it again for the same bus is a no op.  Returns RPi_InsufficientResources
+	if there aren't two free DMA channels, the bus can still be used blocking.
+*/
+Error_Returns i2c_async_init(i2c_inst_t *i2c);
+
+bool i2c_async_is_available(i2c_inst_t *i2c);
+
+/*  Starts reading length bytes from register onwards of the device at address
+	into buffer, which has to stay valid until the callback runs.  A read asked
+	for while the bus is busy waits its turn behind the others, RPi_InUse is
+	only returned once I2C_ASYNC_QUEUE_DEPTH are waiting.
+*/
+Error_Returns i2c_async_read(i2c_inst_t *i2c, uint8_t address, uint8_t register_address,
+	uint8_t *buffer, uint32_t length, I2C_Async_Callback callback, void *context);
+
+//True until every read queued on the bus has finished
+bool i2c_async_is_busy(i2c_inst_t *i2c);
+
+/*  Waits up to timeout microseconds for the reads queued on the bus to finish,
+	blocking transfers have to call this first.  On a timeout the read in progress
+	is aborted, it and the ones queued behind it have their callbacks run with
+	I2CS_Clock_Timeout and that is returned.
+*/
+Error_Returns i2c_async_wait(i2c_inst_t *i2c, uint32_t timeout);
@@ -29,6 +29,39 @@ Interface into the support software for the InvenSense ICM-20948 9-axis motion t
 #include "common.h"
 #include "accelerometer.h"
 
-Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
+/*  SPI traffic to one chip, transactions is the number of chip select cycles and
+	select_time the microseconds chip select was held low across all of them.
+*/
+typedef struct ICM20948_Bus_Statistics {
+	uint32_t transactions;
+	uint64_t select_time;
+} ICM20948_Bus_Statistics;
+
+#define ICM20948_ACCELERATION_PER_G	2048  //Raw counts, at the 16 g full scale icm20948_init() sets
+
+/*  Latest raw accelerometer sample out of the DMP FIFO, rotated into the body
+	frame.  The time stamp is spread back from when INT1 fired across the
+	samples drained on that interrupt.
+*/
+typedef struct ICM20948_Acceleration {
+	int32_t acceleration[3];
+	uint64_t time_stamp;  //In microseconds since boot
+	uint32_t sequence;  //Incremented for every new sample
+} ICM20948_Acceleration;
+
+/*  interrupt_pin is the GPIO wired to the chip's INT1, its rising edge marks
+	data in the DMP FIFO.
+*/
+Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin);
 
 Error_Returns icm20948_reset(uint32_t id);
+
+/*  Drains the DMP FIFO if INT1 has fired since the last call, otherwise returns
+	straight away without touching the bus.
+*/
+Error_Returns icm20948_update(uint32_t id);
+
+Error_Returns icm20948_get_acceleration(uint32_t id, ICM20948_Acceleration *acceleration);
+
+//Returns the SPI traffic counters for the chip, RPi_InvalidParam if the ID isn't initialized
+Error_Returns icm20948_get_bus_statistics(uint32_t id, ICM20948_Bus_Statistics *statistics);
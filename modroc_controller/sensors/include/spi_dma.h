@@ -0,0 +1,59 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  spi_dma.h
+
+Interface into the DMA burst transfers on the SPI buses.  A burst of any length
+is clocked by two DMA channels, one feeding the TX FIFO and one emptying the RX
+FIFO, rather than the CPU servicing the FIFOs a byte at a time.  Transfers wait
+for the burst to finish, so the chip select can be raised straight after.
+
+Chips on their own chip selects share a bus, the ICM-20948 and a BME280 share
+spi0.  Every driver holds the bus lock from lowering its chip select to raising
+it, so a transaction from one core can't be clocked over by the other.
+
+*/
+
+#pragma once
+#include <stdbool.h>
+#include "hardware/spi.h"
+
+#include "common.h"
+
+/*  Claims the DMA channels for bursts on the bus, calling it again for the
+	same bus is a no op.  Returns RPi_InsufficientResources if there aren't two
+	free DMA channels, the bus can still be used blocking.
+*/
+Error_Returns spi_dma_init(spi_inst_t *spi);
+
+/*  Waits for and takes the bus, whether or not it has DMA.  Transactions don't
+	nest, the same core taking it twice never gets it.
+*/
+void spi_dma_lock_bus(spi_inst_t *spi);
+
+void spi_dma_unlock_bus(spi_inst_t *spi);
+
+bool spi_dma_is_available(spi_inst_t *spi);
+
+//Clocks length bytes out of src, what comes back is thrown away
+Error_Returns spi_dma_write(spi_inst_t *spi, const uint8_t *src, uint32_t length);
+
+//Clocks out repeated_tx_data length times and keeps what comes back in dst
+Error_Returns spi_dma_read(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, uint32_t length);
@@ -255,6 +255,7 @@ int inv_icm20948_initialize_lower_driver(struct inv_icm20948 * s, enum SMARTSENS
 	result |= dmp_icm20948_set_FIFO_watermark(s, 800);
 
 	// Enable Interrupts.
+	result |= inv_icm20948_write_batch_open(s);
 	data = 0x2;
 	result |= inv_icm20948_write_mems_reg(s, REG_INT_ENABLE, 1, &data); // Enable DMP Interrupt
 	data = 0x1;
@@ -263,6 +264,7 @@ int inv_icm20948_initialize_lower_driver(struct inv_icm20948 * s, enum SMARTSENS
 	// TRACKING : To have accelerometers datas and the interrupt without gyro enables.
 	data = 0XE4;
 	result |= inv_icm20948_write_mems_reg(s, REG_SINGLE_FIFO_PRIORITY_SEL, 1, &data);
+	result |= inv_icm20948_write_batch_commit(s);
 
 	// Disable HW temp fix
 	inv_icm20948_read_mems_reg(s, REG_HW_FIX_DISABLE,1,&data);
@@ -279,12 +281,14 @@ int inv_icm20948_initialize_lower_driver(struct inv_icm20948 * s, enum SMARTSENS
 	dmp_icm20948_set_bac_rate(s, DMP_ALGO_FREQ_56);
 	dmp_icm20948_set_b2s_rate(s, DMP_ALGO_FREQ_56);
 
-	// FIFO Setup.
-	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_CFG, BIT_SINGLE_FIFO_CFG); // FIFO Config. fixme do once? burst write?
+	// FIFO Setup, one LP_EN toggle for the lot and the FIFO_EN pair in one burst.
+	result |= inv_icm20948_write_batch_open(s);
+	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_CFG, BIT_SINGLE_FIFO_CFG); // FIFO Config.
 	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_RST, 0x1f); // Reset all FIFOs.
 	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_RST, 0x1e); // Keep all but Gyro FIFO in reset.
 	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_EN, 0x0); // Slave FIFO turned off.
 	result |= inv_icm20948_write_single_mems_reg(s, REG_FIFO_EN_2, 0x0); // Hardware FIFO turned off.
+	result |= inv_icm20948_write_batch_commit(s);
     
 	s->base_state.lp_en_support = 1;
 	
@@ -17,38 +17,142 @@
 #include "Icm20948Defs.h"
 #include "Icm20948DataBaseDriver.h"
 
+#define DMP_MEM_BANK_SIZE	0x100
+/* Bytes read back from each end of the image to rule out a warm boot cheaply,
+   a chip that lost its DMP memory fails here before the full check */
+#define DMP_SAMPLE_SIZE		16
+/* The DMP's variables and the configuration the driver writes once the image
+   is in all sit below this, only the program above it is left as loaded */
+#define DMP_PROGRAM_START	0x1000
+
+/* CRC-32 (IEEE 802.3, reflected) a nibble at a time, the full byte table
+   would be a KB of flash for a check run once per boot */
+static const uint32_t crc32_nibble_table[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, unsigned int length)
+{
+	while (length--) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0f];
+		crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0f];
+	}
+	return crc;
+}
+
+/* DMP memory only auto increments within a bank so each transfer stops at the
+   end of one, the whole bank goes in a single burst */
+static unsigned int dmp_transfer_size(unsigned short memaddr, unsigned int size)
+{
+	unsigned int transfer_size = DMP_MEM_BANK_SIZE - (memaddr & 0xff);
+
+	transfer_size = min(transfer_size, size);
+	return min(transfer_size, min(INV_MAX_SERIAL_WRITE, INV_MAX_SERIAL_READ));
+}
+
+// Reads the image's span of DMP memory back a bank at a time and returns its CRC
+static int dmp_readback_crc(struct inv_icm20948 * s, unsigned short memaddr, unsigned int size, uint32_t *crc)
+{
+	unsigned char bank[DMP_MEM_BANK_SIZE];
+	unsigned int read_size;
+	int result;
+
+	*crc = 0xFFFFFFFF;
+	while (size > 0) {
+		read_size = dmp_transfer_size(memaddr, size);
+		result = inv_icm20948_read_mems(s, memaddr, read_size, bank);
+		if (result)
+			return result;
+
+		*crc = crc32_update(*crc, bank, read_size);
+		size -= read_size;
+		memaddr += read_size;
+	}
+	*crc ^= 0xFFFFFFFF;
+
+	return 0;
+}
+
+// Compares a few bytes at address against the image
+static int dmp_sample_matches(struct inv_icm20948 * s, unsigned short memaddr, const unsigned char *data, unsigned int size)
+{
+	unsigned char sample[DMP_SAMPLE_SIZE];
+	unsigned int sample_size = dmp_transfer_size(memaddr, min(size, DMP_SAMPLE_SIZE));
+
+	if (inv_icm20948_read_mems(s, memaddr, sample_size, sample))
+		return 0;
+
+	return (memcmp(sample, data, sample_size) == 0);
+}
+
+/* A watchdog or brown-out reset of the Pico leaves the ICM-20948 powered, if
+   its DMP memory still holds this image there is nothing to load.  The driver
+   has patched the image's variables since, so only the program is compared.
+   Both ends are sampled first so a cold chip costs two short reads, only a
+   likely match pays for the full readback. */
+int inv_icm20948_firmware_present(struct inv_icm20948 * s, const unsigned char *data, unsigned short size, unsigned short load_addr)
+{
+	unsigned int program_offset = (load_addr < DMP_PROGRAM_START) ? DMP_PROGRAM_START - load_addr : 0;
+	unsigned int program_size;
+	unsigned int tail_offset;
+	uint32_t program_crc;
+	uint32_t memory_crc;
+
+	if (program_offset >= size)
+		return 0;
+	data += program_offset;
+	program_size = size - program_offset;
+	load_addr += program_offset;
+	tail_offset = (program_size > DMP_SAMPLE_SIZE) ? program_size - DMP_SAMPLE_SIZE : 0;
+
+	if (!dmp_sample_matches(s, load_addr, data, program_size))
+		return 0;
+	if (!dmp_sample_matches(s, load_addr + tail_offset, data + tail_offset, program_size - tail_offset))
+		return 0;
+	if (dmp_readback_crc(s, load_addr, program_size, &memory_crc))
+		return 0;
+
+	program_crc = crc32_update(0xFFFFFFFF, data, program_size) ^ 0xFFFFFFFF;
+	return (memory_crc == program_crc);
+}
+
 int inv_icm20948_firmware_load(struct inv_icm20948 * s, const unsigned char *data_start, unsigned short size_start, unsigned short load_addr)
 { 
-    int write_size;
+    unsigned int write_size;
     int result;
     unsigned short memaddr;
     const unsigned char *data;
     unsigned short size;
-    unsigned char data_cmp[INV_MAX_SERIAL_READ];
-    int flag = 0;
-	int retry_count = 0;
-	int mem_cmp_results = 0;
+    uint32_t image_crc;
+    uint32_t memory_crc;
 
 	if(s->base_state.firmware_loaded)
 		return 0;
+
+	// Still there from before a reset of the Pico
+	if (inv_icm20948_firmware_present(s, data_start, size_start, load_addr))
+	{
+		printf("inv_icm20948_firmware_load:  DMP image already loaded\n");
+		return 0;
+	}
+
+	image_crc = crc32_update(0xFFFFFFFF, data_start, size_start) ^ 0xFFFFFFFF;
 		
-    // Write DMP memory
+    // Write DMP memory, a bank per burst
     data = data_start;
     size = size_start;
     memaddr = load_addr;
 
     while (size > 0) {
-        write_size = min(size, INV_MAX_SERIAL_WRITE);
-        if ((memaddr & 0xff) + write_size > 0x100) {
-            // Moved across a bank
-            write_size = (memaddr & 0xff) + write_size - 0x100;
-        }
+        write_size = dmp_transfer_size(memaddr, size);
 
-		result = inv_icm20948_write_mems(s, memaddr, write_size, (unsigned char *)data);
+		result = inv_icm20948_write_mems(s, memaddr, write_size, data);
 		if (result) 
 		{	
-			printf("Write DMP memory, result = %d\n", result);
-			//return result;
+			printf("Write DMP memory at 0x%x, result = %d\n", memaddr, result);
+			return result;
 		}
 
         data += write_size;
@@ -56,43 +160,19 @@ int inv_icm20948_firmware_load(struct inv_icm20948 * s, const unsigned char *dat
         memaddr += write_size;
     }
 
-    // Verify DMP memory
-    data = data_start;
-    size = size_start;
-    memaddr = load_addr;
-    while (size > 0) {
-        write_size = min(size, INV_MAX_SERIAL_READ);
-        if ((memaddr & 0xff) + write_size > 0x100) {
-            // Moved across a bank
-            write_size = (memaddr & 0xff) + write_size - 0x100;
-        }	
-		
+    // Verify DMP memory against the image CRC
+	result = dmp_readback_crc(s, load_addr, size_start, &memory_crc);
+	if (result)
+	{
+		printf("Verify DMP memory, result = %d\n", result);
+		return result;
+	}
 
-		result = inv_icm20948_read_mems(s, memaddr, write_size, &data_cmp[0]);
-		if (result)
-		{
-			flag++; // Error, DMP not written correctly
-			printf ("Verify result = %d flag = %d\n", result, flag);
-		}
-		
-		mem_cmp_results = memcmp(data_cmp, data, write_size);
-		if (mem_cmp_results != 0)
-		{
-			printf ("Verify data failed = %hhu dmp = %hhu \n", data_cmp[0], data[0]);
-			return -1;
-		}
-
-		
-        data += write_size;
-        size -= write_size;
-        memaddr += write_size;
-    }
-
-#if defined(WIN32)   
-    //if(!flag)
-      // inv_log("DMP Firmware was updated successfully..\r\n");
-#endif
+	if (memory_crc != image_crc)
+	{
+		printf("Verify DMP memory failed, crc = 0x%08x image = 0x%08x\n", memory_crc, image_crc);
+		return -1;
+	}
 
     return 0;
 }
-
@@ -578,7 +578,7 @@ int inv_icm20948_poll_sensor(struct inv_icm20948 * s, void * context,
 	inv_icm20948_identify_interrupt(s, &int_read_back);
 	
 	if (int_read_back & (BIT_MSG_DMP_INT | BIT_MSG_DMP_INT_0)) {
-		lastIrqTimeUs = inv_icm20948_get_time_us();
+		lastIrqTimeUs = s->irq_time_us ? s->irq_time_us : inv_icm20948_get_time_us();
 		do {
 			unsigned short total_sample_cnt = 0;
 
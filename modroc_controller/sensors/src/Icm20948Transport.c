@@ -55,10 +55,28 @@ long inv_icm20948_get_tick_count(void)
 #include "Icm20948DataBaseDriver.h"
 #include "Icm20948DataBaseControl.h"
 
+/* Values neither bank register can hold, the next access writes the bank */
+#define INV_BANK_UNKNOWN		0x7E
+#define INV_MEM_BANK_UNKNOWN	0xFF
+
+static void inv_invalidate_bank_shadow(struct inv_icm20948 * s)
+{
+	s->lastBank = INV_BANK_UNKNOWN;
+	s->lLastBankSelected = INV_MEM_BANK_UNKNOWN;
+}
+
 void inv_icm20948_transport_init(struct inv_icm20948 * s)
 {
-	s->lastBank = 0x7E;
-	s->lLastBankSelected = 0xFF;
+	inv_invalidate_bank_shadow(s);
+	s->write_batch.count = 0;
+	s->write_batch.open = 0;
+}
+
+/* A device reset puts both bank registers back to 0 behind the shadow's back */
+static void inv_check_device_reset(struct inv_icm20948 * s, uint16_t reg, unsigned char data)
+{
+	if ((reg == REG_PWR_MGMT_1) && (data & BIT_H_RESET))
+		inv_invalidate_bank_shadow(s);
 }
 
 static uint8_t check_reg_access_lp_disable(struct inv_icm20948 * s, unsigned short reg)
@@ -98,18 +116,98 @@ static int inv_set_bank(struct inv_icm20948 * s, unsigned char bank)
     //if bank reg was set before, just return
     if(bank==s->lastBank) 
         return 0;
-    else 
-        s->lastBank = bank;
 
-    result = inv_icm20948_read_reg(s, REG_BANK_SEL, &s->reg, 1);
-
-    if (result)
-		return result;
-    
-	s->reg &= 0xce;
-	s->reg |= (bank << 4);
+    /* USER_BANK is the only field in REG_BANK_SEL, the reserved bits read back
+       as zero so there is nothing to read first and preserve */
+    s->reg = (bank << 4);
     result = inv_icm20948_write_reg(s, REG_BANK_SEL, &s->reg, 1);
 
+    //Only trust the shadow once the write made it
+    s->lastBank = result ? INV_BANK_UNKNOWN : bank;
+
+    return result;
+}
+
+/* Sends the queued writes in order.  The queue is emptied before anything is
+   sent so the power state writes made from here don't flush it again. */
+static int inv_write_batch_flush(struct inv_icm20948 * s)
+{
+	int result = 0;
+	unsigned int count = s->write_batch.count;
+	unsigned int first, last, index;
+	unsigned char lp_disable = 0;
+
+	if (count == 0)
+		return 0;
+	s->write_batch.count = 0;
+
+	for (index = 0; index < count; index++)
+		lp_disable |= check_reg_access_lp_disable(s, s->write_batch.reg[index]);
+
+	if((inv_icm20948_get_chip_power_state(s) & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
+		result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+
+	if(lp_disable)
+		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);  //Disable LP_EN
+
+	for (first = 0; (first < count) && (result == 0); first = last)
+	{
+		uint16_t reg = s->write_batch.reg[first];
+
+		//Following registers in the same bank go out in one burst, the address auto increments
+		for (last = first + 1; last < count; last++)
+		{
+			if ((s->write_batch.reg[last] != s->write_batch.reg[last - 1] + 1) ||
+				((s->write_batch.reg[last] >> 7) != (reg >> 7)))
+				break;
+		}
+
+		result |= inv_set_bank(s, reg >> 7);
+		result |= inv_icm20948_write_reg(s, (unsigned char)(reg & 0x7F), &s->write_batch.data[first], last - first);
+
+		for (index = first; index < last; index++)
+			inv_check_device_reset(s, s->write_batch.reg[index], s->write_batch.data[index]);
+	}
+
+	if(lp_disable)   //Enable LP_EN since we disabled it above
+		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);
+
+	return result;
+}
+
+static int inv_write_batch_add(struct inv_icm20948 * s, uint16_t reg, unsigned int length, const unsigned char *data)
+{
+	int result = 0;
+	unsigned int index;
+
+	for (index = 0; index < length; index++)
+	{
+		if (s->write_batch.count == INV_WRITE_BATCH_SIZE)
+			result |= inv_write_batch_flush(s);
+
+		s->write_batch.reg[s->write_batch.count] = reg + index;
+		s->write_batch.data[s->write_batch.count] = data[index];
+		s->write_batch.count++;
+	}
+
+	return result;
+}
+
+int inv_icm20948_write_batch_open(struct inv_icm20948 * s)
+{
+	if (s->write_batch.open)
+		return -1;
+
+	s->write_batch.open = 1;
+	s->write_batch.count = 0;
+	return 0;
+}
+
+int inv_icm20948_write_batch_commit(struct inv_icm20948 * s)
+{
+	int result = inv_write_batch_flush(s);
+
+	s->write_batch.open = 0;
 	return result;
 }
 
@@ -127,11 +225,16 @@ int inv_icm20948_write_mems_reg(struct inv_icm20948 * s, uint16_t reg, unsigned
     int result = 0;
 	unsigned int bytesWrite = 0;
     unsigned char regOnly = (unsigned char)(reg & 0x7F);
+    unsigned char power_state;
+
+    if(s->write_batch.open && (length <= INV_WRITE_BATCH_SIZE))
+        return inv_write_batch_add(s, reg, length, data);
 
-    unsigned char power_state = inv_icm20948_get_chip_power_state(s);
+    result = inv_write_batch_flush(s);
+    power_state = inv_icm20948_get_chip_power_state(s);
 
     if((power_state & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
-        result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+        result |= inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
 
     if(check_reg_access_lp_disable(s, reg))    // Check if register needs LP_EN to be disabled   
         result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);  //Disable LP_EN
@@ -150,6 +253,9 @@ int inv_icm20948_write_mems_reg(struct inv_icm20948 * s, uint16_t reg, unsigned
 		bytesWrite += thisLen;
 	}
 
+    if(length)
+        inv_check_device_reset(s, reg, data[0]);
+
     if(check_reg_access_lp_disable(s, reg))   //Enable LP_EN since we disabled it at begining of this function.
         result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);
 
@@ -166,18 +272,23 @@ int inv_icm20948_write_single_mems_reg(struct inv_icm20948 * s, uint16_t reg, co
 {
     int result = 0;
     unsigned char regOnly = (unsigned char)(reg & 0x7F);
+    unsigned char power_state;
 
+    if(s->write_batch.open)
+        return inv_write_batch_add(s, reg, 1, &data);
 
-    unsigned char power_state = inv_icm20948_get_chip_power_state(s);
+    result = inv_write_batch_flush(s);
+    power_state = inv_icm20948_get_chip_power_state(s);
 
     if((power_state & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
-        result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+        result |= inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
 
     if(check_reg_access_lp_disable(s, reg))   // Check if register needs LP_EN to be disabled
         result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);  //Disable LP_EN
 
     result |= inv_set_bank(s, reg >> 7);
     result |= inv_icm20948_write_reg(s, regOnly, &data, 1);
+    inv_check_device_reset(s, reg, data);
 
     if(check_reg_access_lp_disable(s, reg))   //Enable LP_EN since we disabled it at begining of this function.
         result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);
@@ -197,11 +308,13 @@ int inv_icm20948_read_mems_reg(struct inv_icm20948 * s, uint16_t reg, unsigned i
 	int result = 0;
 	unsigned int bytesRead = 0;
 	unsigned char regOnly = (unsigned char)(reg & 0x7F);
-	unsigned char i, dat[INV_MAX_SERIAL_READ];
-	unsigned char power_state = inv_icm20948_get_chip_power_state(s);
+	unsigned char power_state;
+
+	result = inv_write_batch_flush(s);   // Queued writes land before the read
+	power_state = inv_icm20948_get_chip_power_state(s);
 
 	if((power_state & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
-		result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+		result |= inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
 
 	if(check_reg_access_lp_disable(s, reg))   // Check if register needs LP_EN to be disabled
 		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);  //Disable LP_EN
@@ -211,11 +324,9 @@ int inv_icm20948_read_mems_reg(struct inv_icm20948 * s, uint16_t reg, unsigned i
 	while (bytesRead<length) 
 	{
 		int thisLen = min(INV_MAX_SERIAL_READ, length-bytesRead);
-		if(s->base_state.serial_interface == SERIAL_INTERFACE_SPI) {
-			result |= inv_icm20948_read_reg(s, regOnly+bytesRead, &dat[bytesRead], thisLen);
-		} else {
-			result |= inv_icm20948_read_reg(s, regOnly+bytesRead, &data[bytesRead],thisLen);
-		}
+		/* Straight into the caller's buffer on SPI too, a staging copy the size of
+		   INV_MAX_SERIAL_READ would be a FIFO sized stack frame */
+		result |= inv_icm20948_read_reg(s, regOnly+bytesRead, &data[bytesRead],thisLen);
 
 		if (result)
 			return result;
@@ -223,13 +334,6 @@ int inv_icm20948_read_mems_reg(struct inv_icm20948 * s, uint16_t reg, unsigned i
 		bytesRead += thisLen;
 	}
 
-	if(s->base_state.serial_interface == SERIAL_INTERFACE_SPI) {
-		for (i=0; i< length; i++) {
-			*data= dat[i];
-			 data++;
-		}
-	}
-
 	if(check_reg_access_lp_disable(s, reg))    // Check if register needs LP_EN to be enabled  
 		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);  //Enable LP_EN
 
@@ -248,16 +352,18 @@ int inv_icm20948_read_mems(struct inv_icm20948 * s, unsigned short reg, unsigned
 	int result=0;
 	unsigned int bytesWritten = 0;
 	unsigned int thisLen;
-	unsigned char i, dat[INV_MAX_SERIAL_READ] = {0};
-	unsigned char power_state = inv_icm20948_get_chip_power_state(s);
+	unsigned char power_state;
 	unsigned char lBankSelected;
 	unsigned char lStartAddrSelected;
 
 	if(!data)
 		return -1;
 
+	result = inv_write_batch_flush(s);
+	power_state = inv_icm20948_get_chip_power_state(s);
+
 	if((power_state & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
-		result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+		result |= inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
 
 	if(check_reg_access_lp_disable(s, reg))
 		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);
@@ -269,7 +375,10 @@ int inv_icm20948_read_mems(struct inv_icm20948 * s, unsigned short reg, unsigned
 	{
 		result |= inv_icm20948_write_reg(s, REG_MEM_BANK_SEL, &lBankSelected, 1);
 		if (result)
+		{
+			s->lLastBankSelected = INV_MEM_BANK_UNKNOWN;
 			return result;
+		}
 		s->lLastBankSelected = lBankSelected;
 	}
 
@@ -285,12 +394,8 @@ int inv_icm20948_read_mems(struct inv_icm20948 * s, unsigned short reg, unsigned
 			return result;
 		
 		thisLen = min(INV_MAX_SERIAL_READ, length-bytesWritten);
-		/* Write data */
-		if(s->base_state.serial_interface == SERIAL_INTERFACE_SPI) {
-			result |= inv_icm20948_read_reg(s, REG_MEM_R_W, &dat[bytesWritten], thisLen);
-		} else {
-			result |= inv_icm20948_read_reg(s, REG_MEM_R_W, &data[bytesWritten], thisLen);
-		}
+		/* Read data */
+		result |= inv_icm20948_read_reg(s, REG_MEM_R_W, &data[bytesWritten], thisLen);
 		if (result)
 			return result;
 		
@@ -298,13 +403,6 @@ int inv_icm20948_read_mems(struct inv_icm20948 * s, unsigned short reg, unsigned
 		reg += thisLen;
 	}
 
-	if(s->base_state.serial_interface == SERIAL_INTERFACE_SPI) {
-		for (i=0; i< length; i++) {
-			*data= dat[i];
-			 data++;
-		}
-	}
-
 	//Enable LP_EN if we disabled it at begining of this function.
 	if(check_reg_access_lp_disable(s, reg))
 		result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);
@@ -326,14 +424,16 @@ int inv_icm20948_write_mems(struct inv_icm20948 * s, unsigned short reg, unsigne
     unsigned int thisLen;
     unsigned char lBankSelected;
     unsigned char lStartAddrSelected;
-    
-    unsigned char power_state = inv_icm20948_get_chip_power_state(s);
+    unsigned char power_state;
 
     if(!data)
         return -1;
     
+    result = inv_write_batch_flush(s);
+    power_state = inv_icm20948_get_chip_power_state(s);
+
     if((power_state & CHIP_AWAKE) == 0)   // Wake up chip since it is asleep
-        result = inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
+        result |= inv_icm20948_set_chip_power_state(s, CHIP_AWAKE, 1);
 
     result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 0);
             
@@ -348,6 +448,7 @@ int inv_icm20948_write_mems(struct inv_icm20948 * s, unsigned short reg, unsigne
 		{
 			printf("inv_icm20948_write_mems:  write to %u (bank sel) of %u failed with %d\n",
 			REG_MEM_BANK_SEL, lBankSelected, result);
+			s->lLastBankSelected = INV_MEM_BANK_UNKNOWN;
 			return result;
 		}
 		s->lLastBankSelected = lBankSelected;
@@ -403,6 +504,7 @@ int inv_icm20948_write_single_mems_reg_core(struct inv_icm20948 * s, uint16_t re
 
     result |= inv_set_bank(s, reg >> 7);
     result |= inv_icm20948_write_reg(s, regOnly, &data, 1);
+    inv_check_device_reset(s, reg, data);
 
     return result;
 }
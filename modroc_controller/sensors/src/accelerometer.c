@@ -30,8 +30,10 @@ and barometric pressure chips.
 
 typedef struct Accelerometer_Interface_Struct
 {
-Error_Returns (*chip_init)(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
+Error_Returns (*chip_init)(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin);
 Error_Returns (*chip_reset)(uint32_t id);
+Error_Returns (*chip_update)(uint32_t id);
+Error_Returns (*chip_get_sample)(uint32_t id, Accelerometer_Sample_t *sample);
 uint32_t chip_id;
 } Accelerometer_Interface;
 
@@ -39,12 +41,31 @@ static uint32_t number_accelerometers_initialized = 0;
 
 static Accelerometer_Interface accelerometer_chip[ACCELEROMETER_NUMBER_SUPPORTED_DEVICES];
 
+#define STANDARD_GRAVITY	9807  //In millimeters/second2
+
+//Scales the chip's raw counts to millimeters/second2
+static Error_Returns icm20948_get_sample(uint32_t id, Accelerometer_Sample_t *sample)
+{
+	ICM20948_Acceleration acceleration;
+	Error_Returns to_return = icm20948_get_acceleration(id, &acceleration);
+	if (to_return == RPi_Success)
+	{
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			sample->acceleration[axis] = (acceleration.acceleration[axis] * STANDARD_GRAVITY) / ICM20948_ACCELERATION_PER_G;
+		}
+		sample->time_stamp = (uint32_t)acceleration.time_stamp;
+		sample->sequence = acceleration.sequence;
+	}
+	return to_return;
+}
+
 /* Current implementation only supports the BME_280 barometer chip, this could
    either become a runtime initialization if a variety of different barometers
    are attached or could be a compile time assignment if all attached 
    barometers are of the same type.
 */
-Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
+Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin)
 {
 	Error_Returns to_return = RPi_NotInitialized;
 	do
@@ -55,8 +76,11 @@ Error_Returns accelerometer_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_se
 		}
 		accelerometer_chip[number_accelerometers_initialized].chip_init = icm20948_init;
 		accelerometer_chip[number_accelerometers_initialized].chip_reset = icm20948_reset;
+		accelerometer_chip[number_accelerometers_initialized].chip_update = icm20948_update;
+		accelerometer_chip[number_accelerometers_initialized].chip_get_sample = icm20948_get_sample;
 
-		to_return = accelerometer_chip[number_accelerometers_initialized].chip_init(&accelerometer_chip[number_accelerometers_initialized].chip_id, spi, chip_select);
+		to_return = accelerometer_chip[number_accelerometers_initialized].chip_init(&accelerometer_chip[number_accelerometers_initialized].chip_id, spi, chip_select,
+			interrupt_pin);
 
 		/* If the chip initialization isn't successfull then there is no
 		   need to bother the client with the details, just return that
@@ -84,3 +108,22 @@ Error_Returns accelerometer_reset(uint32_t id)
 	return to_return;
 }
 
+Error_Returns accelerometer_update(uint32_t id)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_accelerometers_initialized)
+	{
+		to_return = accelerometer_chip[id].chip_update(accelerometer_chip[id].chip_id);
+	}
+	return to_return;
+}
+
+Error_Returns accelerometer_get_sample(uint32_t id, Accelerometer_Sample_t *sample)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_accelerometers_initialized)
+	{
+		to_return = accelerometer_chip[id].chip_get_sample(accelerometer_chip[id].chip_id, sample);
+	}
+	return to_return;
+}
@@ -31,8 +31,15 @@ and barometric pressure chips.
 typedef struct Barometer_Interface_Struct
 {
 Error_Returns (*chip_init)(uint32_t *id, i2c_inst_t *i2c, uint32_t address);
+Error_Returns (*chip_init_spi)(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
 Error_Returns (*chip_reset)(uint32_t id);
-Error_Returns (*chip_get_current_pressure)(uint32_t id, uint32_t *pressure_ptr);
+Error_Returns (*chip_set_sampling_profile)(uint32_t id, Barometer_Sampling_Profile profile, uint32_t *sample_period_ptr);
+Error_Returns (*chip_get_current_pressure)(uint32_t id, uint32_t *pressure_ptr, bool *new_sample_ptr);
+Error_Returns (*chip_set_raw_logging)(uint32_t id, bool enable);
+bool (*chip_get_raw_batch)(uint32_t id, Barometer_Raw_Batch *batch_ptr);
+Error_Returns (*chip_compensate_raw_sample)(uint32_t id, const Barometer_Raw_Sample *sample_ptr, uint32_t *pressure_ptr, int32_t *temperature_ptr);
+Error_Returns (*chip_get_last_temperature)(uint32_t id, int32_t *temperature_ptr);
+Error_Returns (*chip_get_sample_time)(uint32_t id, uint32_t *time_stamp_ptr);
 uint32_t chip_id;
 } Barometer_Interface;
 
@@ -45,6 +52,20 @@ static Barometer_Interface barometer_chip[BAROMETER_NUMBER_SUPPORTED_DEVICES];
    are attached or could be a compile time assignment if all attached 
    barometers are of the same type.
 */
+static void barometer_set_interface(Barometer_Interface *chip_ptr)
+{
+	chip_ptr->chip_init = bme280_init;
+	chip_ptr->chip_init_spi = bme280_init_spi;
+	chip_ptr->chip_reset = bme280_reset;
+	chip_ptr->chip_set_sampling_profile = bme280_set_sampling_profile;
+	chip_ptr->chip_get_current_pressure = bme280_get_current_pressure;
+	chip_ptr->chip_get_last_temperature = bme280_get_last_temperature;
+	chip_ptr->chip_get_sample_time = bme280_get_sample_time;
+	chip_ptr->chip_set_raw_logging = bme280_set_raw_logging;
+	chip_ptr->chip_get_raw_batch = bme280_get_raw_batch;
+	chip_ptr->chip_compensate_raw_sample = bme280_compensate_raw_sample;
+}
+
 Error_Returns barometer_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address)
 {
 	Error_Returns to_return = RPi_NotInitialized;
@@ -54,9 +75,7 @@ Error_Returns barometer_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address)
 		{
 			break;
 		}
-		barometer_chip[number_barometers_initialized].chip_init = bme280_init;
-		barometer_chip[number_barometers_initialized].chip_reset = bme280_reset;
-		barometer_chip[number_barometers_initialized].chip_get_current_pressure = bme280_get_current_pressure;
+		barometer_set_interface(&barometer_chip[number_barometers_initialized]);
 
 		to_return = barometer_chip[number_barometers_initialized].chip_init(&barometer_chip[number_barometers_initialized].chip_id, i2c, address);
 
@@ -75,6 +94,29 @@ Error_Returns barometer_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address)
 	return to_return;
 }
 
+Error_Returns barometer_init_spi(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	do
+	{
+		if (number_barometers_initialized >= BAROMETER_NUMBER_SUPPORTED_DEVICES)
+		{
+			break;
+		}
+		barometer_set_interface(&barometer_chip[number_barometers_initialized]);
+
+		to_return = barometer_chip[number_barometers_initialized].chip_init_spi(&barometer_chip[number_barometers_initialized].chip_id, spi, chip_select);
+		if (to_return != RPi_Success)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		
+		*id = number_barometers_initialized++;
+	} while(0);
+	return to_return;
+}
+
 Error_Returns barometer_reset(uint32_t id)
 {
 	Error_Returns to_return = RPi_NotInitialized;
@@ -85,12 +127,74 @@ Error_Returns barometer_reset(uint32_t id)
 	return to_return;
 }
 
-Error_Returns barometer_get_current_pressure(uint32_t id, uint32_t *pressure_ptr)
+Error_Returns barometer_set_sampling_profile(uint32_t id, Barometer_Sampling_Profile profile, uint32_t *sample_period_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_set_sampling_profile(barometer_chip[id].chip_id, profile, sample_period_ptr);
+	}
+	return to_return;
+}
+
+Error_Returns barometer_get_current_pressure(uint32_t id, uint32_t *pressure_ptr, bool *new_sample_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_get_current_pressure(barometer_chip[id].chip_id, pressure_ptr, new_sample_ptr);
+	}
+	return to_return;
+}
+
+Error_Returns barometer_get_last_temperature(uint32_t id, int32_t *temperature_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_get_last_temperature(barometer_chip[id].chip_id, temperature_ptr);
+	}
+	return to_return;
+}
+
+Error_Returns barometer_get_sample_time(uint32_t id, uint32_t *time_stamp_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_get_sample_time(barometer_chip[id].chip_id, time_stamp_ptr);
+	}
+	return to_return;
+}
+
+Error_Returns barometer_set_raw_logging(uint32_t id, bool enable)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_set_raw_logging(barometer_chip[id].chip_id, enable);
+	}
+	return to_return;
+}
+
+bool barometer_get_raw_batch(uint32_t id, Barometer_Raw_Batch *batch_ptr)
+{
+	bool to_return = false;
+	if (id < number_barometers_initialized)
+	{
+		to_return = barometer_chip[id].chip_get_raw_batch(barometer_chip[id].chip_id, batch_ptr);
+	}
+	return to_return;
+}
+
+Error_Returns barometer_compensate_raw_sample(uint32_t id, const Barometer_Raw_Sample *sample_ptr,
+	uint32_t *pressure_ptr, int32_t *temperature_ptr)
 {
 	Error_Returns to_return = RPi_NotInitialized;
 	if (id < number_barometers_initialized)
 	{
-		to_return = barometer_chip[id].chip_get_current_pressure(barometer_chip[id].chip_id, pressure_ptr);
+		to_return = barometer_chip[id].chip_compensate_raw_sample(barometer_chip[id].chip_id, sample_ptr,
+			pressure_ptr, temperature_ptr);
 	}
 	return to_return;
 }
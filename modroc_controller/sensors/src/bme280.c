@@ -23,13 +23,29 @@ Implements support for the Bosch BME 280 temperature, pressure and humidity chip
 
 Note:  The conversion algorithms were taken directly from the BME 280 spec sheet.
 
+The chip can be on I2C or SPI, everything past the transport routines is the
+same for both.  On SPI the register address goes out with bit 7 set for a read
+and cleared for a write, the same register address/data pairs as I2C work for
+writes and reads auto increment.  Only I2C reads can be done asynchronously,
+SPI reads are short enough to do blocking.
+
+Humidity is off unless a caller turns it on, it then comes in the same burst as
+pressure and temperature and is only compensated when it is asked for.
+
 */
 
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/spi.h"
 
 #include "bme280.h"
+#include "bme280_compensation.h"
+#include "i2c_async.h"
+#include "spi_dma.h"
+#include "profile.h"
 
+//A chip used as both a barometer and a thermometer is only counted once, see bme280_init()
 #define BME280_SUPPORTED_DEVICE_COUNT BAROMETER_NUMBER_SUPPORTED_DEVICES + THERMOMETER_NUMBER_SUPPORTED_DEVICES
 
 #define BME280_CHIP_ID 0x60
@@ -46,9 +62,13 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 #define BME280_CTRL_CONFIG_REGISTER 0xF5
 #define BME280_FIRST_DATA_REGISTER 0xF7
 
+#define BME280_SPI_READ_BIT 0x80
+
 #define BME280_CTRL_REGISTER_WRITE_SIZE 2
 #define BME280_DATA_REGISTER_SIZE 0x6
-#define BME280_TRIM_PARAMETER_BYTES 24
+#define BME280_HUMIDITY_DATA_REGISTER_SIZE 0x8  //Humidity follows temperature
+#define BME280_NO_HUMIDITY -1  //Not in the burst that was read
+#define BME280_SKIPPED_DATA 0x80000  //Pressure and temperature registers until their first conversion
 
 #define BME280_SLEEP_MODE 0
 #define BME280_IIR_OFF_500MS_STANDBY 0x80
@@ -63,6 +83,46 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 
 #define BME280_STATUS_MEASURING_BIT	3
 
+/* Sampling profiles, ctrl_meas is osrs_t[7:5] osrs_p[4:2] mode[1:0] and config
+   is t_sb[7:5] filter[4:2].  The sample period in normal mode is the
+   measurement time plus the standby time, both worked out from the settings.
+*/
+#define BME280_PAD_CTRL_MEASURE			0x57  //Temperature 2x, pressure 16x, normal mode
+#define BME280_PAD_CONFIG				0x28  //62.5 ms standby, IIR 4, 105.7 ms period
+#define BME280_ASCENT_CTRL_MEASURE		BME280_PRESS1X_TEMP_1X  //Normal mode
+#define BME280_ASCENT_CONFIG			BME280_NO_IIR_16_500MS_STANDBY  //0.5 ms standby, IIR off, 6.9 ms period
+#define BME280_DESCENT_CTRL_MEASURE		0x2F  //Temperature 1x, pressure 4x, normal mode
+#define BME280_DESCENT_CONFIG			0xE4  //20 ms standby, IIR 2, 33.3 ms period
+#define BME280_SEQUENCE_MAXIMUM_WRITES	4  //A whole sampling profile
+
+/* Calibration is read in two bursts, 0x88 to 0xA1 has the temperature and
+   pressure trim, a reserved byte and dig_H1, 0xE1 to 0xE7 the rest of the
+   humidity trim.
+*/
+#define BME280_CALIBRATION_BLOCK_SIZE	(BME280_SECOND_TRIM_PARAMETER - BME280_FIRST_TRIM_PARAMETER + 1)
+#define BME280_DIG_H1_OFFSET			(BME280_SECOND_TRIM_PARAMETER - BME280_FIRST_TRIM_PARAMETER)
+
+/* Maximum measurement time from the datasheet, in microseconds it is
+   1250 + 2300 x temperature oversampling + 2300 x pressure oversampling + 575
+   + 2300 x humidity oversampling + 575, a skipped measurement adds nothing.
+   The typical time is the same with 1000, 2000 and 500.
+*/
+#define BME280_MEASURE_BASE_TIME		1250
+#define BME280_MEASURE_OVERSAMPLE_TIME	2300
+#define BME280_MEASURE_SETUP_TIME		575
+#define BME280_TYPICAL_BASE_TIME		1000
+#define BME280_TYPICAL_OVERSAMPLE_TIME	2000
+#define BME280_TYPICAL_SETUP_TIME		500
+#define BME280_OVERSAMPLE_MASK			0x7
+#define BME280_OVERSAMPLE_MAXIMUM		16
+#define BME280_TEMPERATURE_OVERSAMPLE_SHIFT	5
+#define BME280_PRESSURE_OVERSAMPLE_SHIFT	2
+#define BME280_STANDBY_SHIFT			5
+
+#define BME280_SAMPLE_BUFFERS		2
+#define BME280_RAW_BATCH_QUEUE_DEPTH	4  //Batches waiting for the logger, about 0.4 s on the ascent profile
+#define BME280_ASYNC_TIMEOUT		2000  //In microseconds, a 6 byte read takes about 250
+
 #define TIME_DELAY 1
 #define BME280_STATUS_READ_ATTEMPTS	10
 #define BME280_UPPER_WORD_MASK		12
@@ -71,43 +131,116 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 #define BME280_IIR_DISABLED_1X_SAMPLING_MASK	0
 #define BME280_REGISTER_BIT_SIZE	8
 
-typedef struct Comp_Params {
-	unsigned short dig_T1;
-	signed short dig_T2;
-	signed short dig_T3;
-
-	unsigned short dig_P1;
-	signed short dig_P2;
-	signed short dig_P3;
-	signed short dig_P4;
-	signed short dig_P5;
-	signed short dig_P6;
-	signed short dig_P7;
-	signed short dig_P8;
-	signed short dig_P9;
-
-	unsigned char dig_H1;
-	signed short dig_H2;
-	unsigned char dig_H3;
-	signed short dig_H4;
-	signed short dig_H5;
-	char dig_H6;
+typedef enum {
+	sample_idle,
+	sample_in_flight,
+	sample_complete
+} Sample_State;
 
+typedef struct Comp_Params {
+	BME280_Calibration calibration;
 	BME280_S32_t t_fine;
-	uint32_t address;
+
+	//Latest burst read, compensated once and shared by the pressure and
+	//temperature calls while the chip can't have a newer one
+	BME280_S32_t temperature;  //Hundredths of a degree C
+	uint32_t pressure;  //Pascals x 100
+	uint32_t humidity;  //Percent relative humidity x 1024
+	BME280_S32_t adc_temperature;  //Raw values, tell a new conversion from a repeat
+	BME280_S32_t adc_pressure;
+	BME280_S32_t adc_humidity;
+	bool sample_valid;
+	bool temperature_compensated;  //Only done once a caller wants the value
+	bool pressure_compensated;
+	bool humidity_compensated;
+	bool humidity_enabled;
+	const struct Sampling_Profile_S *profile_ptr;  //Rewritten when humidity is turned on or off
+	bool pressure_delivered;  //The pressure caller has already had this sample
+	
+	//What the control registers were last set to, only the ones that change are rewritten
+	bool registers_known;
+	unsigned char ctrl_measure;
+	unsigned char config;
+	unsigned char ctrl_humidity;
+	
+	/* The chip converts every sample period at a phase of its own.  The last
+	   time it was seen without a newer conversion bounds when the latest one
+	   finished, a newer one isn't expected for a typical period after that.
+	   The maximum period only bounds how old the latest one can be.
+	*/
+	uint32_t conversion_time;  //Latest conversion finished no earlier than this
+	uint32_t poll_time;  //Start of the last read with no newer conversion, in microseconds
+	uint32_t seen_time;  //When the latest conversion was first read
+	uint32_t repeats;  //Conversions in a row taken as new that came out the same as the one before
+	uint32_t sample_time;  //Best guess at when the latest conversion finished
+	uint32_t sample_period;  //Maximum, in microseconds
+	uint32_t typical_period;
+	
+	//Set by bme280_init() or bme280_init_spi() for the bus the chip is on,
+	//buffer[0] is the register address for a read
+	Error_Returns (*write)(struct Comp_Params *params_ptr, unsigned char *buffer, unsigned int tx_bytes);
+	Error_Returns (*read)(struct Comp_Params *params_ptr, unsigned char *buffer, unsigned int rx_bytes);
+	uint32_t address;  //The chip select pin on SPI
 	i2c_inst_t *i2c;
+	spi_inst_t *spi;
+
+	//Pressure reads done over DMA, the read in flight fills the back buffer and
+	//the completed one is compensated from the front buffer
+	bool async;
+	unsigned char samples[BME280_SAMPLE_BUFFERS][BME280_HUMIDITY_DATA_REGISTER_SIZE];
+	uint32_t sample_length;  //Of the read in flight, humidity can be turned on while it is
+	volatile uint32_t front_sample;
+	volatile Sample_State sample_state;
+	volatile Error_Returns sample_status;
+	uint32_t sample_start;
+	volatile uint32_t sample_end;  //A queued read can wait a while before it starts
+	
+	//Raw samples for the logger, the queue hands full batches to the other core
+	bool raw_logging;
+	volatile bool raw_queue_ready;
+	queue_t raw_batches;
+	Barometer_Raw_Batch raw_batch;  //Being filled
+	uint32_t raw_batches_dropped;
 } Compensation_Parameters;
 
+/* Register writes to send in one transaction.  The BME280 doesn't
+   auto-increment on writes, instead it takes any number of register
+   address/data pairs in one transaction and writes them in order.
+*/
+typedef struct Register_Sequence_S {
+	unsigned char buffer[BME280_SEQUENCE_MAXIMUM_WRITES * BME280_CTRL_REGISTER_WRITE_SIZE];
+	unsigned int length;
+} Register_Sequence;
+
+typedef struct Sampling_Profile_S {
+	unsigned char ctrl_measure;
+	unsigned char config;
+} Sampling_Profile;
+
+//Indexed by Barometer_Sampling_Profile
+static const Sampling_Profile sampling_profiles[] = {
+	{BME280_PAD_CTRL_MEASURE, BME280_PAD_CONFIG},
+	{BME280_ASCENT_CTRL_MEASURE, BME280_ASCENT_CONFIG},
+	{BME280_DESCENT_CTRL_MEASURE, BME280_DESCENT_CONFIG}
+};
+
+//Indexed by the config register's t_sb, in microseconds
+static const uint32_t standby_times[] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+
 static Compensation_Parameters bme280_compensation_params[BME280_SUPPORTED_DEVICE_COUNT];
 
 static uint32_t number_bme280_initialized = 0;
 
 static uint32_t pressure_temperature_xlsb_mask = 0;
 
-//Communication routine with the BME 280
-static Error_Returns bme280_write(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int tx_bytes)
+//Communication routine with the BME 280 on I2C
+static Error_Returns bme280_i2c_write(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int tx_bytes)
 {	
 	Error_Returns to_return = RPi_Success;
+	if (params_ptr->async)
+	{
+		i2c_async_wait(params_ptr->i2c, BME280_ASYNC_TIMEOUT);  //The bus has to be free first
+	}
 	if (i2c_write_blocking(params_ptr->i2c, params_ptr->address, buffer, tx_bytes, false) ==
 		PICO_ERROR_GENERIC)
 	{
@@ -117,11 +250,11 @@ static Error_Returns bme280_write(Compensation_Parameters *params_ptr, unsigned
 }
 
 
-//Communication routine with the BME 280
-static Error_Returns bme280_read(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int rx_bytes)
+//Communication routine with the BME 280 on I2C
+static Error_Returns bme280_i2c_read(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int rx_bytes)
 {
 	Error_Returns to_return = RPi_Success;
-	to_return = bme280_write(params_ptr, buffer, 1);
+	to_return = bme280_i2c_write(params_ptr, buffer, 1);
 	if (to_return == RPi_Success)
 	{
 		if (i2c_read_blocking(params_ptr->i2c, params_ptr->address, buffer, rx_bytes, false) ==
@@ -133,80 +266,320 @@ static Error_Returns bme280_read(Compensation_Parameters *params_ptr, unsigned c
 	return to_return;
 }
 
-//Taken straight from the Bosch manual.
-static int32_t compensate_temperature(uint32_t id, uint32_t uncompensated_temperature)
-{
-    int32_t var1;
-    int32_t var2;
-    int32_t temperature;
-    int32_t temperature_min = -4000;
-    int32_t temperature_max = 8500;
-	Compensation_Parameters *calib_data = &bme280_compensation_params[id];
-
-    var1 = (int32_t)((uncompensated_temperature / 8) - ((int32_t)calib_data->dig_T1 * 2));
-    var1 = (var1 * ((int32_t)calib_data->dig_T2)) / 2048;
-    var2 = (int32_t)((uncompensated_temperature / 16) - ((int32_t)calib_data->dig_T1));
-    var2 = (((var2 * var2) / 4096) * ((int32_t)calib_data->dig_T3)) / 16384;
-    calib_data->t_fine = var1 + var2;
-    temperature = (calib_data->t_fine * 5 + 128) / 256;
-
-    if (temperature < temperature_min)
-    {
-        temperature = temperature_min;
-    }
-    else if (temperature > temperature_max)
-    {
-        temperature = temperature_max;
-    }
-
-    return temperature;
-}
-
-// Straight from the Bosch manual.
-static uint32_t compensate_pressure(uint32_t id, int32_t adc_P)
-{
-    int64_t var1;
-    int64_t var2;
-    int64_t var3;
-    int64_t var4;
-    uint32_t pressure;
-    uint32_t pressure_min = 3000000;
-    uint32_t pressure_max = 11000000;
-	Compensation_Parameters *calib_data = &bme280_compensation_params[id];
+//Communication routine with the BME 280 on SPI, every register address has bit 7 cleared
+static Error_Returns bme280_spi_write(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int tx_bytes)
+{
+	Error_Returns to_return = RPi_Success;
+	for (unsigned int index = 0; index < tx_bytes; index += BME280_CTRL_REGISTER_WRITE_SIZE)
+	{
+		buffer[index] &= ~BME280_SPI_READ_BIT;
+	}
+	spi_dma_lock_bus(params_ptr->spi);
+	gpio_put(params_ptr->address, 0);
+	if (spi_write_blocking(params_ptr->spi, buffer, tx_bytes) == PICO_ERROR_GENERIC)
+	{
+		to_return = RPi_OperationFailed;
+	}
+	gpio_put(params_ptr->address, 1);
+	spi_dma_unlock_bus(params_ptr->spi);
+	return to_return;
+}
+
+//Communication routine with the BME 280 on SPI
+static Error_Returns bme280_spi_read(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int rx_bytes)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char register_address = buffer[0] | BME280_SPI_READ_BIT;
+	spi_dma_lock_bus(params_ptr->spi);
+	gpio_put(params_ptr->address, 0);
+	if ((spi_write_blocking(params_ptr->spi, &register_address, 1) == PICO_ERROR_GENERIC) ||
+		(spi_read_blocking(params_ptr->spi, 0, buffer, rx_bytes) == PICO_ERROR_GENERIC))
+	{
+		to_return = RPi_OperationFailed;
+	}
+	gpio_put(params_ptr->address, 1);
+	spi_dma_unlock_bus(params_ptr->spi);
+	return to_return;
+}
+
+static Error_Returns bme280_write(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int tx_bytes)
+{
+	return params_ptr->write(params_ptr, buffer, tx_bytes);
+}
+
+static Error_Returns bme280_read(Compensation_Parameters *params_ptr, unsigned char *buffer, unsigned int rx_bytes)
+{
+	return params_ptr->read(params_ptr, buffer, rx_bytes);
+}
+
+//One burst read of rx_bytes registers starting at first_register
+static Error_Returns bme280_read_registers(Compensation_Parameters *params_ptr, unsigned char first_register,
+	unsigned char *buffer, unsigned int rx_bytes)
+{
+	buffer[0] = first_register;
+	return bme280_read(params_ptr, buffer, rx_bytes);
+}
+
+static void bme280_sequence_add(Register_Sequence *sequence_ptr, unsigned char register_address, unsigned char value)
+{
+	sequence_ptr->buffer[sequence_ptr->length++] = register_address;
+	sequence_ptr->buffer[sequence_ptr->length++] = value;
+}
+
+//Sends the whole sequence in one transaction, an empty one is not sent
+static Error_Returns bme280_write_sequence(Compensation_Parameters *params_ptr, Register_Sequence *sequence_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	if (sequence_ptr->length > 0)
+	{
+		to_return = bme280_write(params_ptr, sequence_ptr->buffer, sequence_ptr->length);
+	}
+	return to_return;
+}
+
+//Oversampling setting to the number of samples taken, 0 is skipped
+static uint32_t bme280_get_oversampling(unsigned char setting)
+{
+	setting &= BME280_OVERSAMPLE_MASK;
+	return (setting == 0) ? 0 : (setting > 5) ? BME280_OVERSAMPLE_MAXIMUM : (1u << (setting - 1));
+}
+
+//Takes the maximum or the typical times from the datasheet
+static uint32_t bme280_get_measure_time(unsigned char ctrl_measure, unsigned char ctrl_humidity,
+	uint32_t base_time, uint32_t oversample_time, uint32_t setup_time)
+{
+	uint32_t measure_time = base_time;
+	uint32_t pressure_oversampling = bme280_get_oversampling(ctrl_measure >> BME280_PRESSURE_OVERSAMPLE_SHIFT);
+	uint32_t humidity_oversampling = bme280_get_oversampling(ctrl_humidity);
 	
-    var1 = ((int64_t)calib_data->t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t)calib_data->dig_P6;
-    var2 = var2 + ((var1 * (int64_t)calib_data->dig_P5) * 131072);
-    var2 = var2 + (((int64_t)calib_data->dig_P4) * 34359738368);
-    var1 = ((var1 * var1 * (int64_t)calib_data->dig_P3) / 256) + ((var1 * ((int64_t)calib_data->dig_P2) * 4096));
-    var3 = ((int64_t)1) * 140737488355328;
-    var1 = (var3 + var1) * ((int64_t)calib_data->dig_P1) / 8589934592;
-
-    /* To avoid divide by zero exception */
-    if (var1 != 0)
-    {
-        var4 = 1048576 - adc_P;
-        var4 = (((var4 * INT64_C(2147483648)) - var2) * 3125) / var1;
-        var1 = (((int64_t)calib_data->dig_P9) * (var4 / 8192) * (var4 / 8192)) / 33554432;
-        var2 = (((int64_t)calib_data->dig_P8) * var4) / 524288;
-        var4 = ((var4 + var1 + var2) / 256) + (((int64_t)calib_data->dig_P7) * 16);
-        pressure = (uint32_t)(((var4 / 2) * 100) / 128);
-
-        if (pressure < pressure_min)
-        {
-            pressure = pressure_min;
-        }
-        else if (pressure > pressure_max)
-        {
-            pressure = pressure_max;
-        }
-    }
-    else
-    {
-        pressure = pressure_min;
-    }
-
-    return pressure;
+	measure_time += oversample_time * bme280_get_oversampling(ctrl_measure >> BME280_TEMPERATURE_OVERSAMPLE_SHIFT);
+	if (pressure_oversampling)
+	{
+		measure_time += oversample_time * pressure_oversampling + setup_time;
+	}
+	if (humidity_oversampling)
+	{
+		measure_time += oversample_time * humidity_oversampling + setup_time;
+	}
+	return measure_time;
+}
+
+/* The whole profile goes in one register sequence, with only the registers
+   that change.  Config writes can be ignored in normal mode so the chip is put
+   to sleep first, and ctrl_hum only takes effect on the ctrl_meas write after it.
+*/
+static Error_Returns bme280_write_profile(Compensation_Parameters *params_ptr, const Sampling_Profile *profile_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	Register_Sequence sequence;
+	bool known = params_ptr->registers_known;
+	
+	unsigned char ctrl_humidity = params_ptr->humidity_enabled ? BME280_HUMIDITY_1X : BME280_HUMIDITY_OFF;
+	
+	sequence.length = 0;
+	if (!known || (params_ptr->config != profile_ptr->config))
+	{
+		bme280_sequence_add(&sequence, BME280_CTRL_MEASURE_REGISTER, BME280_SLEEP_MODE);
+		bme280_sequence_add(&sequence, BME280_CTRL_CONFIG_REGISTER, profile_ptr->config);
+	}
+	if (!known || (params_ptr->ctrl_humidity != ctrl_humidity))
+	{
+		bme280_sequence_add(&sequence, BME280_CTRL_HUMIDITY_REGISTER, ctrl_humidity);
+	}
+	if ((sequence.length > 0) || (params_ptr->ctrl_measure != profile_ptr->ctrl_measure))
+	{
+		bme280_sequence_add(&sequence, BME280_CTRL_MEASURE_REGISTER, profile_ptr->ctrl_measure);
+	}
+	
+	params_ptr->profile_ptr = profile_ptr;
+	if (sequence.length > 0)
+	{
+		//Whatever was read under the old settings isn't worth sharing any more,
+		//but it stays in the data registers until the first conversion on the new ones
+		params_ptr->sample_valid = false;
+		params_ptr->poll_time = params_ptr->seen_time = time_us_32();
+		params_ptr->repeats = 0;
+		uint32_t standby_time = standby_times[profile_ptr->config >> BME280_STANDBY_SHIFT];
+		params_ptr->sample_period = standby_time + bme280_get_measure_time(profile_ptr->ctrl_measure, ctrl_humidity,
+			BME280_MEASURE_BASE_TIME, BME280_MEASURE_OVERSAMPLE_TIME, BME280_MEASURE_SETUP_TIME);
+		params_ptr->typical_period = standby_time + bme280_get_measure_time(profile_ptr->ctrl_measure, ctrl_humidity,
+			BME280_TYPICAL_BASE_TIME, BME280_TYPICAL_OVERSAMPLE_TIME, BME280_TYPICAL_SETUP_TIME);
+		
+		to_return = bme280_write_sequence(params_ptr, &sequence);
+		params_ptr->registers_known = (to_return == RPi_Success);
+		params_ptr->ctrl_measure = profile_ptr->ctrl_measure;
+		params_ptr->config = profile_ptr->config;
+		params_ptr->ctrl_humidity = ctrl_humidity;
+	}
+	return to_return;
+}
+
+//Hands the batch to the logger, if it hasn't kept up the batch is lost and counted
+static void bme280_queue_raw_batch(Compensation_Parameters *params_ptr)
+{
+	Barometer_Raw_Batch *batch_ptr = &params_ptr->raw_batch;
+	if (batch_ptr->count > 0)
+	{
+		batch_ptr->dropped = params_ptr->raw_batches_dropped;
+		if (queue_try_add(&params_ptr->raw_batches, batch_ptr))
+		{
+			params_ptr->raw_batches_dropped = 0;
+		}
+		else
+		{
+			params_ptr->raw_batches_dropped++;
+		}
+		batch_ptr->count = 0;
+	}
+}
+
+static void bme280_log_raw_sample(Compensation_Parameters *params_ptr, uint32_t read_time)
+{
+	Barometer_Raw_Batch *batch_ptr = &params_ptr->raw_batch;
+	Barometer_Raw_Sample *sample_ptr = &batch_ptr->samples[batch_ptr->count++];
+	
+	sample_ptr->time_stamp = read_time;
+	sample_ptr->raw_temperature = params_ptr->adc_temperature;
+	sample_ptr->raw_pressure = params_ptr->adc_pressure;
+	if (batch_ptr->count == BAROMETER_RAW_BATCH_SIZE)
+	{
+		bme280_queue_raw_batch(params_ptr);
+	}
+}
+
+static void bme280_compensate_sample_temperature(Compensation_Parameters *params_ptr)
+{
+	if (!params_ptr->temperature_compensated)
+	{
+		params_ptr->temperature = bme280_compensate_temperature(&params_ptr->calibration, params_ptr->adc_temperature,
+			&params_ptr->t_fine);
+		params_ptr->temperature_compensated = true;
+	}
+}
+
+static void bme280_compensate_sample_pressure(Compensation_Parameters *params_ptr)
+{
+	if (!params_ptr->pressure_compensated)
+	{
+		//Pressure compensation needs t_fine from the temperature anyway
+		PROFILE_STAGE_BEGIN(profile_stage_compensation);
+		bme280_compensate_sample_temperature(params_ptr);
+		params_ptr->pressure = bme280_compensate_pressure(&params_ptr->calibration, params_ptr->adc_pressure,
+			params_ptr->t_fine);
+		PROFILE_STAGE_END(profile_stage_compensation);
+		params_ptr->pressure_compensated = true;
+	}
+}
+
+//Humidity changes slowly, a burst read without it keeps the last one
+static void bme280_compensate_sample_humidity(Compensation_Parameters *params_ptr)
+{
+	if (!params_ptr->humidity_compensated)
+	{
+		bme280_compensate_sample_temperature(params_ptr);  //For t_fine
+		params_ptr->humidity = bme280_compensate_humidity(&params_ptr->calibration, params_ptr->adc_humidity,
+			params_ptr->t_fine);
+		params_ptr->humidity_compensated = true;
+	}
+}
+
+/* Keeps a burst read started at read_start and finished by read_time as the
+   chip's latest sample if it holds a new conversion, returns false for a repeat
+   of the last one.  The chip latches the data registers once the read is on the
+   wire, so a conversion it missed finished after read_start.  It is only
+   compensated once a caller asks for the temperature, pressure or humidity.
+   adc_H is BME280_NO_HUMIDITY if the burst didn't include it.
+*/
+static bool bme280_store_sample(uint32_t id, BME280_S32_t adc_T, BME280_S32_t adc_P, BME280_S32_t adc_H,
+	uint32_t read_start, uint32_t read_time)
+{
+	Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+	bool is_new = false;
+	
+	do
+	{
+		//Read before the first conversion, the registers still hold their reset value
+		if (adc_P == BME280_SKIPPED_DATA)
+		{
+			params_ptr->poll_time = read_start;
+			break;
+		}
+		
+		if (adc_H != BME280_NO_HUMIDITY)
+		{
+			params_ptr->adc_humidity = adc_H;
+			params_ptr->humidity_compensated = false;
+		}
+		
+		/* A new conversion can come out the same as the last one, at 1x
+		   oversampling or behind the IIR filter it often does.  Once a typical
+		   period has gone by since the last one was first read a repeat is
+		   taken as the next conversion, until then it is the same one.  The
+		   reads in between may have had it already, so all there is to go on is
+		   the last one's window moved on a period.  A chip that stopped
+		   converting repeats forever though, so only a few in a row are taken,
+		   after that it has no new data and the caller's staleness check sees it.
+		*/
+		if ((adc_T == params_ptr->adc_temperature) && (adc_P == params_ptr->adc_pressure))
+		{
+			if (((read_time - params_ptr->seen_time) < params_ptr->typical_period) ||
+				(params_ptr->repeats >= BME280_MAXIMUM_REPEATS))
+			{
+				params_ptr->poll_time = read_start;
+				break;
+			}
+			params_ptr->repeats++;
+			read_time = params_ptr->seen_time + params_ptr->typical_period;
+			if (params_ptr->sample_valid)
+			{
+				params_ptr->poll_time = params_ptr->conversion_time + params_ptr->typical_period;
+			}
+		}
+		else
+		{
+			params_ptr->repeats = 0;
+		}
+		
+		params_ptr->adc_temperature = adc_T;
+		params_ptr->adc_pressure = adc_P;
+		params_ptr->temperature_compensated = false;
+		params_ptr->pressure_compensated = false;
+		if (params_ptr->raw_logging)
+		{
+			bme280_log_raw_sample(params_ptr, read_time);
+		}
+		
+		//There is a conversion every sample period, so it can't be older than that
+		if ((read_time - params_ptr->poll_time) > params_ptr->sample_period)
+		{
+			params_ptr->poll_time = read_time - params_ptr->sample_period;
+		}
+		
+		/* Nor much before a typical period after the last one.  Reads wait that
+		   long, so one that finds the next conversion straight away would
+		   otherwise only have the read a period before to go on.
+		*/
+		int32_t expected_age = (int32_t)(read_time - (params_ptr->conversion_time + params_ptr->typical_period));
+		if (params_ptr->sample_valid && (expected_age >= 0) &&
+			((uint32_t)expected_age < (read_time - params_ptr->poll_time)))
+		{
+			params_ptr->poll_time = read_time - (uint32_t)expected_age;
+		}
+		params_ptr->conversion_time = params_ptr->poll_time;
+		params_ptr->poll_time = read_start;
+		params_ptr->seen_time = read_time;
+		params_ptr->sample_time = params_ptr->conversion_time + ((read_time - params_ptr->conversion_time) / 2);
+		params_ptr->sample_valid = true;
+		params_ptr->pressure_delivered = false;
+		is_new = true;
+	} while(0);
+	return is_new;
+}
+
+//True while the chip isn't expected to have finished a newer conversion than the stored sample
+static bool bme280_is_sample_current(Compensation_Parameters *params_ptr)
+{
+	return params_ptr->sample_valid && ((time_us_32() - params_ptr->conversion_time) < params_ptr->typical_period);
 }
 
 static void bme280_extract_long_data(unsigned char *buffer, BME280_S32_t *data_ptr)
@@ -221,31 +594,76 @@ static void bme280_extract_long_data(unsigned char *buffer, BME280_S32_t *data_p
 	*data_ptr = data_msb | data_lsb | data_xlsb;
 }
 
+static void bme280_extract_data(unsigned char *buffer, uint32_t length, BME280_S32_t *adc_T_ptr, BME280_S32_t *adc_P_ptr,
+	BME280_S32_t *adc_H_ptr)
+{
+   /* Store the parsed register values for pressure data */
+	bme280_extract_long_data(&buffer[0], adc_P_ptr);
+
+	/* Store the parsed register values for temperature data */
+	bme280_extract_long_data(&buffer[3], adc_T_ptr);
+	
+	/* Humidity is 16 bits, no xlsb */
+	*adc_H_ptr = BME280_NO_HUMIDITY;
+	if (length == BME280_HUMIDITY_DATA_REGISTER_SIZE)
+	{
+		*adc_H_ptr = ((BME280_S32_t)buffer[6] << BME280_REGISTER_BIT_SIZE) | buffer[7];
+	}
+}
+
+//Two more bytes in every burst read while humidity is on
+static uint32_t bme280_get_data_length(Compensation_Parameters *params_ptr)
+{
+	return params_ptr->humidity_enabled ? BME280_HUMIDITY_DATA_REGISTER_SIZE : BME280_DATA_REGISTER_SIZE;
+}
+
+//Run from the DMA interrupt when a pressure read finishes
+static void bme280_sample_complete(void *context, Error_Returns status)
+{
+	Compensation_Parameters *params_ptr = (Compensation_Parameters *)context;
+	if (status == RPi_Success)
+	{
+		params_ptr->front_sample ^= 1;
+	}
+	params_ptr->sample_end = time_us_32();
+	params_ptr->sample_status = status;
+	params_ptr->sample_state = sample_complete;
+}
+
+//Starts reading the data registers into the back buffer
+static Error_Returns bme280_start_sample(Compensation_Parameters *params_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t back_sample = params_ptr->front_sample ^ 1;
+	
+	params_ptr->sample_state = sample_in_flight;
+	params_ptr->sample_start = time_us_32();
+	params_ptr->sample_length = bme280_get_data_length(params_ptr);
+	to_return = i2c_async_read(params_ptr->i2c, params_ptr->address, BME280_FIRST_DATA_REGISTER,
+		params_ptr->samples[back_sample], params_ptr->sample_length, bme280_sample_complete, params_ptr);
+	if (to_return != RPi_Success)
+	{
+		params_ptr->sample_state = sample_idle;
+	}
+	return to_return;
+}
+
 //Read all the data from the chip
-static Error_Returns bme280_read_data(Compensation_Parameters *params_ptr, BME280_S32_t *adc_T_ptr, BME280_S32_t *adc_P_ptr)
+static Error_Returns bme280_read_data(Compensation_Parameters *params_ptr, BME280_S32_t *adc_T_ptr, BME280_S32_t *adc_P_ptr,
+	BME280_S32_t *adc_H_ptr)
 {
 	Error_Returns to_return = RPi_NotInitialized;
-    unsigned int data_lsb = 0;
-    unsigned int data_msb = 0;
-	
-	unsigned char buffer[BME280_DATA_REGISTER_SIZE];
-	unsigned int index = 0;
-	//unsigned int status_attempts = 0;
+	unsigned char buffer[BME280_HUMIDITY_DATA_REGISTER_SIZE];
+	uint32_t length = bme280_get_data_length(params_ptr);
 	
 	do
 	{
-		for(index = 0; index < BME280_DATA_REGISTER_SIZE; index++) buffer[index] = 0;
-		
-		buffer[0] = BME280_FIRST_DATA_REGISTER;
-		to_return = bme280_read(params_ptr, buffer, BME280_DATA_REGISTER_SIZE);
+		to_return = bme280_read_registers(params_ptr, BME280_FIRST_DATA_REGISTER, buffer, length);
 		if (to_return != RPi_Success) break;  //No need to continue, just return the error
 
-	   /* Store the parsed register values for pressure data */
-		bme280_extract_long_data(&buffer[0], adc_P_ptr);
-
-		/* Store the parsed register values for temperature data */
-		bme280_extract_long_data(&buffer[3], adc_T_ptr);
-
+		//Waiting for the bus finished any asynchronous read of the chip, this one is newer
+		params_ptr->sample_state = sample_idle;
+		bme280_extract_data(buffer, length, adc_T_ptr, adc_P_ptr, adc_H_ptr);
 	} while(0);
 	
 	return to_return;
@@ -253,121 +671,136 @@ static Error_Returns bme280_read_data(Compensation_Parameters *params_ptr, BME28
 
 /* Assumes the I2C bus has been intialized.
 */
+//Index of the chip already set up at address on the bus, number_bme280_initialized if there isn't one
+static uint32_t bme280_find_device(i2c_inst_t *i2c, spi_inst_t *spi, uint32_t address)
+{
+	uint32_t index = 0;
+	for (index = 0; index < number_bme280_initialized; index++)
+	{
+		if ((bme280_compensation_params[index].i2c == i2c) && (bme280_compensation_params[index].spi == spi) &&
+			(bme280_compensation_params[index].address == address))
+		{
+			break;
+		}
+	}
+	return index;
+}
+
+//Reads the calibration and starts the chip on the pad profile, the transport has to be set up first
+static Error_Returns bme280_configure(Compensation_Parameters *params_ptr)
+{
+	Error_Returns to_return = RPi_Success;
+	unsigned char buffer[BME280_CALIBRATION_BLOCK_SIZE];
+	unsigned char humidity_trim[BME280_HUMIDITY_TRIM_BYTES];
+	
+	do
+	{
+		params_ptr->front_sample = 0;
+		params_ptr->sample_state = sample_idle;
+		params_ptr->async = false;
+		params_ptr->sample_valid = false;
+		params_ptr->humidity_enabled = false;
+		params_ptr->adc_humidity = 0;
+		params_ptr->humidity_compensated = false;
+		params_ptr->raw_logging = false;
+		params_ptr->raw_queue_ready = false;
+		params_ptr->registers_known = false;
+		
+		to_return = bme280_read_registers(params_ptr, BME280_CHIP_RPi_REGISTER, buffer, 1);
+		if (to_return != RPi_Success)
+			{
+			printf("bme280_init():  Error reading chip ID read was %u\n", to_return);
+			break;  //No need to continue just return the failure
+			}
+		if (buffer[0] != BME280_CHIP_ID)
+		{
+			printf("bme280_init():  Error chip ID read was 0x%x\n", buffer[0]);
+		}
+		
+		//Read then unpack the compensation parameters stored in the chip
+		to_return = bme280_read_registers(params_ptr, BME280_FIRST_TRIM_PARAMETER, buffer, BME280_CALIBRATION_BLOCK_SIZE);
+		if (to_return != RPi_Success) break;  //No need to continue just return the failure
+		
+		to_return = bme280_read_registers(params_ptr, BME280_THIRD_TRIM_PARAMETER, humidity_trim,
+			BME280_HUMIDITY_TRIM_BYTES);
+		if (to_return != RPi_Success) break;  //No need to continue just return the failure
+		
+		bme280_calibration_unpack(&params_ptr->calibration, buffer, buffer[BME280_DIG_H1_OFFSET], humidity_trim);
+
+		//Start out sitting on the pad, the flight monitor moves the chip
+		//to faster profiles once the flight starts
+		to_return = bme280_write_profile(params_ptr, &sampling_profiles[barometer_profile_pad]);
+		if (to_return != RPi_Success) break; //Don't continue just return
+
+		pressure_temperature_xlsb_mask = BME280_IIR_ENABLED_MASK;
+		sleep_ms(TIME_DELAY);
+	} while(0);
+	return to_return;
+}
+
 Error_Returns bme280_init(uint32_t *id, i2c_inst_t *i2c, uint32_t address)
 {	
 	Error_Returns to_return = RPi_Success;
-	unsigned char buffer[BME280_TRIM_PARAMETER_BYTES];
-	unsigned int index = 0;
-	
 
-	if (number_bme280_initialized < BME280_SUPPORTED_DEVICE_COUNT)
+	//The same chip can be set up as a barometer and as a thermometer, share one
+	//instance between them so it is only configured and read once
+	uint32_t index = bme280_find_device(i2c, NULL, address);
+	if (index < number_bme280_initialized)
+	{
+		*id = index;
+	}
+	else if (number_bme280_initialized < BME280_SUPPORTED_DEVICE_COUNT)
 	{
 		do
 		{
 			Compensation_Parameters *params_ptr = &bme280_compensation_params[number_bme280_initialized];
+			params_ptr->write = bme280_i2c_write;
+			params_ptr->read = bme280_i2c_read;
 			params_ptr->address = address;
 			params_ptr->i2c = i2c;
+			params_ptr->spi = NULL;
 			
-			for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
-			
-			buffer[0] = BME280_CHIP_RPi_REGISTER;
-			to_return = bme280_read(params_ptr, buffer, 1);
-			if (to_return != RPi_Success)
-				{
-				printf("bme280_init():  Error reading chip ID read was %u\n", to_return);
-				break;  //No need to continue just return the failure
-				}
-			if (buffer[0] != BME280_CHIP_ID)
-			{
-				printf("bme280_init():  Error chip ID read was 0x%x\n", buffer[0]);
-			}
-			
-			//Read then unpack the compensation parameters stored in the chip
-			for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
-			buffer[0] = BME280_FIRST_TRIM_PARAMETER;
-			to_return = bme280_read(params_ptr, buffer, BME280_TRIM_PARAMETER_BYTES);
-			if (to_return != RPi_Success) break;  //No need to continue just return the failure
-			
-			index = 0;
-
-			params_ptr->dig_T1 = buffer[index++];
-			params_ptr->dig_T1 |= buffer[index++]<<8;
-			params_ptr->dig_T2 = buffer[index++];
-			params_ptr->dig_T2 |= buffer[index++]<<8;
-			params_ptr->dig_T3 = buffer[index++];
-			params_ptr->dig_T3 |= buffer[index++]<<8;
-
-			params_ptr->dig_P1 = buffer[index++];
-			params_ptr->dig_P1 |= buffer[index++]<<8;
-			params_ptr->dig_P2 = buffer[index++];
-			params_ptr->dig_P2 |= buffer[index++]<<8;
-			params_ptr->dig_P3 = buffer[index++];
-			params_ptr->dig_P3 |= buffer[index++]<<8;
-			params_ptr->dig_P4 = buffer[index++];
-			params_ptr->dig_P4 |= buffer[index++]<<8;
-			params_ptr->dig_P5 = buffer[index++];
-			params_ptr->dig_P5 |= buffer[index++]<<8;
-			params_ptr->dig_P6 = buffer[index++];
-			params_ptr->dig_P6 |= buffer[index++]<<8;
-			params_ptr->dig_P7 = buffer[index++];
-			params_ptr->dig_P7 |= buffer[index++]<<8;
-			params_ptr->dig_P8 = buffer[index++];
-			params_ptr->dig_P8 |= buffer[index++]<<8;
-			params_ptr->dig_P9 = buffer[index++];
-			params_ptr->dig_P9 |= buffer[index++]<<8;
-			
-			for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
-			buffer[0] = BME280_SECOND_TRIM_PARAMETER;
-			to_return = bme280_read(params_ptr, buffer, 1);
-			if (to_return != RPi_Success) break;  //No need to continue just return the failure
-			
-			params_ptr->dig_H1 = buffer[0] & 0xFF;
-			
-			for(index = 0; index < BME280_TRIM_PARAMETER_BYTES; index++) buffer[index] = 0;
-			buffer[0] = BME280_THIRD_TRIM_PARAMETER;
-			to_return = bme280_read(params_ptr, buffer, 7);
-			if (to_return != RPi_Success) break;  //No need to continue just return the failure
-			
-			index = 0;
-			
-			params_ptr->dig_H2 = buffer[index++] & 0xFF;
-			params_ptr->dig_H2|= buffer[index++]<<8;
-			params_ptr->dig_H3 = buffer[index++];
-			
-			params_ptr->dig_H4 = buffer[index++] <<4;
-			params_ptr->dig_H4 |= buffer[index] & 0x0F;
-			params_ptr->dig_H5 = (buffer[index++] >> 4) & 0x0F;
-			params_ptr->dig_H5 |= buffer[index++]<<4;
-			params_ptr->dig_H6 = buffer[index++] & 0xFF;
-
-			//Configure the chip appropiately to provide pressure and temperature
-			//at a rate appropriate for a Kalman filter
-			
-			buffer[0] = BME280_CTRL_MEASURE_REGISTER;
-			buffer[1] = BME280_SLEEP_MODE; //Need to set up config in sleep mode
-			to_return = bme280_write(params_ptr, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
+			to_return = bme280_configure(params_ptr);
 			if (to_return != RPi_Success) break; //Don't continue just return
+			
+			//Fall back to blocking pressure reads if the DMA channels are all taken
+			params_ptr->async = (i2c_async_init(i2c) == RPi_Success);
 
-			buffer[0] = BME280_CTRL_CONFIG_REGISTER;
-			buffer[1] = BME280_NO_IIR_16_500MS_STANDBY; //4 wire SPI, IIR 16, .5 ms standby time
-			to_return = bme280_write(params_ptr, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
-			if (to_return != RPi_Success) break; //Don't continue just return
+			*id = number_bme280_initialized++;
+		} while(0);
+	}
+	
+	return to_return;
+}
 
-			buffer[0] = BME280_CTRL_HUMIDITY_REGISTER;
-			buffer[1] = BME280_HUMIDITY_OFF;  //No humidity measurements;
-			to_return = bme280_write(params_ptr, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
-			if (to_return != RPi_Success) break; //Don't continue just return
+/* Assumes the SPI bus has been initialized and the chip select pin is an output
+   held high.  Other chips can share the bus on their own chip selects, every
+   transfer holds the spi_dma bus lock.
+*/
+Error_Returns bme280_init_spi(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
+{	
+	Error_Returns to_return = RPi_Success;
 
-			buffer[0] = BME280_CTRL_MEASURE_REGISTER;
-			//Pressure oversample x16, temp oversample x2, normal mode
-			buffer[1] = BME280_PRESS1X_TEMP_1X;
-			to_return = bme280_write(params_ptr, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
+	uint32_t index = bme280_find_device(NULL, spi, chip_select);
+	if (index < number_bme280_initialized)
+	{
+		*id = index;
+	}
+	else if (number_bme280_initialized < BME280_SUPPORTED_DEVICE_COUNT)
+	{
+		do
+		{
+			Compensation_Parameters *params_ptr = &bme280_compensation_params[number_bme280_initialized];
+			params_ptr->write = bme280_spi_write;
+			params_ptr->read = bme280_spi_read;
+			params_ptr->address = chip_select;
+			params_ptr->i2c = NULL;
+			params_ptr->spi = spi;
+			
+			to_return = bme280_configure(params_ptr);
 			if (to_return != RPi_Success) break; //Don't continue just return
 
-			pressure_temperature_xlsb_mask = BME280_IIR_ENABLED_MASK;
-
 			*id = number_bme280_initialized++;
-			sleep_ms(TIME_DELAY); 				 
 		} while(0);
 	}
 	
@@ -380,17 +813,41 @@ Error_Returns bme280_reset(uint32_t id)
 	if (id < number_bme280_initialized)
 	{
 		Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
-	
-		unsigned char buffer[BME280_CTRL_REGISTER_WRITE_SIZE];
-		buffer[0] = BME280_CHIP_RESET_REGISTER;
-		buffer[1] = BME280_CHIP_RESET_WORD;
-		to_return = bme280_write(params_ptr, buffer, BME280_CTRL_REGISTER_WRITE_SIZE);
+		Register_Sequence sequence;
+		
+		sequence.length = 0;
+		bme280_sequence_add(&sequence, BME280_CHIP_RESET_REGISTER, BME280_CHIP_RESET_WORD);
+		to_return = bme280_write_sequence(params_ptr, &sequence);
+		params_ptr->registers_known = false;  //Back to their power on values
 		sleep_ms(TIME_DELAY);  //Delay to allow reset
 	}
 	return to_return;
 }
 
-Error_Returns bme280_get_current_pressure(uint32_t id, uint32_t *pressure_ptr)
+Error_Returns bme280_set_sampling_profile(uint32_t id, Barometer_Sampling_Profile profile, uint32_t *sample_period_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	do
+	{
+		if (id >= number_bme280_initialized)
+		{
+			break;
+		}
+		
+		if (profile >= barometer_profile_count)
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		
+		to_return = bme280_write_profile(&bme280_compensation_params[id], &sampling_profiles[profile]);
+		if (to_return != RPi_Success) break;  //No need to continue, just return the error
+		*sample_period_ptr = bme280_compensation_params[id].sample_period;
+	} while(0);
+	return to_return;
+}
+
+Error_Returns bme280_get_current_pressure(uint32_t id, uint32_t *pressure_ptr, bool *new_sample_ptr)
 {
 	Error_Returns to_return = RPi_NotInitialized;
 	if (id < number_bme280_initialized)
@@ -399,13 +856,69 @@ Error_Returns bme280_get_current_pressure(uint32_t id, uint32_t *pressure_ptr)
 	
 		BME280_S32_t adc_P = 0;
 		BME280_S32_t adc_T = 0;
+		BME280_S32_t adc_H = BME280_NO_HUMIDITY;
 
+		*new_sample_ptr = false;
 		do
 		{
-			to_return = bme280_read_data(params_ptr, &adc_T, &adc_P);
-			if (to_return != RPi_Success) break;  //No need to continue, just return the error
-			compensate_temperature(id, adc_T);	
-			*pressure_ptr = compensate_pressure(id, adc_P);		
+			//No bus traffic until the chip could have converted again, the sample
+			//may still be new to this caller if the thermometer read it
+			if ((params_ptr->sample_state == sample_idle) && bme280_is_sample_current(params_ptr))
+			{
+				bme280_compensate_sample_pressure(params_ptr);
+				*pressure_ptr = params_ptr->pressure;
+				*new_sample_ptr = !params_ptr->pressure_delivered;
+				params_ptr->pressure_delivered = true;
+				to_return = RPi_Success;
+				break;
+			}
+			
+			uint32_t read_start = time_us_32();
+			uint32_t read_time = read_start;
+			if (params_ptr->async)
+			{
+				/* The read is started on one call and compensated on a later one, in
+				   between the caller gets RPi_InUse and can get on with other work.
+				   Reads aren't started ahead of time so the sample is no older than
+				   the transfer.
+				*/
+				if (params_ptr->sample_state == sample_idle)
+				{
+					to_return = bme280_start_sample(params_ptr);
+					if (to_return == RPi_Success) to_return = RPi_InUse;
+					break;
+				}
+				
+				if (params_ptr->sample_state == sample_in_flight)
+				{
+					to_return = RPi_InUse;
+					if ((time_us_32() - params_ptr->sample_start) < BME280_ASYNC_TIMEOUT) break;
+					i2c_async_wait(params_ptr->i2c, 0);  //Stuck, abort it and report the timeout
+				}
+				
+				params_ptr->sample_state = sample_idle;
+				to_return = params_ptr->sample_status;
+				if (to_return != RPi_Success) break;  //No need to continue, just return the error
+				bme280_extract_data(params_ptr->samples[params_ptr->front_sample], params_ptr->sample_length,
+					&adc_T, &adc_P, &adc_H);
+				read_start = params_ptr->sample_start;
+				read_time = params_ptr->sample_end;
+			}
+			else
+			{
+				/* The measuring bit only says the next conversion is running, the
+				   data registers already hold the one before it.  A repeat is
+				   caught by bme280_store_sample().
+				*/
+				to_return = bme280_read_data(params_ptr, &adc_T, &adc_P, &adc_H);
+				if (to_return != RPi_Success) break;  //No need to continue, just return the error
+				read_time = time_us_32();
+			}
+			bme280_store_sample(id, adc_T, adc_P, adc_H, read_start, read_time);
+			bme280_compensate_sample_pressure(params_ptr);
+			*pressure_ptr = params_ptr->pressure;
+			*new_sample_ptr = params_ptr->sample_valid && !params_ptr->pressure_delivered;
+			params_ptr->pressure_delivered = true;
 		}  while(0);
 	}
 	return to_return;
@@ -420,13 +933,147 @@ Error_Returns bme280_get_current_temperature(uint32_t id, int32_t *temperature_p
 		
 		BME280_S32_t adc_P = 0;
 		BME280_S32_t adc_T = 0;
+		BME280_S32_t adc_H = BME280_NO_HUMIDITY;
+
+		do
+		{
+			//Usually the altimeter has just read it along with the pressure
+			if (!bme280_is_sample_current(params_ptr))
+			{
+				uint32_t read_time = time_us_32();
+				to_return = bme280_read_data(params_ptr, &adc_T, &adc_P, &adc_H);
+				if (to_return != RPi_Success) break;  //No need to continue, just return the error
+				bme280_store_sample(id, adc_T, adc_P, adc_H, read_time, time_us_32());
+			}
+			bme280_compensate_sample_temperature(params_ptr);
+			*temperature_ptr = params_ptr->temperature;
+			to_return = RPi_Success;
+		}  while(0);
+	}
+	return to_return;
+}
+
+Error_Returns bme280_get_current_humidity(uint32_t id, uint32_t *humidity_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+		
+		BME280_S32_t adc_P = 0;
+		BME280_S32_t adc_T = 0;
+		BME280_S32_t adc_H = BME280_NO_HUMIDITY;
 
 		do
 		{
-			to_return = bme280_read_data(params_ptr, &adc_T, &adc_P);
-			if (to_return != RPi_Success) break;  //No need to continue, just return the error
-			*temperature_ptr = compensate_temperature(id, adc_T);		
+			if (!params_ptr->humidity_enabled)
+			{
+				break;
+			}
+			
+			//Usually the altimeter has just read it along with the pressure
+			if (!bme280_is_sample_current(params_ptr))
+			{
+				uint32_t read_time = time_us_32();
+				to_return = bme280_read_data(params_ptr, &adc_T, &adc_P, &adc_H);
+				if (to_return != RPi_Success) break;  //No need to continue, just return the error
+				bme280_store_sample(id, adc_T, adc_P, adc_H, read_time, time_us_32());
+			}
+			bme280_compensate_sample_humidity(params_ptr);
+			*humidity_ptr = params_ptr->humidity;
+			to_return = RPi_Success;
 		}  while(0);
 	}
 	return to_return;
 }
+
+Error_Returns bme280_get_last_temperature(uint32_t id, int32_t *temperature_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		*temperature_ptr = bme280_compensation_params[id].temperature;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+//Rewrites the sampling profile, the sample period gets longer by the humidity measurement
+Error_Returns bme280_set_humidity(uint32_t id, bool enable)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+		to_return = RPi_Success;
+		if (params_ptr->humidity_enabled != enable)
+		{
+			params_ptr->humidity_enabled = enable;
+			to_return = bme280_write_profile(params_ptr, params_ptr->profile_ptr);
+		}
+	}
+	return to_return;
+}
+
+Error_Returns bme280_get_sample_time(uint32_t id, uint32_t *time_stamp_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		*time_stamp_ptr = bme280_compensation_params[id].sample_time;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns bme280_set_raw_logging(uint32_t id, bool enable)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		Compensation_Parameters *params_ptr = &bme280_compensation_params[id];
+		if (enable && !params_ptr->raw_queue_ready)
+		{
+			queue_init(&params_ptr->raw_batches, sizeof(Barometer_Raw_Batch), BME280_RAW_BATCH_QUEUE_DEPTH);
+			params_ptr->raw_batch.count = 0;
+			params_ptr->raw_batches_dropped = 0;
+			params_ptr->raw_queue_ready = true;
+		}
+		else if (!enable && params_ptr->raw_logging)
+		{
+			bme280_queue_raw_batch(params_ptr);
+		}
+		params_ptr->raw_logging = enable;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+bool bme280_get_raw_batch(uint32_t id, Barometer_Raw_Batch *batch_ptr)
+{
+	bool to_return = false;
+	if ((id < number_bme280_initialized) && bme280_compensation_params[id].raw_queue_ready)
+	{
+		to_return = queue_try_remove(&bme280_compensation_params[id].raw_batches, batch_ptr);
+	}
+	return to_return;
+}
+
+//Only reads the calibration, which doesn't change after bme280_init(), so either core can call it
+Error_Returns bme280_compensate_raw_sample(uint32_t id, const Barometer_Raw_Sample *sample_ptr,
+	uint32_t *pressure_ptr, int32_t *temperature_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (id < number_bme280_initialized)
+	{
+		const BME280_Calibration *calibration_ptr = &bme280_compensation_params[id].calibration;
+		int32_t t_fine = 0;
+		
+		PROFILE_STAGE_BEGIN(profile_stage_log_compensation);
+		*temperature_ptr = bme280_compensate_temperature(calibration_ptr, sample_ptr->raw_temperature, &t_fine);
+		*pressure_ptr = bme280_compensate_pressure(calibration_ptr, sample_ptr->raw_pressure, t_fine);
+		PROFILE_STAGE_END(profile_stage_log_compensation);
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
@@ -0,0 +1,249 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  bme280_compensation.c
+
+Compensation of the BME 280's raw readings, see bme280_compensation.h.
+
+Note:  The conversion algorithms were taken directly from the Bosch BME 280
+driver, the 64 and 32 bit integer versions.
+
+*/
+
+#include "bme280_compensation.h"
+
+void bme280_calibration_unpack(BME280_Calibration *calibration_ptr, const unsigned char *pressure_trim,
+	unsigned char dig_H1, const unsigned char *humidity_trim)
+{
+	unsigned int index = 0;
+	const unsigned char *buffer = pressure_trim;
+
+	calibration_ptr->dig_T1 = buffer[index++];
+	calibration_ptr->dig_T1 |= buffer[index++]<<8;
+	calibration_ptr->dig_T2 = buffer[index++];
+	calibration_ptr->dig_T2 |= buffer[index++]<<8;
+	calibration_ptr->dig_T3 = buffer[index++];
+	calibration_ptr->dig_T3 |= buffer[index++]<<8;
+
+	calibration_ptr->dig_P1 = buffer[index++];
+	calibration_ptr->dig_P1 |= buffer[index++]<<8;
+	calibration_ptr->dig_P2 = buffer[index++];
+	calibration_ptr->dig_P2 |= buffer[index++]<<8;
+	calibration_ptr->dig_P3 = buffer[index++];
+	calibration_ptr->dig_P3 |= buffer[index++]<<8;
+	calibration_ptr->dig_P4 = buffer[index++];
+	calibration_ptr->dig_P4 |= buffer[index++]<<8;
+	calibration_ptr->dig_P5 = buffer[index++];
+	calibration_ptr->dig_P5 |= buffer[index++]<<8;
+	calibration_ptr->dig_P6 = buffer[index++];
+	calibration_ptr->dig_P6 |= buffer[index++]<<8;
+	calibration_ptr->dig_P7 = buffer[index++];
+	calibration_ptr->dig_P7 |= buffer[index++]<<8;
+	calibration_ptr->dig_P8 = buffer[index++];
+	calibration_ptr->dig_P8 |= buffer[index++]<<8;
+	calibration_ptr->dig_P9 = buffer[index++];
+	calibration_ptr->dig_P9 |= buffer[index++]<<8;
+	
+	calibration_ptr->dig_H1 = dig_H1;
+	
+	index = 0;
+	buffer = humidity_trim;
+	
+	calibration_ptr->dig_H2 = buffer[index++] & 0xFF;
+	calibration_ptr->dig_H2|= buffer[index++]<<8;
+	calibration_ptr->dig_H3 = buffer[index++];
+	
+	//dig_H4 and dig_H5 are signed 12 bit values sharing 0xE5
+	calibration_ptr->dig_H4 = (signed char)buffer[index++] * 16;
+	calibration_ptr->dig_H4 |= buffer[index] & 0x0F;
+	calibration_ptr->dig_H5 = (buffer[index++] >> 4) & 0x0F;
+	calibration_ptr->dig_H5 |= (signed char)buffer[index++] * 16;
+	calibration_ptr->dig_H6 = (signed char)buffer[index++];
+	
+	calibration_ptr->p4_term_64bit = ((int64_t)calibration_ptr->dig_P4) * 34359738368;
+	calibration_ptr->p4_term_32bit = ((int32_t)calibration_ptr->dig_P4) * 65536;
+	calibration_ptr->p7_term_64bit = ((int32_t)calibration_ptr->dig_P7) * 16;
+}
+
+//Taken straight from the Bosch manual.
+int32_t bme280_compensate_temperature(const BME280_Calibration *calib_data, int32_t uncompensated_temperature, int32_t *t_fine_ptr)
+{
+    int32_t var1;
+    int32_t var2;
+    int32_t temperature;
+    int32_t temperature_min = -4000;
+    int32_t temperature_max = 8500;
+
+    var1 = (int32_t)((uncompensated_temperature / 8) - ((int32_t)calib_data->dig_T1 * 2));
+    var1 = (var1 * ((int32_t)calib_data->dig_T2)) / 2048;
+    var2 = (int32_t)((uncompensated_temperature / 16) - ((int32_t)calib_data->dig_T1));
+    var2 = (((var2 * var2) / 4096) * ((int32_t)calib_data->dig_T3)) / 16384;
+    *t_fine_ptr = var1 + var2;
+    temperature = (*t_fine_ptr * 5 + 128) / 256;
+
+    if (temperature < temperature_min)
+    {
+        temperature = temperature_min;
+    }
+    else if (temperature > temperature_max)
+    {
+        temperature = temperature_max;
+    }
+
+    return temperature;
+}
+
+// Straight from the Bosch manual.
+uint32_t bme280_compensate_pressure_64bit(const BME280_Calibration *calib_data, int32_t adc_P, int32_t t_fine)
+{
+    int64_t var1;
+    int64_t var2;
+    int64_t var3;
+    int64_t var4;
+    uint32_t pressure;
+    uint32_t pressure_min = 3000000;
+    uint32_t pressure_max = 11000000;
+	
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)calib_data->dig_P6;
+    var2 = var2 + ((var1 * (int64_t)calib_data->dig_P5) * 131072);
+    var2 = var2 + calib_data->p4_term_64bit;
+    var1 = ((var1 * var1 * (int64_t)calib_data->dig_P3) / 256) + ((var1 * ((int64_t)calib_data->dig_P2) * 4096));
+    var3 = ((int64_t)1) * 140737488355328;
+    var1 = (var3 + var1) * ((int64_t)calib_data->dig_P1) / 8589934592;
+
+    /* To avoid divide by zero exception */
+    if (var1 != 0)
+    {
+        var4 = 1048576 - adc_P;
+        var4 = (((var4 * INT64_C(2147483648)) - var2) * 3125) / var1;
+        var1 = (((int64_t)calib_data->dig_P9) * (var4 / 8192) * (var4 / 8192)) / 33554432;
+        var2 = (((int64_t)calib_data->dig_P8) * var4) / 524288;
+        var4 = ((var4 + var1 + var2) / 256) + calib_data->p7_term_64bit;
+        pressure = (uint32_t)(((var4 / 2) * 100) / 128);
+
+        if (pressure < pressure_min)
+        {
+            pressure = pressure_min;
+        }
+        else if (pressure > pressure_max)
+        {
+            pressure = pressure_max;
+        }
+    }
+    else
+    {
+        pressure = pressure_min;
+    }
+
+    return pressure;
+}
+
+/* Straight from the Bosch driver, the only divide that isn't by a power of two
+   is 32 bit so the RP2040's hardware divider does it.
+*/
+uint32_t bme280_compensate_pressure_32bit(const BME280_Calibration *calib_data, int32_t adc_P, int32_t t_fine)
+{
+    int32_t var1;
+    int32_t var2;
+    int32_t var3;
+    int32_t var4;
+    uint32_t var5;
+    uint32_t pressure;
+    uint32_t pressure_min = 30000;
+    uint32_t pressure_max = 110000;
+
+    var1 = (t_fine / 2) - (int32_t)64000;
+    var2 = (((var1 / 4) * (var1 / 4)) / 2048) * ((int32_t)calib_data->dig_P6);
+    var2 = var2 + ((var1 * ((int32_t)calib_data->dig_P5)) * 2);
+    var2 = (var2 / 4) + calib_data->p4_term_32bit;
+    var3 = (calib_data->dig_P3 * (((var1 / 4) * (var1 / 4)) / 8192)) / 8;
+    var4 = (((int32_t)calib_data->dig_P2) * var1) / 2;
+    var1 = (var3 + var4) / 262144;
+    var1 = (((32768 + var1)) * ((int32_t)calib_data->dig_P1)) / 32768;
+
+    /* To avoid divide by zero exception */
+    if (var1 != 0)
+    {
+        var5 = (uint32_t)((uint32_t)1048576) - adc_P;
+        pressure = ((uint32_t)(var5 - (uint32_t)(var2 / 4096))) * 3125;
+        if (pressure < 0x80000000)
+        {
+            pressure = (pressure << 1) / ((uint32_t)var1);
+        }
+        else
+        {
+            pressure = (pressure / (uint32_t)var1) * 2;
+        }
+
+        var1 = (((int32_t)calib_data->dig_P9) * ((int32_t)(((pressure / 8) * (pressure / 8)) / 8192))) / 4096;
+        var2 = (((int32_t)(pressure / 4)) * ((int32_t)calib_data->dig_P8)) / 8192;
+        pressure = (uint32_t)((int32_t)pressure + ((var1 + var2 + calib_data->dig_P7) / 16));
+
+        if (pressure < pressure_min)
+        {
+            pressure = pressure_min;
+        }
+        else if (pressure > pressure_max)
+        {
+            pressure = pressure_max;
+        }
+    }
+    else
+    {
+        pressure = pressure_min;
+    }
+
+    return pressure * 100;
+}
+
+// Straight from the Bosch manual.
+uint32_t bme280_compensate_humidity(const BME280_Calibration *calib_data, int32_t adc_H, int32_t t_fine)
+{
+    int32_t var1;
+    int32_t var2;
+    int32_t var3;
+    int32_t var4;
+    int32_t var5;
+    uint32_t humidity;
+    uint32_t humidity_max = 102400;
+
+    var1 = t_fine - ((int32_t)76800);
+    var2 = (int32_t)(adc_H * 16384);
+    var3 = (int32_t)(((int32_t)calib_data->dig_H4) * 1048576);
+    var4 = ((int32_t)calib_data->dig_H5) * var1;
+    var5 = (((var2 - var3) - var4) + (int32_t)16384) / 32768;
+    var2 = (var1 * ((int32_t)calib_data->dig_H6)) / 1024;
+    var3 = (var1 * ((int32_t)calib_data->dig_H3)) / 2048;
+    var4 = ((var2 * (var3 + (int32_t)32768)) / 1024) + (int32_t)2097152;
+    var2 = ((var4 * ((int32_t)calib_data->dig_H2)) + 8192) / 16384;
+    var3 = var5 * var2;
+    var4 = ((var3 / 32768) * (var3 / 32768)) / 128;
+    var5 = var3 - ((var4 * ((int32_t)calib_data->dig_H1)) / 16);
+    var5 = (var5 < 0 ? 0 : var5);
+    var5 = (var5 > 419430400 ? 419430400 : var5);
+    humidity = (uint32_t)(var5 / 4096);
+
+    if (humidity > humidity_max)
+    {
+        humidity = humidity_max;
+    }
+
+    return humidity;
+}
@@ -0,0 +1,337 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  i2c_async.c
+
+Implements asynchronous I2C register reads with the RP2040 I2C DMA requests.
+
+A read is a list of command words for the I2C data_cmd register, the register
+address write and then one read command per byte with a restart on the first
+and a stop on the last.  One DMA channel feeds the command words to the TX
+FIFO while another empties the RX FIFO into the caller's buffer, the RX channel
+finishing means the read is complete.  A NACK aborts the transfer in the
+controller, the I2C TX_ABRT interrupt catches that, stops both channels and
+reports I2CS_Ack_Error.  The abort interrupt is only unmasked while a read is
+in progress so the SDK's blocking calls still see their own aborts.
+
+Each bus keeps a short queue of reads behind the one on the wire, the next is
+started from the interrupt as soon as the last finishes.  Devices on i2c0 and
+i2c1 transfer at the same time and the devices sharing a bus are served in
+the order they asked, so one that reads every pass can't starve the others.
+
+*/
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "i2c_async.h"
+
+#define I2C_ASYNC_BUS_COUNT			2
+#define I2C_ASYNC_TX_FIFO_LEVEL		8  //Refill the TX FIFO once it is half empty
+#define I2C_ASYNC_NO_CHANNEL		-1
+
+typedef struct I2C_Async_Request_S {
+	uint8_t address;
+	uint8_t register_address;
+	uint8_t *buffer;
+	uint32_t length;
+	I2C_Async_Callback callback;
+	void *context;
+} I2C_Async_Request;
+
+typedef struct I2C_Async_Bus_S {
+	i2c_inst_t *i2c;
+	int tx_channel;
+	int rx_channel;
+	uint32_t commands[I2C_ASYNC_MAXIMUM_READ + 1];
+	I2C_Async_Request current;
+	I2C_Async_Request pending[I2C_ASYNC_QUEUE_DEPTH];  //Waiting behind current, oldest at first_pending
+	uint32_t first_pending;
+	uint32_t pending_count;
+	volatile bool busy;  //Until the queue is empty
+} I2C_Async_Bus;
+
+static I2C_Async_Bus async_buses[I2C_ASYNC_BUS_COUNT];
+static bool dma_handler_installed = false;
+
+static I2C_Async_Bus *get_bus(i2c_inst_t *i2c)
+{
+	I2C_Async_Bus *bus_ptr = &async_buses[i2c_hw_index(i2c)];
+	return (bus_ptr->i2c == i2c) ? bus_ptr : NULL;
+}
+
+//Stops the channels and leaves the controller disabled, which flushes its FIFOs
+static void stop_transfer(I2C_Async_Bus *bus_ptr)
+{
+	i2c_hw_t *hw = i2c_get_hw(bus_ptr->i2c);
+	dma_channel_abort(bus_ptr->tx_channel);
+	dma_channel_abort(bus_ptr->rx_channel);
+	hw->intr_mask = 0;
+	hw->dma_cr = 0;
+	hw->enable = 0;
+}
+
+//Puts the current request on the wire, called with the bus's interrupts held off
+static void start_transfer(I2C_Async_Bus *bus_ptr)
+{
+	I2C_Async_Request *request_ptr = &bus_ptr->current;
+	uint32_t count = 0;
+	bus_ptr->commands[count++] = request_ptr->register_address;
+	for (uint32_t index = 0; index < request_ptr->length; index++)
+	{
+		bus_ptr->commands[count++] = I2C_IC_DATA_CMD_CMD_BITS;
+	}
+	bus_ptr->commands[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+	bus_ptr->commands[request_ptr->length] |= I2C_IC_DATA_CMD_STOP_BITS;
+	bus_ptr->busy = true;
+	
+	//Same target setup the SDK's blocking calls do
+	i2c_hw_t *hw = i2c_get_hw(bus_ptr->i2c);
+	hw->enable = 0;
+	hw->tar = request_ptr->address;
+	hw->dma_tdlr = I2C_ASYNC_TX_FIFO_LEVEL;
+	hw->dma_rdlr = 0;
+	hw->enable = 1;
+	hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+	hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+	
+	dma_channel_set_write_addr(bus_ptr->rx_channel, request_ptr->buffer, false);
+	dma_channel_set_trans_count(bus_ptr->rx_channel, request_ptr->length, true);
+	dma_channel_set_read_addr(bus_ptr->tx_channel, bus_ptr->commands, false);
+	dma_channel_set_trans_count(bus_ptr->tx_channel, count, true);
+}
+
+//Moves the oldest queued read to current, false if there isn't one
+static bool take_pending(I2C_Async_Bus *bus_ptr)
+{
+	bool to_return = false;
+	if (bus_ptr->pending_count > 0)
+	{
+		bus_ptr->current = bus_ptr->pending[bus_ptr->first_pending];
+		bus_ptr->first_pending = (bus_ptr->first_pending + 1) % I2C_ASYNC_QUEUE_DEPTH;
+		bus_ptr->pending_count--;
+		to_return = true;
+	}
+	return to_return;
+}
+
+/* Starts the next queued read before running the finished one's callback, so
+   the bus is busy again straight away and a read the callback asks for goes
+   to the back of the queue.
+*/
+static void complete_transfer(I2C_Async_Bus *bus_ptr, Error_Returns status)
+{
+	I2C_Async_Request finished = bus_ptr->current;
+	if (take_pending(bus_ptr))
+	{
+		start_transfer(bus_ptr);
+	}
+	else
+	{
+		bus_ptr->busy = false;
+	}
+	
+	if (finished.callback != NULL)
+	{
+		finished.callback(finished.context, status);
+	}
+}
+
+static void dma_handler()
+{
+	for (uint32_t index = 0; index < I2C_ASYNC_BUS_COUNT; index++)
+	{
+		I2C_Async_Bus *bus_ptr = &async_buses[index];
+		if ((bus_ptr->i2c != NULL) && dma_channel_get_irq0_status(bus_ptr->rx_channel))
+		{
+			dma_channel_acknowledge_irq0(bus_ptr->rx_channel);
+			i2c_get_hw(bus_ptr->i2c)->intr_mask = 0;
+			i2c_get_hw(bus_ptr->i2c)->dma_cr = 0;
+			complete_transfer(bus_ptr, RPi_Success);
+		}
+	}
+}
+
+static void abort_handler(I2C_Async_Bus *bus_ptr)
+{
+	i2c_hw_t *hw = i2c_get_hw(bus_ptr->i2c);
+	if (bus_ptr->busy && (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS))
+	{
+		hw->clr_tx_abrt;
+		stop_transfer(bus_ptr);
+		complete_transfer(bus_ptr, I2CS_Ack_Error);
+	}
+}
+
+static void i2c0_abort_handler()
+{
+	abort_handler(&async_buses[0]);
+}
+
+static void i2c1_abort_handler()
+{
+	abort_handler(&async_buses[1]);
+}
+
+Error_Returns i2c_async_init(i2c_inst_t *i2c)
+{
+	Error_Returns to_return = RPi_Success;
+	uint32_t index = i2c_hw_index(i2c);
+	I2C_Async_Bus *bus_ptr = &async_buses[index];
+	
+	do
+	{
+		if (bus_ptr->i2c == i2c)
+		{
+			break;  //Already set up
+		}
+		
+		bus_ptr->tx_channel = dma_claim_unused_channel(false);
+		bus_ptr->rx_channel = dma_claim_unused_channel(false);
+		if ((bus_ptr->tx_channel == I2C_ASYNC_NO_CHANNEL) || (bus_ptr->rx_channel == I2C_ASYNC_NO_CHANNEL))
+		{
+			if (bus_ptr->tx_channel != I2C_ASYNC_NO_CHANNEL) dma_channel_unclaim(bus_ptr->tx_channel);
+			if (bus_ptr->rx_channel != I2C_ASYNC_NO_CHANNEL) dma_channel_unclaim(bus_ptr->rx_channel);
+			to_return = RPi_InsufficientResources;
+			break;
+		}
+		
+		dma_channel_config config = dma_channel_get_default_config(bus_ptr->tx_channel);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+		channel_config_set_read_increment(&config, true);
+		channel_config_set_write_increment(&config, false);
+		channel_config_set_dreq(&config, i2c_get_dreq(i2c, true));
+		dma_channel_set_config(bus_ptr->tx_channel, &config, false);
+		dma_channel_set_write_addr(bus_ptr->tx_channel, &i2c_get_hw(i2c)->data_cmd, false);
+		
+		config = dma_channel_get_default_config(bus_ptr->rx_channel);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+		channel_config_set_read_increment(&config, false);
+		channel_config_set_write_increment(&config, true);
+		channel_config_set_dreq(&config, i2c_get_dreq(i2c, false));
+		dma_channel_set_config(bus_ptr->rx_channel, &config, false);
+		dma_channel_set_read_addr(bus_ptr->rx_channel, &i2c_get_hw(i2c)->data_cmd, false);
+		
+		dma_channel_set_irq0_enabled(bus_ptr->rx_channel, true);
+		if (!dma_handler_installed)
+		{
+			irq_add_shared_handler(DMA_IRQ_0, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+			irq_set_enabled(DMA_IRQ_0, true);
+			dma_handler_installed = true;
+		}
+		
+		i2c_get_hw(i2c)->intr_mask = 0;
+		irq_set_exclusive_handler(I2C0_IRQ + index, index ? i2c1_abort_handler : i2c0_abort_handler);
+		irq_set_enabled(I2C0_IRQ + index, true);
+		
+		bus_ptr->busy = false;
+		bus_ptr->pending_count = 0;
+		bus_ptr->first_pending = 0;
+		bus_ptr->i2c = i2c;
+	} while(0);
+	return to_return;
+}
+
+bool i2c_async_is_available(i2c_inst_t *i2c)
+{
+	return get_bus(i2c) != NULL;
+}
+
+Error_Returns i2c_async_read(i2c_inst_t *i2c, uint8_t address, uint8_t register_address,
+	uint8_t *buffer, uint32_t length, I2C_Async_Callback callback, void *context)
+{
+	Error_Returns to_return = RPi_Success;
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	do
+	{
+		if (bus_ptr == NULL)
+		{
+			to_return = RPi_NotInitialized;
+			break;
+		}
+		
+		if ((length == 0) || (length > I2C_ASYNC_MAXIMUM_READ))
+		{
+			to_return = RPi_InvalidParam;
+			break;
+		}
+		
+		I2C_Async_Request request = {address, register_address, buffer, length, callback, context};
+		uint32_t interrupt_status = save_and_disable_interrupts();
+		if (!bus_ptr->busy)
+		{
+			bus_ptr->current = request;
+			start_transfer(bus_ptr);
+		}
+		else if (bus_ptr->pending_count < I2C_ASYNC_QUEUE_DEPTH)
+		{
+			bus_ptr->pending[(bus_ptr->first_pending + bus_ptr->pending_count) % I2C_ASYNC_QUEUE_DEPTH] = request;
+			bus_ptr->pending_count++;
+		}
+		else
+		{
+			to_return = RPi_InUse;
+		}
+		restore_interrupts(interrupt_status);
+	} while(0);
+	return to_return;
+}
+
+bool i2c_async_is_busy(i2c_inst_t *i2c)
+{
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	return (bus_ptr != NULL) && bus_ptr->busy;
+}
+
+Error_Returns i2c_async_wait(i2c_inst_t *i2c, uint32_t timeout)
+{
+	Error_Returns to_return = RPi_Success;
+	I2C_Async_Bus *bus_ptr = get_bus(i2c);
+	if (bus_ptr != NULL)
+	{
+		uint32_t start = time_us_32();
+		while (bus_ptr->busy)
+		{
+			if ((time_us_32() - start) >= timeout)
+			{
+				//Everything queued behind the stuck read fails with it
+				uint32_t interrupt_status = save_and_disable_interrupts();
+				if (bus_ptr->busy)
+				{
+					stop_transfer(bus_ptr);
+					bus_ptr->busy = false;
+					do
+					{
+						if (bus_ptr->current.callback != NULL)
+						{
+							bus_ptr->current.callback(bus_ptr->current.context, I2CS_Clock_Timeout);
+						}
+					} while (take_pending(bus_ptr));
+					to_return = I2CS_Clock_Timeout;
+				}
+				restore_interrupts(interrupt_status);
+				break;
+			}
+		}
+	}
+	return to_return;
+}
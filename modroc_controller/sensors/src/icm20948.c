@@ -27,10 +27,16 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
 
 #include "icm20948.h"
+#include "spi_dma.h"
 #include "Icm20948_Inv.h"
 #include "Icm20948Dmp3Driver.h"
+#include "Icm20948DataBaseDriver.h"
+#include "Icm20948LoadFirmware.h"
 
 #define ICM20948_SUPPORTED_DEVICE_COUNT ACCELEROMETER_NUMBER_SUPPORTED_DEVICES
 #define ICM20948_REGISTER_RW_SIZE	2
@@ -41,31 +47,52 @@ Note:  The conversion algorithms were taken directly from the BME 280 spec sheet
 #define ICM20948_BANK_3	0x30
 
 #define ICM20948_WHO_AM_I_REGISTER	0x00
-#define ICM20948_LP_CONFIG_REGISTER     0x05
 #define ICM20948_POWER_MANAGEMENT_1_REGISTER 0x06
-#define ICM20948_USER_CONTROL_REGISTER	0x6A
 #define ICM20948_REG_BANK_SEL_REGISTER	0x7F
 
-#define ICM20948_BIT_ACCEL_CYCLE    0x20
-#define ICM20948_BIT_GYRO_CYCLE     0x10
-
 #define ICM20948_WHO_AM_I_VALUE		0xEA
 #define ICM20948_POWER_MGMT_RESET   0x80
-#define ICM20948_SLEEP_BIT			0x40
-#define ICM20948_LP_ENABLE_BIT		0x20
-#define ICM20948_SLAVE_I2C_DISABLE	0x10
-
-#define ICM20948_DMP_LOAD_START    	0x90
+#define ICM20948_POWER_MGMT_AWAKE   0x01  //Sleep clear on the best clock, DMP memory can be read
 
 #define ICM20948_RESET_WAIT         100
-#define ICM20948_INV_MAX_SERIAL_READ 		2
-#define ICM20948_INV_MAX_SERIAL_WRITE 		2
-#define ICM20948_INVALID_DMP_BANK	0xFF
+
+/* The DMP runs at 225 Hz so this is as fast as it hands out accelerometer
+   samples, boost is several g so the full scale is the widest.
+*/
+#define ICM20948_ACCELEROMETER_PERIOD		5  //In milliseconds
+#define ICM20948_ACCELERATION_FULL_SCALE	16  //In g, ICM20948_ACCELERATION_PER_G follows it
+#define ICM20948_INVALID_REGISTER_BANK	0xFF
+
+/* Serial interface handed to the InvenSense driver.  A transfer can be as long
+   as the hardware FIFO so a full FIFO drains in one burst, the DMA channels
+   move anything longer than a few bytes, shorter ones aren't worth setting
+   them up for.
+*/
+#define ICM20948_MAX_SERIAL_READ	INV_MAX_SERIAL_READ
+#define ICM20948_MAX_SERIAL_WRITE	INV_MAX_SERIAL_WRITE
+#define ICM20948_DMA_MINIMUM_BURST	8
+
+/* SPI chip select timing from the datasheet, CS has to be low t_SU.CS before
+   the first clock edge and stay low t_HD.CS after the last one.  Converted to
+   system clock cycles at init.
+*/
+#define ICM20948_CS_SETUP_NS	8
+#define ICM20948_CS_HOLD_NS		500
+#define ICM20948_NS_PER_SECOND	1000000000ULL
 
 typedef struct ICM20948_Params {
 	uint32_t chip_select;
 	spi_inst_t *spi;
+	bool dma;  //Long bursts go over DMA, otherwise blocking
+	uint8_t register_bank;  //Shadow of REG_BANK_SEL
+	uint64_t select_time;  //When chip select was last asserted
+	ICM20948_Bus_Statistics bus_statistics;
+	uint32_t interrupt_pin;  //INT1
+	volatile bool fifo_ready;  //Set by the INT1 edge, cleared once the FIFO is drained
+	volatile uint64_t interrupt_time;  //When INT1 last fired
+	ICM20948_Acceleration acceleration;
 	uint8_t firmware_loaded;
+	struct inv_icm20948 icm20948_driver;
 } ICM20948_Parameters;
 
 static ICM20948_Parameters icm20948_params[ICM20948_SUPPORTED_DEVICE_COUNT];
@@ -77,30 +104,44 @@ static const unsigned char dmp3_image[] = {
 
 #define READ_BIT 0x80
 
-static inline void cs_select(uint32_t chip_select) {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(chip_select, 0);  // Active low
-	sleep_us(10);
-    //asm volatile("nop \n nop \n nop");
+static uint32_t cs_setup_cycles = 0;
+static uint32_t cs_hold_cycles = 0;
+
+static uint32_t icm20948_ns_to_cycles(uint32_t nanoseconds)
+{
+	uint64_t cycles = (uint64_t)clock_get_hz(clk_sys) * nanoseconds;
+	
+	//Round up, a cycle short violates the timing
+	return (uint32_t)((cycles + ICM20948_NS_PER_SECOND - 1) / ICM20948_NS_PER_SECOND);
+}
+
+static inline void cs_select(ICM20948_Parameters *params_ptr) {
+	spi_dma_lock_bus(params_ptr->spi);  //Shared with the barometer
+	params_ptr->select_time = time_us_64();
+	gpio_put(params_ptr->chip_select, 0);  // Active low
+	busy_wait_at_least_cycles(cs_setup_cycles);
 }
 
-static inline void cs_deselect(uint32_t chip_select) {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(chip_select, 1);
-    asm volatile("nop \n nop \n nop");
+/* The blocking and DMA transfers return once the last byte has been clocked
+   in so the hold time runs from here.
+*/
+static inline void cs_deselect(ICM20948_Parameters *params_ptr) {
+	busy_wait_at_least_cycles(cs_hold_cycles);
+	gpio_put(params_ptr->chip_select, 1);
+	params_ptr->bus_statistics.transactions++;
+	params_ptr->bus_statistics.select_time += time_us_64() - params_ptr->select_time;
+	spi_dma_unlock_bus(params_ptr->spi);
 }
 
 static Error_Returns icm20948_set_register_bank(ICM20948_Parameters *params_ptr, uint8_t register_bank)
 {
-	static last_bank_set = 0xFF;
 	Error_Returns to_return = RPi_Success;
-	
-	cs_select(params_ptr->chip_select);
+	uint8_t buffer[ICM20948_REGISTER_RW_SIZE];
 	
 	do
 	{
-		uint8_t buffer[ICM20948_REGISTER_RW_SIZE];
-		if (last_bank_set == register_bank)
+		//Already there, no need to touch the bus
+		if (params_ptr->register_bank == register_bank)
 		{
 			break;
 		}
@@ -108,16 +149,22 @@ static Error_Returns icm20948_set_register_bank(ICM20948_Parameters *params_ptr,
 		buffer[0] = ICM20948_REG_BANK_SEL_REGISTER;
 		buffer[1] = register_bank;
 		
-		if (spi_write_blocking(params_ptr->spi, &buffer, ICM20948_REGISTER_RW_SIZE) ==
+		cs_select(params_ptr);
+		if (spi_write_blocking(params_ptr->spi, buffer, ICM20948_REGISTER_RW_SIZE) ==
 			PICO_ERROR_GENERIC)
 		{
-			printf("icm20948_write reg write 0x%x\n", reg);	
+			printf("icm20948_set_register_bank bank 0x%x\n", register_bank);	
 			to_return = RPi_OperationFailed;
 		}
+		cs_deselect(params_ptr);
+		
+		//The chip's bank is unknown after a failed write
+		params_ptr->register_bank = (to_return == RPi_Success) ? register_bank : ICM20948_INVALID_REGISTER_BANK;
 		
+		//Keep the InvenSense driver's shadow of the same register honest, 0x0F is no bank to it
+		params_ptr->icm20948_driver.lastBank = params_ptr->register_bank >> 4;
 	} while(0);
 	
-	cs_deselect(params_ptr->chip_select);
 	return to_return;
 }
 
@@ -126,7 +173,7 @@ static int icm20948_write(void *param_ptr, uint8_t reg, const uint8_t *buffer, u
 {	
 	int to_return = 0;
 	ICM20948_Parameters *params_ptr = (ICM20948_Parameters *)param_ptr;
-	cs_select(params_ptr->chip_select);
+	cs_select(params_ptr);
 	do
 	{
 		if (spi_write_blocking(params_ptr->spi, &reg, 1) ==
@@ -137,14 +184,29 @@ static int icm20948_write(void *param_ptr, uint8_t reg, const uint8_t *buffer, u
 			break;
 		}
 		
-		if (spi_write_blocking(params_ptr->spi, buffer, tx_bytes) ==
+		if (params_ptr->dma && (tx_bytes >= ICM20948_DMA_MINIMUM_BURST))
+		{
+			if (spi_dma_write(params_ptr->spi, buffer, tx_bytes) != RPi_Success)
+			{
+				printf("icm20948_write burst write %u\n", tx_bytes);
+				to_return = -1;
+			}
+		}
+		else if (spi_write_blocking(params_ptr->spi, buffer, tx_bytes) ==
 			PICO_ERROR_GENERIC)
 		{
 			printf("icm20948_write buffer write %u\n", tx_bytes);
 			to_return = -1;
 		}
 	} while(0);
-	cs_deselect(params_ptr->chip_select);
+	
+	//The InvenSense driver selects banks itself, follow it so the shadow stays valid
+	if (reg == ICM20948_REG_BANK_SEL_REGISTER)
+	{
+		params_ptr->register_bank = (to_return == 0) ? buffer[0] : ICM20948_INVALID_REGISTER_BANK;
+	}
+	
+	cs_deselect(params_ptr);
 	return to_return;
 }
 
@@ -154,7 +216,7 @@ static int icm20948_read(void *param_ptr, uint8_t reg, uint8_t *buffer, uint32_t
 {
 	int to_return = 0;
 	ICM20948_Parameters *params_ptr = (ICM20948_Parameters *)param_ptr;
-	cs_select(params_ptr->chip_select);
+	cs_select(params_ptr);
 	do
 	{
 		reg |= READ_BIT;
@@ -166,14 +228,22 @@ static int icm20948_read(void *param_ptr, uint8_t reg, uint8_t *buffer, uint32_t
 			break;
 		}
 		
-		if (spi_read_blocking(params_ptr->spi, 0x0, buffer, rx_bytes) ==
+		if (params_ptr->dma && (rx_bytes >= ICM20948_DMA_MINIMUM_BURST))
+		{
+			if (spi_dma_read(params_ptr->spi, 0x0, buffer, rx_bytes) != RPi_Success)
+			{
+				printf("icm20948_read burst read %u\n", rx_bytes);
+				to_return = -1;
+			}
+		}
+		else if (spi_read_blocking(params_ptr->spi, 0x0, buffer, rx_bytes) ==
 			PICO_ERROR_GENERIC)
 		{
 			printf("icm20948_write buffer write %u\n", rx_bytes);
 			to_return = -1;
 		}
 	} while(0);
-	cs_deselect(params_ptr->chip_select);
+	cs_deselect(params_ptr);
 	return to_return;
 }
 
@@ -181,7 +251,7 @@ static Error_Returns icm20948_write_register(ICM20948_Parameters *params_ptr, ui
 {
 	Error_Returns to_return = icm20948_set_register_bank(params_ptr, reg_bank);
 	
-	cs_select(params_ptr->chip_select);
+	cs_select(params_ptr);
 	
 	do
 	{
@@ -194,7 +264,7 @@ static Error_Returns icm20948_write_register(ICM20948_Parameters *params_ptr, ui
 		
 		buffer[0] = reg;
 		buffer[1] = register_value; 
-		if (spi_write_blocking(params_ptr->spi, &buffer, ICM20948_REGISTER_RW_SIZE) ==
+		if (spi_write_blocking(params_ptr->spi, buffer, ICM20948_REGISTER_RW_SIZE) ==
 		PICO_ERROR_GENERIC)
 		{
 			printf("icm20948_write_register: reg write failed\n");
@@ -202,15 +272,15 @@ static Error_Returns icm20948_write_register(ICM20948_Parameters *params_ptr, ui
 		}
 	} while(0);
 	
-	cs_deselect(params_ptr->chip_select);
+	cs_deselect(params_ptr);
 	return to_return;
 }
 
-static Error_Returns icm20948_read_register(ICM20948_Parameters *params_ptr, uint8_t reg_bank, uint8_t reg, const uint8_t *register_value)
+static Error_Returns icm20948_read_register(ICM20948_Parameters *params_ptr, uint8_t reg_bank, uint8_t reg, uint8_t *register_value)
 {
 	Error_Returns to_return = icm20948_set_register_bank(params_ptr, reg_bank);
 	
-	cs_select(params_ptr->chip_select);
+	cs_select(params_ptr);
 	do
 	{
 		if (to_return != RPi_Success)
@@ -218,6 +288,7 @@ static Error_Returns icm20948_read_register(ICM20948_Parameters *params_ptr, uin
 			break;
 		}
 		
+		reg |= READ_BIT;
 		if (spi_write_blocking(params_ptr->spi, &reg, 1) ==
 		PICO_ERROR_GENERIC)
 		{
@@ -226,7 +297,7 @@ static Error_Returns icm20948_read_register(ICM20948_Parameters *params_ptr, uin
 			break;
 		}
 		
-		if (spi_read_blocking(params_ptr->spi, register_value, 1) ==
+		if (spi_read_blocking(params_ptr->spi, 0x0, register_value, 1) ==
 			PICO_ERROR_GENERIC)
 		{
 			printf("icm20948_read_register read failed\n");
@@ -234,149 +305,138 @@ static Error_Returns icm20948_read_register(ICM20948_Parameters *params_ptr, uin
 		}
 	} while(0);
 	
-	cs_deselect(params_ptr->chip_select);
+	cs_deselect(params_ptr);
 	return to_return;
 }
 
-//Begin convert
-static int inv_icm20948_write_mems(ICM20948_Parameters *params_ptr, unsigned short reg, unsigned int length, const unsigned char *data)
+//Time base for the InvenSense driver's sample time stamps
+uint64_t inv_icm20948_get_time_us(void)
 {
-    int result=0;
-    unsigned int bytesWritten = 0;
-    unsigned int thisLen;
-    unsigned char lBankSelected;
-    unsigned char lStartAddrSelected;
-	static unsigned char lLastBankSelected;
-            
-	icm20948_set_register_bank(params_ptr, 0)
-    
-    lBankSelected = (reg >> 8);
-	if (lBankSelected != s->lLastBankSelected)
-	{
-		result |= inv_icm20948_write_reg(s, REG_MEM_BANK_SEL, &lBankSelected, 1);
+	return time_us_64();
+}
 
-		if (result)
+void inv_icm20948_sleep_us(int us)
+{
+	sleep_us(us);
+}
+
+/* INT1 only marks the FIFO as ready and notes the time, the drain goes over
+   SPI and could land in the middle of a transfer the main loop has going, so
+   it is left for icm20948_update().
+*/
+static void icm20948_interrupt_handler()
+{
+	for (uint32_t index = 0; index < number_icm20948_initialized; index++)
+	{
+		ICM20948_Parameters *params_ptr = &icm20948_params[index];
+		
+		if (gpio_get_irq_event_mask(params_ptr->interrupt_pin) & GPIO_IRQ_EDGE_RISE)
 		{
-			printf("inv_icm20948_write_mems:  write to %u (bank sel) of %u failed with %d\n",
-			REG_MEM_BANK_SEL, lBankSelected, result);
-			return result;
+			gpio_acknowledge_irq(params_ptr->interrupt_pin, GPIO_IRQ_EDGE_RISE);
+			params_ptr->interrupt_time = time_us_64();
+			params_ptr->fifo_ready = true;
 		}
-		s->lLastBankSelected = lBankSelected;
 	}
-    
-    while (bytesWritten < length) 
-    {
-        lStartAddrSelected = (reg & 0xff);
-        /* Sets the starting read or write address for the selected memory, inside of the selected page (see MEM_SEL Register).
-           Contents are changed after read or write of the selected memory.
-           This register must be written prior to each access to initialize the register to the proper starting address.
-           The address will auto increment during burst transactions.  Two consecutive bursts without re-initializing the start address would skip one address. */
-        result |= inv_icm20948_write_reg(s, REG_MEM_START_ADDR, &lStartAddrSelected, 1);
-        if (result)
-		{
-			printf("inv_icm20948_write_mems:  write to 0x%x (MEM_Start_addr) of 0x%x failed with %d\n",
-			REG_MEM_START_ADDR, lStartAddrSelected, result);
-			sleep_ms(10);
-            return result;
-		}
-        
-        thisLen = min(INV_MAX_SERIAL_WRITE, length-bytesWritten);
-        
-        /* Write data */ 
-        result |= inv_icm20948_write_reg(s, REG_MEM_R_W, &data[bytesWritten], thisLen);
-        if (result)
-		{
-			printf("inv_icm20948_write_mems:  write to %u (memory) of length %u failed with %d\n",
-			REG_MEM_R_W, thisLen, result);
-            return result;
-		}
-        
-        bytesWritten += thisLen;
-        reg += thisLen;
-    }
+}
 
-    //Enable LP_EN since we disabled it at begining of this function.
-    result |= inv_icm20948_set_chip_power_state(s, CHIP_LP_ENABLE, 1);
+static void icm20948_interrupt_init(ICM20948_Parameters *params_ptr)
+{
+	gpio_init(params_ptr->interrupt_pin);
+	gpio_set_dir(params_ptr->interrupt_pin, GPIO_IN);
+	gpio_add_raw_irq_handler(params_ptr->interrupt_pin, icm20948_interrupt_handler);
+	gpio_set_irq_enabled(params_ptr->interrupt_pin, GPIO_IRQ_EDGE_RISE, true);
+	irq_set_enabled(IO_IRQ_BANK0, true);
+}
 
-    return result;
+//Keeps the latest accelerometer sample drained from the DMP FIFO
+static void icm20948_data_handler(void *context, enum inv_icm20948_sensor sensor, uint64_t timestamp,
+	const void *data, const void *arg)
+{
+	ICM20948_Parameters *params_ptr = (ICM20948_Parameters *)context;
+	const long *raw_acceleration = (const long *)data;
+	
+	if (sensor == INV_ICM20948_SENSOR_RAW_ACCELEROMETER)
+	{
+		params_ptr->acceleration.acceleration[0] = raw_acceleration[0];
+		params_ptr->acceleration.acceleration[1] = raw_acceleration[1];
+		params_ptr->acceleration.acceleration[2] = raw_acceleration[2];
+		params_ptr->acceleration.time_stamp = timestamp;
+		params_ptr->acceleration.sequence++;
+	}
 }
 
-Error_Returns icm20948_firmware_load(const unsigned char *data_start_address, unsigned short load_size, unsigned short dmp_load_address)
+//Hands the InvenSense driver transfers as long as the FIFO
+static void icm20948_serif_init(ICM20948_Parameters *params_ptr)
 {
-	Error_Returns to_return = RPi_Success;
-	unsigned char last_bank = ICM20948_INVALID_DMP_BANK;
-    int write_size;
-    int result;
-    unsigned short memaddr;
-    const unsigned char *data;
-    unsigned short size;
-    unsigned char data_cmp[ICM20948_INV_MAX_SERIAL_READ];
-    int flag = 0;
-	int retry_count = 0;
-	int mem_cmp_results = 0;
+	struct inv_icm20948_serif serif;
+	
+	serif.context = params_ptr;
+	serif.read_reg = icm20948_read;
+	serif.write_reg = icm20948_write;
+	serif.max_read = ICM20948_MAX_SERIAL_READ;
+	serif.max_write = ICM20948_MAX_SERIAL_WRITE;
+	serif.is_spi = true;
+	inv_icm20948_reset_states(&params_ptr->icm20948_driver, &serif);
+	
+	//The chip's axes are the body's, samples out of the FIFO are rotated by this
+	inv_icm20948_init_matrix(&params_ptr->icm20948_driver);
+	inv_icm20948_init_structure(&params_ptr->icm20948_driver);
+}
+
+/* The InvenSense driver's bring up wakes the chip, loads the DMP image, checks
+   it by CRC and configures the DMP, then leaves the MEMS asleep with every
+   sensor off.  Enabling a sensor wakes them again, but the full scale and
+   period are written to the chip before that, so they are woken here first.
+   The DMP then fills its FIFO at ICM20948_ACCELEROMETER_PERIOD and pulses INT1.
+*/
+static Error_Returns icm20948_dmp_init(ICM20948_Parameters *params_ptr)
+{
+	Error_Returns to_return = RPi_OperationFailed;
+	struct inv_icm20948 *driver_ptr = &params_ptr->icm20948_driver;
+	int full_scale = ICM20948_ACCELERATION_FULL_SCALE;
+	
+	do
+	{
+		if (inv_icm20948_initialize(driver_ptr, &dmp3_image[0], sizeof(dmp3_image)) != 0)
+		{
+			printf("icm20948_dmp_init:  Failed to load DMP\n");
+			break;
+		}
+		params_ptr->firmware_loaded = 1;
 		
-    // Write DMP memory
-    data = data_start_address;
-    size = load_size;
-    memaddr = dmp_load_address;
-
-    while (size > 0) {
-        write_size = min(size, ICM20948_INV_MAX_SERIAL_WRITE);
-        if ((memaddr & 0xff) + write_size > 0x100) {
-            // Moved across a bank
-            write_size = (memaddr & 0xff) + write_size - 0x100;
-        }
-
-		result = inv_icm20948_write_mems(s, memaddr, write_size, (unsigned char *)data);
-		if (result) 
-		{	
-			printf("Write DMP memory, result = %d\n", result);
-			//return result;
+		if (inv_icm20948_wakeup_mems(driver_ptr) != 0)
+		{
+			printf("icm20948_dmp_init:  Failed to wake the MEMS\n");
+			break;
 		}
-
-        data += write_size;
-        size -= write_size;
-        memaddr += write_size;
-    }
-
-    // Verify DMP memory
-    data = data_start;
-    size = size_start;
-    memaddr = load_addr;
-    while (size > 0) {
-        write_size = min(size, ICM20948_INV_MAX_SERIAL_READ);
-        if ((memaddr & 0xff) + write_size > 0x100) {
-            // Moved across a bank
-            write_size = (memaddr & 0xff) + write_size - 0x100;
-        }	
 		
-
-		result = inv_icm20948_read_mems(s, memaddr, write_size, &data_cmp[0]);
-		if (result)
+		if (inv_icm20948_set_fsr(driver_ptr, INV_ICM20948_SENSOR_RAW_ACCELEROMETER, &full_scale) != 0)
 		{
-			flag++; // Error, DMP not written correctly
-			printf ("Verify result = %d flag = %d\n", result, flag);
+			printf("icm20948_dmp_init:  Failed to set the accelerometer full scale\n");
+			break;
 		}
 		
-		mem_cmp_results = memcmp(data_cmp, data, write_size);
-		if (mem_cmp_results != 0)
+		if (inv_icm20948_set_sensor_period(driver_ptr, INV_ICM20948_SENSOR_RAW_ACCELEROMETER,
+			ICM20948_ACCELEROMETER_PERIOD) != 0)
 		{
-			printf ("Verify data failed = %hhu dmp = %hhu \n", data_cmp[0], data[0]);
-			return -1;
+			printf("icm20948_dmp_init:  Failed to set the accelerometer period\n");
+			break;
 		}
-
 		
-        data += write_size;
-        size -= write_size;
-        memaddr += write_size;
-    }
+		if (inv_icm20948_enable_sensor(driver_ptr, INV_ICM20948_SENSOR_RAW_ACCELEROMETER, 1) != 0)
+		{
+			printf("icm20948_dmp_init:  Failed to enable the accelerometer\n");
+			break;
+		}
+		to_return = RPi_Success;
+	} while(0);
+	
 	return to_return;
 }
-//End convert
 
 /* Assumes the SPI bus has been intialized.
 */
-Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
+Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select, uint32_t interrupt_pin)
 {	
 	Error_Returns to_return = RPi_Success;
 	uint8_t register_val;
@@ -389,6 +449,16 @@ Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
 			params_ptr->chip_select = chip_select;
 			params_ptr->spi = spi;
 			params_ptr->firmware_loaded = 0;
+			params_ptr->register_bank = ICM20948_INVALID_REGISTER_BANK;
+			params_ptr->interrupt_pin = interrupt_pin;
+			params_ptr->fifo_ready = false;
+			params_ptr->acceleration.sequence = 0;
+			params_ptr->bus_statistics.transactions = 0;
+			params_ptr->bus_statistics.select_time = 0;
+			cs_setup_cycles = icm20948_ns_to_cycles(ICM20948_CS_SETUP_NS);
+			cs_hold_cycles = icm20948_ns_to_cycles(ICM20948_CS_HOLD_NS);
+			params_ptr->dma = (spi_dma_init(spi) == RPi_Success);
+			icm20948_serif_init(params_ptr);
 			
 			to_return = icm20948_read_register(params_ptr, ICM20948_BANK_0, ICM20948_WHO_AM_I_REGISTER, 
 				&register_val);
@@ -404,129 +474,44 @@ Error_Returns icm20948_init(uint32_t *id, spi_inst_t *spi, uint32_t chip_select)
 				break;
 			}
 
-			/* Reset the chip */
+			/* A reset clears DMP memory, so it is looked at first.  If only the Pico
+			   was reset the chip still holds the image and neither the reset nor the
+			   load are needed, the driver's bring up reconfigures the rest. */
 			to_return = icm20948_write_register(params_ptr, ICM20948_BANK_0,
-				ICM20948_POWER_MANAGEMENT_1_REGISTER, ICM20948_POWER_MGMT_RESET);
+				ICM20948_POWER_MANAGEMENT_1_REGISTER, ICM20948_POWER_MGMT_AWAKE);
 			if (to_return != RPi_Success)
 			{
-				printf("icm20948_init():  Error resetting chip\n");
-				break;  //No need to continue just return the failure
+				printf("icm20948_init():  Error waking chip\n");
+				break;
 			}
-			sleep_ms(ICM20948_RESET_WAIT);
-			
-			/* When it comes out of reset the chip is  in sleep mode,
-			low power enable is set, the clock used is the best available
-			and the accelerometers and gyroscopes are disabled.  We need
-			to take it out of sleep mode and disable the low power mode */
-			
-			to_return = icm20948_read_register(params_ptr, ICM20948_BANK_0
-				ICM20948_POWER_MANAGEMENT_1_REGISTER, &register_val);
-			if (to_return != RPi_Success)
+			if (inv_icm20948_firmware_present(&params_ptr->icm20948_driver, &dmp3_image[0], sizeof(dmp3_image),
+				DMP_LOAD_START))
 			{
-				printf("icm20948_init():  Error reading chip ID ICM20948_POWER_MANAGEMENT_1_REGISTER\n");
-				break;  //No need to continue just return the failure
+				printf("icm20948_init():  DMP image still loaded, not resetting chip\n");
 			}
-			
-			register_val &= ~ICM20948_SLEEP_BIT;
-			register_val &= ~ICM20948_LP_ENABLE_BIT;
-			to_return = icm20948_write_register(params_ptr, ICM20948_BANK_0
-				ICM20948_POWER_MANAGEMENT_1_REGISTER, register_val);
-			if (to_return != RPi_Success)
+			else
 			{
-				printf("icm20948_init():  Error taking chip out of sleep/lp_enable\n");
-				break;  //No need to continue just return the failure
-			}			
-						
-			register_val = ICM20948_BIT_ACCEL_CYCLE | ICM20948_BIT_GYRO_CYCLE;
-
-			to_return = icm20948_write_register(params_ptr, ICM20948_BANK_0
-				ICM20948_LP_CONFIG_REGISTER, register_val);
-			if (to_return != RPi_Success)
-			{
-				printf("icm20948_init():  Error writing ICM20948_LP_CONFIG_REGISTER\n");
-				break;  //No need to continue just return the failure
-			}	
-			
-
-			register_val = ICM20948_SLAVE_I2C_DISABLE;
-			
-			to_return = icm20948_write_register(params_ptr, ICM20948_BANK_0
-				ICM20948_USER_CONTROL_REGISTER, register_val);
-			if (to_return != RPi_Success)
-			{
-				printf("icm20948_init():  Error writing ICM20948_USER_CONTROL_REGISTER\n");
-				break;  //No need to continue just return the failure
+				/* Reset the chip */
+				to_return = icm20948_write_register(params_ptr, ICM20948_BANK_0,
+					ICM20948_POWER_MANAGEMENT_1_REGISTER, ICM20948_POWER_MGMT_RESET);
+				if (to_return != RPi_Success)
+				{
+					printf("icm20948_init():  Error resetting chip\n");
+					break;  //No need to continue just return the failure
+				}
+				sleep_ms(ICM20948_RESET_WAIT);
 			}
 			
-			to_return = icm20948_firmware_load(&dmp3_image[0], sizeof(dmp3_image),
-				ICM20948_DMP_LOAD_START);
-			
+			to_return = icm20948_dmp_init(params_ptr);
 			if (to_return != RPi_Success)
 			{
-				printf("icm20948_init:  Failed to load DMP\n");
-				to_return = RPi_OperationFailed;
 				break;
 			}
 			
-			/* Begin convert */
-
-			result |= inv_set_dmp_address();
-
-			result |= dmp_reset_control_registers();
-			
-			// set FIFO watermark to 80% of actual FIFO size
-			result |= dmp_set_FIFO_watermark(800);
-
-			// Enable Interrupts.
-			data = 0x2;
-			result |= inv_write_mems_reg(REG_INT_ENABLE, 1, &data); // Enable DMP Interrupt
-			data = 0x1;
-			result |= inv_write_mems_reg(REG_INT_ENABLE_2, 1, &data); // Enable FIFO Overflow Interrupt
-
-			// TRACKING : To have accelerometers datas and the interrupt without gyro enables.
-			data = 0XE4;
-			result |= inv_write_mems_reg(REG_SINGLE_FIFO_PRIORITY_SEL, 1, &data);
-
-			// Disable HW temp fix
-			inv_read_mems_reg(REG_HW_FIX_DISABLE,1,&data);
-			data |= 0x08;
-			inv_write_mems_reg(REG_HW_FIX_DISABLE,1,&data);
-
-			// Setup MEMs properties.
-			base_state.accel_averaging = 1; //Change this value if higher sensor sample avergaing is required.
-			base_state.gyro_averaging = 1;  //Change this value if higher sensor sample avergaing is required.
-			inv_set_gyro_divider(FIFO_DIVIDER);       //Initial sampling rate 1125Hz/10+1 = 102Hz.
-			inv_set_accel_divider(FIFO_DIVIDER);      //Initial sampling rate 1125Hz/10+1 = 102Hz.
-			result |= inv_set_gyro_fullscale(MPU_FS_2000dps);
-			result |= inv_set_accel_fullscale(MPU_FS_2G);
-
-			// FIFO Setup.
-			result |= inv_write_single_mems_reg(REG_FIFO_CFG, BIT_SINGLE_FIFO_CFG); // FIFO Config. fixme do once? burst write?
-			result |= inv_write_single_mems_reg(REG_FIFO_RST, 0x1f); // Reset all FIFOs.
-			result |= inv_write_single_mems_reg(REG_FIFO_RST, 0x1e); // Keep all but Gyro FIFO in reset.
-			result |= inv_write_single_mems_reg(REG_FIFO_EN, 0x0); // Slave FIFO turned off.
-			result |= inv_write_single_mems_reg(REG_FIFO_EN_2, 0x0); // Hardware FIFO turned off.
-			
-			result |= inv_read_mems(MPU_SOFT_UPDT_ADDR, 1, &data);
-
-			base_state.lp_en_support = 1;
-
-			if(base_state.lp_en_support == 1)
-				inv_set_chip_power_state(CHIP_LP_ENABLE, 1);
-
-			result |= inv_sleep_mems();   
-        
-    			
-			/* End convert */ 
-			
-			if (inv_icm20948_load_firmware(&params_ptr->icm20948_driver, &dmp3_image[0], sizeof(dmp3_image)) != 0)
-			{
-				printf("icm20948_init:  Failed to load DMP\n");
-				to_return = RPi_OperationFailed;
-				break;
-			}
+			*id = number_icm20948_initialized++;
 			
-			*id = number_icm20948_initialized++;				 
+			//Counted as initialized first so the handler looks at this chip
+			icm20948_interrupt_init(params_ptr);
 		} while(0);
 	}
 	
@@ -538,3 +523,61 @@ Error_Returns icm20948_reset(uint32_t id)
 	return RPi_Success;
 }
 
+Error_Returns icm20948_get_bus_statistics(uint32_t id, ICM20948_Bus_Statistics *statistics)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	if (id < number_icm20948_initialized)
+	{
+		*statistics = icm20948_params[id].bus_statistics;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns icm20948_update(uint32_t id)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	
+	do
+	{
+		if (id >= number_icm20948_initialized)
+		{
+			break;
+		}
+		
+		ICM20948_Parameters *params_ptr = &icm20948_params[id];
+		to_return = RPi_Success;
+		
+		//Nothing new in the FIFO, leave the bus alone
+		if (!params_ptr->fifo_ready)
+		{
+			break;
+		}
+		
+		//The 64 bit time isn't read atomically, keep the handler out while copying it
+		uint32_t interrupt_status = save_and_disable_interrupts();
+		params_ptr->icm20948_driver.irq_time_us = params_ptr->interrupt_time;
+		params_ptr->fifo_ready = false;
+		restore_interrupts(interrupt_status);
+		
+		if (inv_icm20948_poll_sensor(&params_ptr->icm20948_driver, params_ptr, icm20948_data_handler) != 0)
+		{
+			printf("icm20948_update:  FIFO drain failed\n");
+			to_return = RPi_OperationFailed;
+		}
+		params_ptr->icm20948_driver.irq_time_us = 0;
+	} while(0);
+	
+	return to_return;
+}
+
+Error_Returns icm20948_get_acceleration(uint32_t id, ICM20948_Acceleration *acceleration)
+{
+	Error_Returns to_return = RPi_InvalidParam;
+	if (id < number_icm20948_initialized)
+	{
+		*acceleration = icm20948_params[id].acceleration;
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
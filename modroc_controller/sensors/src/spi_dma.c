@@ -0,0 +1,160 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+File:  spi_dma.c
+
+Implements the DMA burst transfers on the SPI buses described in spi_dma.h.
+
+SPI is full duplex, every byte clocked out brings one back, so both channels
+run for every burst paced by the bus's DREQs.  The side that isn't wanted uses
+a single byte that the channel doesn't step through, the RX channel finishing
+means the last byte has been clocked through.  The blocking SDK calls leave
+the RX FIFO empty, so bursts can follow them on the same chip select.
+
+The bus locks are SDK mutexes set up before main(), so a driver can take one
+without spi_dma_init() having been called for the bus.
+
+*/
+
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+#include "hardware/dma.h"
+
+#include "spi_dma.h"
+
+#define SPI_DMA_BUS_COUNT		2
+#define SPI_DMA_NO_CHANNEL		-1
+
+typedef struct SPI_DMA_Bus_S {
+	spi_inst_t *spi;
+	int tx_channel;
+	int rx_channel;
+	uint8_t unused;  //Sink for writes, the repeated byte for reads
+} SPI_DMA_Bus;
+
+static SPI_DMA_Bus dma_buses[SPI_DMA_BUS_COUNT];
+
+auto_init_mutex(spi0_lock);
+auto_init_mutex(spi1_lock);
+static mutex_t *const bus_locks[SPI_DMA_BUS_COUNT] = {&spi0_lock, &spi1_lock};
+
+static SPI_DMA_Bus *get_bus(spi_inst_t *spi)
+{
+	SPI_DMA_Bus *bus_ptr = &dma_buses[spi_get_index(spi)];
+	return (bus_ptr->spi == spi) ? bus_ptr : NULL;
+}
+
+static void set_channel(int channel, bool read_increment, bool write_increment, uint32_t dreq)
+{
+	dma_channel_config config = dma_channel_get_default_config(channel);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+	channel_config_set_read_increment(&config, read_increment);
+	channel_config_set_write_increment(&config, write_increment);
+	channel_config_set_dreq(&config, dreq);
+	dma_channel_set_config(channel, &config, false);
+}
+
+//Starts both channels together and waits for the last byte to come back
+static void run_burst(SPI_DMA_Bus *bus_ptr, const uint8_t *tx_ptr, bool tx_increment, uint8_t *rx_ptr,
+	bool rx_increment, uint32_t length)
+{
+	spi_inst_t *spi = bus_ptr->spi;
+	
+	set_channel(bus_ptr->tx_channel, tx_increment, false, spi_get_dreq(spi, true));
+	dma_channel_set_read_addr(bus_ptr->tx_channel, tx_ptr, false);
+	dma_channel_set_trans_count(bus_ptr->tx_channel, length, false);
+	
+	set_channel(bus_ptr->rx_channel, false, rx_increment, spi_get_dreq(spi, false));
+	dma_channel_set_write_addr(bus_ptr->rx_channel, rx_ptr, false);
+	dma_channel_set_trans_count(bus_ptr->rx_channel, length, false);
+	
+	dma_start_channel_mask((1u << bus_ptr->tx_channel) | (1u << bus_ptr->rx_channel));
+	dma_channel_wait_for_finish_blocking(bus_ptr->rx_channel);
+}
+
+Error_Returns spi_dma_init(spi_inst_t *spi)
+{
+	Error_Returns to_return = RPi_Success;
+	SPI_DMA_Bus *bus_ptr = &dma_buses[spi_get_index(spi)];
+	
+	do
+	{
+		if (bus_ptr->spi == spi)
+		{
+			break;  //Already set up
+		}
+		
+		bus_ptr->tx_channel = dma_claim_unused_channel(false);
+		bus_ptr->rx_channel = dma_claim_unused_channel(false);
+		if ((bus_ptr->tx_channel == SPI_DMA_NO_CHANNEL) || (bus_ptr->rx_channel == SPI_DMA_NO_CHANNEL))
+		{
+			if (bus_ptr->tx_channel != SPI_DMA_NO_CHANNEL) dma_channel_unclaim(bus_ptr->tx_channel);
+			if (bus_ptr->rx_channel != SPI_DMA_NO_CHANNEL) dma_channel_unclaim(bus_ptr->rx_channel);
+			to_return = RPi_InsufficientResources;
+			break;
+		}
+		
+		//Both channels always move bytes through the data register
+		dma_channel_set_write_addr(bus_ptr->tx_channel, &spi_get_hw(spi)->dr, false);
+		dma_channel_set_read_addr(bus_ptr->rx_channel, &spi_get_hw(spi)->dr, false);
+		bus_ptr->spi = spi;
+	} while(0);
+	return to_return;
+}
+
+void spi_dma_lock_bus(spi_inst_t *spi)
+{
+	mutex_enter_blocking(bus_locks[spi_get_index(spi)]);
+}
+
+void spi_dma_unlock_bus(spi_inst_t *spi)
+{
+	mutex_exit(bus_locks[spi_get_index(spi)]);
+}
+
+bool spi_dma_is_available(spi_inst_t *spi)
+{
+	return get_bus(spi) != NULL;
+}
+
+Error_Returns spi_dma_write(spi_inst_t *spi, const uint8_t *src, uint32_t length)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	SPI_DMA_Bus *bus_ptr = get_bus(spi);
+	if (bus_ptr != NULL)
+	{
+		run_burst(bus_ptr, src, true, &bus_ptr->unused, false, length);
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns spi_dma_read(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, uint32_t length)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	SPI_DMA_Bus *bus_ptr = get_bus(spi);
+	if (bus_ptr != NULL)
+	{
+		bus_ptr->unused = repeated_tx_data;
+		run_burst(bus_ptr, &bus_ptr->unused, false, dst, true, length);
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
@@ -31,8 +31,11 @@ and barometric pressure chips.
 typedef struct Thermometer_Interface_Struct
 {
 Error_Returns (*chip_init)(uint32_t *id, i2c_inst_t *i2c, uint32_t address);
+Error_Returns (*chip_init_spi)(uint32_t *id, spi_inst_t *spi, uint32_t chip_select);
 Error_Returns (*chip_reset)(uint32_t id);
 Error_Returns (*chip_get_current_temperature)(uint32_t id, int32_t *temperature_ptr);
+Error_Returns (*chip_set_humidity)(uint32_t id, bool enable);
+Error_Returns (*chip_get_current_humidity)(uint32_t id, uint32_t *humidity_ptr);
 uint32_t chip_id;
 } Thermometer_Interface;
 
@@ -54,6 +57,8 @@ Error_Returns thermometer_init(i2c_inst_t *i2c, uint32_t address)
 			thermometer_chip.chip_init = bme280_init;
 			thermometer_chip.chip_reset = bme280_reset;
 			thermometer_chip.chip_get_current_temperature = bme280_get_current_temperature;
+			thermometer_chip.chip_set_humidity = bme280_set_humidity;
+			thermometer_chip.chip_get_current_humidity = bme280_get_current_humidity;
 
 			to_return = thermometer_chip.chip_init(&thermometer_chip.chip_id, i2c, address);
 
@@ -73,6 +78,32 @@ Error_Returns thermometer_init(i2c_inst_t *i2c, uint32_t address)
 	return to_return;
 }
 
+Error_Returns thermometer_init_spi(spi_inst_t *spi, uint32_t chip_select)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (!thermometer_ready)
+	{
+		do
+		{
+			thermometer_chip.chip_init_spi = bme280_init_spi;
+			thermometer_chip.chip_reset = bme280_reset;
+			thermometer_chip.chip_get_current_temperature = bme280_get_current_temperature;
+			thermometer_chip.chip_set_humidity = bme280_set_humidity;
+			thermometer_chip.chip_get_current_humidity = bme280_get_current_humidity;
+
+			to_return = thermometer_chip.chip_init_spi(&thermometer_chip.chip_id, spi, chip_select);
+			if (to_return != RPi_Success)
+			{
+				to_return = RPi_NotInitialized;
+				break;
+			}
+			
+			thermometer_ready++;
+		} while(0);
+	}
+	return to_return;
+}
+
 Error_Returns thermometer_reset(uint32_t id)
 {
 	Error_Returns to_return = RPi_NotInitialized;
@@ -94,3 +125,25 @@ double thermometer_get_current_temperature()
 	}
 	return to_return;
 }
+
+Error_Returns thermometer_set_humidity(bool enable)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (thermometer_ready)
+	{
+		to_return = thermometer_chip.chip_set_humidity(thermometer_chip.chip_id, enable);
+	}
+	return to_return;
+}
+
+double thermometer_get_current_humidity()
+{
+	double to_return = 0.0;
+	uint32_t humidity_int;
+	if (thermometer_ready &&
+		(thermometer_chip.chip_get_current_humidity(thermometer_chip.chip_id, &humidity_int) == RPi_Success))
+	{
+		to_return = (double)humidity_int/THERMOMETER_HUMIDITY_SCALE;
+	}
+	return to_return;
+}
@@ -24,127 +24,669 @@ Implements an altitude  function using the MEMS temperature, pressure and humidi
 So the idea behind this was to use the BME 280 chip, grab a base pressure reading
 and then at a given time interval grab an update pressure reading, compare the
 two using a rearrangement of the barometric formula to get a change in altitude.
+The formula itself is evaluated in fixed point by altitude_kernel.c.
 
 Kalman filters are used to smooth out noise in both the pressure readings and
-the calculated altitude
+the calculated altitude.  Alongside the per barometer pressure filters a three
+state (altitude, vertical velocity, vertical acceleration) Kalman filter tracks
+the vertical motion.  It takes barometer altitudes and, when available,
+accelerometer readings each at their own rate, predicting across whatever time
+passed since the last sample.
+
+Any number of barometers up to BAROMETER_NUMBER_SUPPORTED_DEVICES can be fused.
+Each one is weighted by the running variance of its readings against its own
+filter, a barometer that keeps failing to read, or with three or more fitted
+drifts away from the others, is dropped until the next reset.
+
+The default altitude model assumes the standard atmosphere.  The hypsometric
+model instead sums the climb across each sample's fall in log pressure at the
+temperature the barometer measured with it, so a day warmer or colder than
+standard, or an inversion, doesn't skew the altitude.  It starts from the
+standard model's altitude whenever it is selected.
 */
 
 #include "pico/stdlib.h"
+#include "hardware/sync.h"
 #include "altimeter.h"
+#include "altitude_history.h"
+#include "altitude_kernel.h"
 #include "barometer.h"
-#include <math.h>
+#include "kalman_math.h"
+#include "profile.h"
 
-#define MEMS_BAROMETER_MEASUREMENT_ERROR 		1.0
-#define MEMS_BAROMETER_INITIAL_ESTIMATE_ERROR 	1.0
-#define MEMS_BAROMETER_INITIAL_KALMAN_GAIN		1.0
-#define MEMS_BAROMETER_Q_FACTOR					0.01
-#define MEMS_BAROMETER_CONVERGENCE_LOOP_COUNT 	10
+#define MEMS_BAROMETER_MEASUREMENT_ERROR 		KALMAN_CONSTANT(1.0)
+#define MEMS_BAROMETER_INITIAL_ESTIMATE_ERROR 	KALMAN_CONSTANT(1.0)
+#define MEMS_BAROMETER_INITIAL_KALMAN_GAIN		KALMAN_CONSTANT(1.0)
+#define MEMS_BAROMETER_Q_FACTOR					KALMAN_CONSTANT(0.01)
 
-#define MAGIC_EXPONENT				0.1902225603956629  //Basically 1/5.22
-#define MAGIC_MULTIPLIER			44330
-
-#define STANDARD_MSL_HPASCALS		101325.0
-
-#define ALTITUDE_WAIT_TIME 		10 //In milliseconds
-
-typedef struct Kalman_Data {
-	double measurement_error;
-	double estimate_error;	
-	double last_estimate;
-	double estimate;
-	double kalman_gain;
-	double q_factor;
-} Kalman_Filter_Data;
-
-static double base_pressure[BAROMETER_NUMBER_SUPPORTED_DEVICES];
-static Kalman_Filter_Data kalman_filter_data[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+/* Calibration is stepped from altimeter_update_altitude() rather than waited
+   on, it finishes once every barometer's estimate error has settled or gives
+   up waiting on a noisy one after the maximum number of samples.
+*/
+#define CALIBRATION_ESTIMATE_ERROR		KALMAN_CONSTANT(0.1)  //In pascals squared
+#define CALIBRATION_MINIMUM_SAMPLES		4
+#define CALIBRATION_MAXIMUM_SAMPLES		100
+
+/* The pressure filters work on the offset from an origin pressure so the
+   fixed point backend's +/-32767 range is enough.  The origin is moved by
+   whole pascals whenever the estimate drifts past the rebase limit, and a
+   single reading further than the measurement limit from it is clamped.
+*/
+#define PRESSURE_ORIGIN_UNSET			0
+#define PRESSURE_REBASE_LIMIT			8192  //In pascals
+#define PRESSURE_MEASUREMENT_LIMIT		(16384 * BAROMETER_PRESSURE_SCALE)
+
+//Barometer fusion
+#define FUSION_INNOVATION_LIMIT		KALMAN_CONSTANT(128.0)  //In pascals, keeps the square in range
+#define FUSION_MINIMUM_VARIANCE		KALMAN_CONSTANT(0.0625)
+#define FUSION_VARIANCE_SMOOTHING	16  //Running variance moves 1/16 of the way per reading
+#define FUSION_WEIGHT_SCALE			256
+#define BAROMETER_FAILURE_LIMIT		5  //Consecutive failed reads before a barometer is dropped
+#define BAROMETER_STALE_PERIODS		10  //Sample periods without a new sample that count as a failed read
+#define BAROMETER_DRIFT_LIMIT		10000  //In millimeters from the median
+#define BAROMETER_DRIFT_SAMPLES		10  //Consecutive drifted samples before a barometer is dropped
+#define BAROMETER_DRIFT_MINIMUM_COUNT	3  //Barometers needed to tell which one drifted
+
+#define STANDARD_TEMPERATURE	1500  //In hundredths of a degree C, until a barometer reports one
+
+#define MILLIMETERS_PER_METER	1000
+#define MICROSECONDS_PER_SECOND	1000000
+#define BAROMETER_PRESSURE_SCALE	100  //Barometers return pascals * 100
+#define EXTRAPOLATION_SHIFT			16
+#define EXTRAPOLATION_SECONDS_PER_MICROSECOND	(((1LL << (2 * EXTRAPOLATION_SHIFT)) + MICROSECONDS_PER_SECOND / 2) / MICROSECONDS_PER_SECOND)
+
+//Vertical estimator tuning, variances are in meters, seconds units
+#define ESTIMATOR_BAROMETER_VARIANCE		KALMAN_CONSTANT(0.25)
+#define ESTIMATOR_ACCELEROMETER_VARIANCE	KALMAN_CONSTANT(0.5)
+#define ESTIMATOR_JERK_NOISE				KALMAN_CONSTANT(10.0)  //Acceleration random walk per second
+#define ESTIMATOR_INITIAL_VARIANCE			KALMAN_CONSTANT(1.0)
+
+typedef enum {
+	estimator_altitude,
+	estimator_velocity,
+	estimator_acceleration,
+	estimator_state_count
+} Estimator_State_Index;
+
+/* Per barometer state is kept as a structure of arrays indexed by the slot
+   the barometer was given to altimeter_initialize() in, so each pass over the
+   barometers walks one field at a time.
+*/
+typedef struct Barometer_Bank_S {
+	Kalman_Value measurement_error[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	Kalman_Value estimate_error[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	Kalman_Value estimate[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //In pascals from origin
+	Kalman_Value kalman_gain[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	Kalman_Value variance[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Of readings against the estimate, pascals squared
+	uint32_t origin[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //In barometer units, pascals * 100
+	uint32_t raw_pressure[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	uint32_t time_stamp[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Microseconds since boot the last reading was measured
+	uint32_t sample_period[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //In microseconds, for the sampling profile
+	uint32_t base_pressure_reciprocal[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	int32_t raw_altitude[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //In millimeters
+	int32_t filtered_altitude[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //In millimeters
+	int32_t temperature[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Hundredths of a degree C read with the pressure
+	int32_t raw_log_ratio[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Hypsometric model, last ln(pressure ratio)
+	int32_t filtered_log_ratio[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	int64_t raw_climb[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Hypsometric model, millimeters in Q31
+	int64_t filtered_climb[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	uint8_t fresh[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Read on the current pass
+	uint8_t failed[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Dropped until the next reset
+	uint8_t consecutive_failures[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	uint8_t drift_count[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	uint8_t log_ratio_valid[BAROMETER_NUMBER_SUPPORTED_DEVICES];  //Hypsometric sums started
+} Barometer_Bank_t;
+
+typedef struct Vertical_Estimator_S {
+	Kalman_Value state[estimator_state_count];
+	Kalman_Value covariance[estimator_state_count][estimator_state_count];
+	uint32_t time_stamp;  //Microseconds since boot the state is valid at
+} Vertical_Estimator_t;
+
+static Barometer_Bank_t barometers;
+
+typedef enum {
+	calibration_converging,
+	calibration_complete
+} Calibration_State;
 
 static uint32_t barometer_count = 0;
 static uint32_t barometer_ids[BAROMETER_NUMBER_SUPPORTED_DEVICES];
-
-static void reset_kalman_filter_pressure_data(int32_t id)
+static uint32_t first_slot = 0;  //Takes turns at the head of the bus queues
+static uint32_t raw_pressure_time_stamp;  //Of the last fused reading
+static Altimeter_Altitude_Model altitude_model = altitude_model_standard;
+
+static Calibration_State calibration_state = calibration_converging;
+static uint32_t calibration_sample_count = 0;
+
+static Vertical_Estimator_t vertical_estimator;
+//Copies of the estimates handed to readers, written with interrupts off so the
+//repeating timer callbacks never see half an update.  The filtered altitude is
+//converted once per new barometer sample and only read back after that.
+static Altimeter_State_t published_state;
+static Altimeter_Altitude_t published_altitude;
+static uint32_t conversion_count = 0;
+static uint32_t sample_count = 0;
+
+static void reset_kalman_filter_pressure_data(uint32_t slot)
 {
-	kalman_filter_data[id].measurement_error = MEMS_BAROMETER_MEASUREMENT_ERROR;
-	kalman_filter_data[id].estimate_error = MEMS_BAROMETER_INITIAL_ESTIMATE_ERROR;
-	kalman_filter_data[id].last_estimate = STANDARD_MSL_HPASCALS;
-	kalman_filter_data[id].estimate = STANDARD_MSL_HPASCALS;
-	kalman_filter_data[id].kalman_gain = MEMS_BAROMETER_INITIAL_KALMAN_GAIN;
-	kalman_filter_data[id].q_factor = MEMS_BAROMETER_Q_FACTOR;
+	barometers.measurement_error[slot] = MEMS_BAROMETER_MEASUREMENT_ERROR;
+	barometers.estimate_error[slot] = MEMS_BAROMETER_INITIAL_ESTIMATE_ERROR;
+	barometers.estimate[slot] = KALMAN_CONSTANT(0.0);
+	barometers.origin[slot] = PRESSURE_ORIGIN_UNSET;
+	barometers.kalman_gain[slot] = MEMS_BAROMETER_INITIAL_KALMAN_GAIN;
+	barometers.variance[slot] = MEMS_BAROMETER_MEASUREMENT_ERROR;
+	barometers.fresh[slot] = 0;
+	barometers.failed[slot] = 0;
+	barometers.consecutive_failures[slot] = 0;
+	barometers.drift_count[slot] = 0;
+	barometers.temperature[slot] = STANDARD_TEMPERATURE;
+	barometers.log_ratio_valid[slot] = 0;
+	barometers.time_stamp[slot] = time_us_32();
 }
 
 // update_estimate is based on information available at kalmanfilter.net
-static void update_estimate(double measure, Kalman_Filter_Data *filter_data)
+static void update_estimate(uint32_t slot, uint32_t pressure)
 {	
-	filter_data->kalman_gain = filter_data->estimate_error/(filter_data->estimate_error + filter_data->measurement_error);
-	filter_data->estimate = filter_data->last_estimate + (filter_data->kalman_gain * (measure - filter_data->last_estimate));
-	filter_data->estimate_error = (1.0 - filter_data->kalman_gain)*filter_data->estimate_error +
-				fabs(filter_data->last_estimate - filter_data->estimate) * filter_data->q_factor;
-	filter_data->last_estimate = filter_data->estimate;
+	if (barometers.origin[slot] == PRESSURE_ORIGIN_UNSET)
+	{
+		//First reading after a reset, start the estimate on it
+		barometers.origin[slot] = pressure;
+	}
+	
+	int32_t offset = (int32_t)(pressure - barometers.origin[slot]);
+	if (offset > PRESSURE_MEASUREMENT_LIMIT)
+	{
+		offset = PRESSURE_MEASUREMENT_LIMIT;
+	}
+	else if (offset < -PRESSURE_MEASUREMENT_LIMIT)
+	{
+		offset = -PRESSURE_MEASUREMENT_LIMIT;
+	}
+	Kalman_Value measure = KALMAN_FROM_FRACTION(offset, BAROMETER_PRESSURE_SCALE);
+	Kalman_Value last_estimate = barometers.estimate[slot];
+	Kalman_Value estimate_error = barometers.estimate_error[slot];
+	Kalman_Value kalman_gain = KALMAN_DIV(estimate_error, estimate_error + barometers.measurement_error[slot]);
+	Kalman_Value estimate = last_estimate + KALMAN_MUL(kalman_gain, measure - last_estimate);
+	
+	barometers.estimate_error[slot] = KALMAN_MUL(KALMAN_CONSTANT(1.0) - kalman_gain, estimate_error) +
+				KALMAN_MUL(KALMAN_ABS(last_estimate - estimate), MEMS_BAROMETER_Q_FACTOR);
+	barometers.kalman_gain[slot] = kalman_gain;
+	
+	//Running variance of the readings against the estimate, used to weight the barometers
+	Kalman_Value innovation = measure - last_estimate;
+	if (innovation > FUSION_INNOVATION_LIMIT)
+	{
+		innovation = FUSION_INNOVATION_LIMIT;
+	}
+	else if (innovation < -FUSION_INNOVATION_LIMIT)
+	{
+		innovation = -FUSION_INNOVATION_LIMIT;
+	}
+	Kalman_Value variance = barometers.variance[slot];
+	variance += (KALMAN_MUL(innovation, innovation) - variance) / FUSION_VARIANCE_SMOOTHING;
+	barometers.variance[slot] = (variance < FUSION_MINIMUM_VARIANCE) ? FUSION_MINIMUM_VARIANCE : variance;
+	
+	int32_t whole_pascals = KALMAN_TO_INT(estimate);
+	if ((whole_pascals > PRESSURE_REBASE_LIMIT) || (whole_pascals < -PRESSURE_REBASE_LIMIT))
+	{
+		barometers.origin[slot] += whole_pascals * BAROMETER_PRESSURE_SCALE;
+		estimate -= KALMAN_FROM_INT(whole_pascals);
+	}
+	barometers.estimate[slot] = estimate;
 	return;
 }
 
-//Update the Kalman filter for each barometer.
-static Error_Returns get_filtered_readings()
+static void count_failure(uint32_t slot)
 {
-	Error_Returns to_return = RPi_Success;
+	if (++barometers.consecutive_failures[slot] >= BAROMETER_FAILURE_LIMIT)
+	{
+		printf("altitude_package: dropping barometer %u\n", slot);
+		barometers.failed[slot] = 1;
+	}
+}
 
-	do
+/* Update the Kalman filter for each barometer that has a new sample, going by
+   its sampling profile.  A failed read only skips that barometer for this pass,
+   it is dropped after several in a row.  Returns the number of barometers read.
+   
+   Reads are queued per bus, so barometers on i2c0 and i2c1 transfer at the same
+   time and get picked up on a later pass.  Starting from a different barometer
+   each pass puts them at the head of their bus's queue in turn.
+*/
+static uint32_t get_filtered_readings()
+{
+	uint32_t fresh_count = 0;
+	uint32_t now = time_us_32();
+
+	for(uint32_t index = 0; index < barometer_count; index++)
 	{
-		for(uint32_t count = 0; count < barometer_count; count++)
+		uint32_t slot = (first_slot + index) % barometer_count;
+		bool new_sample = false;
+		barometers.fresh[slot] = 0;
+		if (barometers.failed[slot])
+		{
+			continue;
+		}
+		
+		//The driver only goes to the bus once the chip could have a new sample
+		Error_Returns status = barometer_get_current_pressure(barometer_ids[slot], &barometers.raw_pressure[slot], &new_sample);
+		if (status == RPi_InUse)
+		{
+			continue;  //Still on the wire, pick it up next time round
+		}
+		if (status != RPi_Success)
+		{
+			printf("altitude_package: get_filtered_readings barometer %u failed: %u\n", slot, status);
+			count_failure(slot);
+			continue;
+		}
+		if (!new_sample)
 		{
-			uint32_t raw_pressure;
+			//A chip that stopped converting still answers with its last sample
+			if ((now - barometers.time_stamp[slot]) > (BAROMETER_STALE_PERIODS * barometers.sample_period[slot]))
+			{
+				printf("altitude_package: get_filtered_readings barometer %u has no new samples\n", slot);
+				barometers.time_stamp[slot] = now;
+				count_failure(slot);
+			}
+			continue;
+		}
+		
+		barometers.consecutive_failures[slot] = 0;
+		if (barometer_get_sample_time(barometer_ids[slot], &barometers.time_stamp[slot]) != RPi_Success)
+		{
+			barometers.time_stamp[slot] = time_us_32();
+		}
+		barometers.fresh[slot] = 1;
+		fresh_count++;
+		
+		//Read along with the pressure, keeps the last one if there isn't one
+		barometer_get_last_temperature(barometer_ids[slot], &barometers.temperature[slot]);
+		
+		//Returned value is xxxxxxx.xx
+		PROFILE_STAGE_BEGIN(profile_stage_filtering);
+		update_estimate(slot, barometers.raw_pressure[slot]);
+		PROFILE_STAGE_END(profile_stage_filtering);
+	}
+	if (++first_slot >= barometer_count)
+	{
+		first_slot = 0;
+	}
+	sample_count += fresh_count;
+	return fresh_count;
+}
+
+static uint32_t get_usable_barometer_count()
+{
+	uint32_t usable = 0;
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		usable += !barometers.failed[slot];
+	}
+	return usable;
+}
+
+//Returns the filtered pressure in the Q24.8 pascals the altitude kernel works with
+static uint32_t get_estimated_pressure(uint32_t slot)
+{
+	return ((barometers.origin[slot] << ALTITUDE_PRESSURE_FRACTION_BITS) / BAROMETER_PRESSURE_SCALE) +
+		KALMAN_TO_SCALED(barometers.estimate[slot], 1 << ALTITUDE_PRESSURE_FRACTION_BITS);
+}
 
-			to_return = barometer_get_current_pressure(barometer_ids[count], &raw_pressure);
-					
-			if (to_return != RPi_Success)
+static void reset_vertical_estimator(uint32_t time_stamp)
+{
+	for (uint32_t row = 0; row < estimator_state_count; row++)
+	{
+		vertical_estimator.state[row] = KALMAN_CONSTANT(0.0);
+		for (uint32_t column = 0; column < estimator_state_count; column++)
+		{
+			vertical_estimator.covariance[row][column] = (row == column) ? ESTIMATOR_INITIAL_VARIANCE : KALMAN_CONSTANT(0.0);
+		}
+	}
+	vertical_estimator.time_stamp = time_stamp;
+}
+
+/* The constant acceleration transition F times value, F is 1 on the diagonal,
+   dt above it and dt squared / 2 in the corner.  The corner is multiplied in
+   one go, on its own it is under a Q15.16 step for the accelerometer's 5 ms.
+*/
+static Kalman_Value multiply_transition(uint32_t row, uint32_t column, Kalman_Value dt, Kalman_Value value)
+{
+	Kalman_Value to_return = value;
+	if (column == (row + 1))
+	{
+		to_return = KALMAN_MUL(dt, value);
+	}
+	else if (column == (row + 2))
+	{
+		to_return = KALMAN_MUL_HALF_SQUARE(value, dt);
+	}
+	return to_return;
+}
+
+//Move the estimate forward to time_stamp assuming constant acceleration,
+//samples older than the current estimate are applied without a prediction.
+static void predict_vertical_estimator(uint32_t time_stamp)
+{
+	int32_t elapsed = (int32_t)(time_stamp - vertical_estimator.time_stamp);
+	if (elapsed > 0)
+	{
+		Kalman_Value dt = KALMAN_FROM_FRACTION(elapsed, MICROSECONDS_PER_SECOND);
+		Kalman_Value product[estimator_state_count][estimator_state_count];
+		Kalman_Value *state = vertical_estimator.state;
+
+		state[estimator_altitude] += KALMAN_MUL(state[estimator_velocity], dt) +
+			KALMAN_MUL_HALF_SQUARE(state[estimator_acceleration], dt);
+		state[estimator_velocity] += KALMAN_MUL(state[estimator_acceleration], dt);
+
+		//covariance = F * covariance * F' + Q, with Q only driving acceleration
+		for (uint32_t row = 0; row < estimator_state_count; row++)
+		{
+			for (uint32_t column = 0; column < estimator_state_count; column++)
+			{
+				product[row][column] = KALMAN_CONSTANT(0.0);
+				for (uint32_t inner = row; inner < estimator_state_count; inner++)
+				{
+					product[row][column] += multiply_transition(row, inner, dt, vertical_estimator.covariance[inner][column]);
+				}
+			}
+		}
+		for (uint32_t row = 0; row < estimator_state_count; row++)
+		{
+			for (uint32_t column = 0; column < estimator_state_count; column++)
 			{
-				printf("altitude_package: get_filtered_readings failed: %u\n", to_return);
-				break;
+				vertical_estimator.covariance[row][column] = KALMAN_CONSTANT(0.0);
+				for (uint32_t inner = column; inner < estimator_state_count; inner++)
+				{
+					vertical_estimator.covariance[row][column] += multiply_transition(column, inner, dt, product[row][inner]);
+				}
+			}
+		}
+		vertical_estimator.covariance[estimator_acceleration][estimator_acceleration] += KALMAN_MUL(ESTIMATOR_JERK_NOISE, dt);
+		vertical_estimator.time_stamp = time_stamp;
+	}
+}
+
+//Apply a measurement of a single state, since only one state is observed at a
+//time the innovation is a scalar and no matrix inversion is needed.
+static void update_vertical_estimator(Estimator_State_Index observed, Kalman_Value measurement, Kalman_Value variance)
+{
+	Kalman_Value gain[estimator_state_count];
+	Kalman_Value observed_row[estimator_state_count];
+	Kalman_Value innovation = measurement - vertical_estimator.state[observed];
+	Kalman_Value innovation_variance = vertical_estimator.covariance[observed][observed] + variance;
+
+	for (uint32_t row = 0; row < estimator_state_count; row++)
+	{
+		gain[row] = KALMAN_DIV(vertical_estimator.covariance[row][observed], innovation_variance);
+		observed_row[row] = vertical_estimator.covariance[observed][row];
+	}
+	for (uint32_t row = 0; row < estimator_state_count; row++)
+	{
+		vertical_estimator.state[row] += KALMAN_MUL(gain[row], innovation);
+		for (uint32_t column = 0; column < estimator_state_count; column++)
+		{
+			vertical_estimator.covariance[row][column] -= KALMAN_MUL(gain[row], observed_row[column]);
+		}
+	}
+}
+
+static void publish_vertical_estimate()
+{
+	Altimeter_State_t estimate;
+	estimate.altitude = KALMAN_TO_SCALED(vertical_estimator.state[estimator_altitude], MILLIMETERS_PER_METER);
+	estimate.velocity = KALMAN_TO_SCALED(vertical_estimator.state[estimator_velocity], MILLIMETERS_PER_METER);
+	estimate.acceleration = KALMAN_TO_SCALED(vertical_estimator.state[estimator_acceleration], MILLIMETERS_PER_METER);
+	estimate.time_stamp = vertical_estimator.time_stamp;
+
+	uint32_t interrupt_status = save_and_disable_interrupts();
+	published_state = estimate;
+	restore_interrupts(interrupt_status);
+}
+
+static void publish_altitude(int32_t altitude, uint32_t time_stamp)
+{
+	uint32_t interrupt_status = save_and_disable_interrupts();
+	published_altitude.altitude = altitude;
+	published_altitude.time_stamp = time_stamp;
+	published_altitude.sequence++;
+	restore_interrupts(interrupt_status);
+}
+
+/* With enough barometers read on this pass to outvote one, drop any that have
+   stayed too far from the median filtered altitude for too long.
+*/
+static void check_barometer_drift()
+{
+	int32_t sorted[BAROMETER_NUMBER_SUPPORTED_DEVICES];
+	uint32_t sorted_count = 0;
+
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		if (barometers.fresh[slot])
+		{
+			uint32_t position = sorted_count++;
+			while ((position > 0) && (sorted[position - 1] > barometers.filtered_altitude[slot]))
+			{
+				sorted[position] = sorted[position - 1];
+				position--;
+			}
+			sorted[position] = barometers.filtered_altitude[slot];
+		}
+	}
+	
+	if (sorted_count >= BAROMETER_DRIFT_MINIMUM_COUNT)
+	{
+		int32_t median = sorted[sorted_count / 2];
+		for (uint32_t slot = 0; slot < barometer_count; slot++)
+		{
+			if (!barometers.fresh[slot])
+			{
+				continue;
 			}
 			
-			//Returned value is xxxxxxx.x 
-			raw_pressure /= 10;
-			update_estimate((double)(raw_pressure/10), &kalman_filter_data[barometer_ids[count]]);
+			int32_t difference = barometers.filtered_altitude[slot] - median;
+			if ((difference > BAROMETER_DRIFT_LIMIT) || (difference < -BAROMETER_DRIFT_LIMIT))
+			{
+				if (++barometers.drift_count[slot] >= BAROMETER_DRIFT_SAMPLES)
+				{
+					printf("altitude_package: dropping barometer %u, drifted %d mm\n", slot, difference);
+					barometers.failed[slot] = 1;
+					barometers.fresh[slot] = 0;
+				}
+			}
+			else
+			{
+				barometers.drift_count[slot] = 0;
+			}
 		}
-	} while(0);
+	}
+}
+
+/* Adds the climb since the last sample to the hypsometric altitudes, the first
+   sample after the model is selected or the base pressure changes starts the
+   sums from the standard model's altitudes.
+*/
+static void convert_hypsometric(uint32_t slot, uint32_t raw_pressure, uint32_t filtered_pressure)
+{
+	int32_t raw_log_ratio = altitude_kernel_get_log_ratio(raw_pressure, barometers.base_pressure_reciprocal[slot]);
+	int32_t filtered_log_ratio = altitude_kernel_get_log_ratio(filtered_pressure, barometers.base_pressure_reciprocal[slot]);
+	
+	if (barometers.log_ratio_valid[slot])
+	{
+		barometers.raw_climb[slot] += altitude_kernel_get_hypsometric_climb(
+			barometers.raw_log_ratio[slot] - raw_log_ratio, barometers.temperature[slot]);
+		barometers.filtered_climb[slot] += altitude_kernel_get_hypsometric_climb(
+			barometers.filtered_log_ratio[slot] - filtered_log_ratio, barometers.temperature[slot]);
+	}
+	else
+	{
+		barometers.raw_climb[slot] = (int64_t)altitude_kernel_get_altitude(raw_pressure,
+			barometers.base_pressure_reciprocal[slot]) << ALTITUDE_CLIMB_FRACTION_BITS;
+		barometers.filtered_climb[slot] = (int64_t)altitude_kernel_get_altitude(filtered_pressure,
+			barometers.base_pressure_reciprocal[slot]) << ALTITUDE_CLIMB_FRACTION_BITS;
+		barometers.log_ratio_valid[slot] = 1;
+	}
+	
+	barometers.raw_log_ratio[slot] = raw_log_ratio;
+	barometers.filtered_log_ratio[slot] = filtered_log_ratio;
+	barometers.raw_altitude[slot] = (int32_t)(barometers.raw_climb[slot] >> ALTITUDE_CLIMB_FRACTION_BITS);
+	barometers.filtered_altitude[slot] = (int32_t)(barometers.filtered_climb[slot] >> ALTITUDE_CLIMB_FRACTION_BITS);
+}
+
+/* Converts the latest barometer readings to altitudes in millimeters and fuses
+   them, each barometer weighted by the inverse of its running variance.  The
+   filtered altitude is what altimeter_get_delta() reports, the unfiltered one
+   feeds the vertical estimator which does its own smoothing.  Only barometers
+   read on this pass are used, and this is called once per new sample.  Returns
+   RPi_OperationFailed, leaving the altitudes alone, when none of them are left.
+*/
+static Error_Returns convert_readings(int32_t *raw_altitude_ptr, int32_t *filtered_altitude_ptr)
+{
+	Error_Returns to_return = RPi_OperationFailed;
+	int64_t raw_altitude = 0;
+	int64_t filtered_altitude = 0;
+	int64_t time_offset = 0;
+	int32_t total_weight = 0;
+	uint32_t reference_time = 0;
+
+	PROFILE_STAGE_BEGIN(profile_stage_conversion);
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		if (barometers.fresh[slot])
+		{
+			uint32_t pressure = (barometers.raw_pressure[slot] << ALTITUDE_PRESSURE_FRACTION_BITS) / BAROMETER_PRESSURE_SCALE;
+			if (altitude_model == altitude_model_hypsometric)
+			{
+				convert_hypsometric(slot, pressure, get_estimated_pressure(slot));
+			}
+			else
+			{
+				barometers.raw_altitude[slot] = altitude_kernel_get_altitude(pressure, barometers.base_pressure_reciprocal[slot]);
+				barometers.filtered_altitude[slot] = altitude_kernel_get_altitude(get_estimated_pressure(slot),
+					barometers.base_pressure_reciprocal[slot]);
+			}
+		}
+	}
+	conversion_count++;
+	
+	check_barometer_drift();
+
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		if (barometers.fresh[slot])
+		{
+			int32_t weight = KALMAN_TO_SCALED(KALMAN_DIV(KALMAN_CONSTANT(1.0), barometers.variance[slot]), FUSION_WEIGHT_SCALE);
+			if (weight < 1)
+			{
+				weight = 1;
+			}
+			if (total_weight == 0)
+			{
+				reference_time = barometers.time_stamp[slot];
+			}
+			raw_altitude += (int64_t)barometers.raw_altitude[slot] * weight;
+			filtered_altitude += (int64_t)barometers.filtered_altitude[slot] * weight;
+			time_offset += (int64_t)(int32_t)(barometers.time_stamp[slot] - reference_time) * weight;
+			total_weight += weight;
+		}
+	}
+
+	if (total_weight > 0)
+	{
+		*raw_altitude_ptr = (int32_t)(raw_altitude / total_weight);
+		*filtered_altitude_ptr = (int32_t)(filtered_altitude / total_weight);
+		//The barometers were sampled at different times, the fused reading is
+		//timed the same way its altitude is weighted
+		raw_pressure_time_stamp = reference_time + (int32_t)(time_offset / total_weight);
+		to_return = RPi_Success;
+	}
+	PROFILE_STAGE_END(profile_stage_conversion);
 	return to_return;
 }
 
-static double convert_pressure_to_altitude(double base_pressure, double current_pressure)
+//Restarts the filters, the altitude is not published again until calibration completes
+static void start_calibration()
+{
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		reset_kalman_filter_pressure_data(slot);
+	}
+	calibration_sample_count = 0;
+	calibration_state = calibration_converging;
+}
+
+//Takes the settled estimates as the base pressures and starts the altitude from zero
+static void set_base_pressure()
 {
-	//This equation is the barometric formula from the Bosch BMP180 datasheet.
-	//This function returns the difference between the base pressure and the current pressure
-	//in meters.
-	return MAGIC_MULTIPLIER * (1-pow((current_pressure/base_pressure), MAGIC_EXPONENT));
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		barometers.log_ratio_valid[slot] = 0;
+		if (barometers.origin[slot] != PRESSURE_ORIGIN_UNSET)
+		{
+			barometers.base_pressure_reciprocal[slot] =
+				altitude_kernel_get_base_reciprocal(get_estimated_pressure(slot));
+		}
+		else
+		{
+			//Never read, nothing to base altitude on
+			barometers.failed[slot] = 1;
+		}
+	}
 
+	int32_t raw_altitude = 0;
+	int32_t filtered_altitude = 0;
+	convert_readings(&raw_altitude, &filtered_altitude);
+	publish_altitude(filtered_altitude, raw_pressure_time_stamp);
+	altitude_history_reset();
+
+	reset_vertical_estimator(time_us_32());
+	publish_vertical_estimate();
 }
 
-/* This function assumes sole access to the barometers */
-static Error_Returns reset_base_pressure()
+static bool is_calibration_converged()
 {
-	Error_Returns to_return = RPi_Success;
-	do
+	bool converged = true;
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
 	{
-		for (uint32_t count = 0; count < barometer_count; count++)
+		if (!barometers.failed[slot] && (barometers.estimate_error[slot] > CALIBRATION_ESTIMATE_ERROR))
 		{
-			reset_kalman_filter_pressure_data(barometer_ids[count]);
+			converged = false;
 		}
+	}
+	return converged;
+}
 
-		//Find a stable value for the at rest pressure
-		for (unsigned int count = 0; count < MEMS_BAROMETER_CONVERGENCE_LOOP_COUNT; count++)
+/* Takes one calibration sample if a barometer has a new one, this function
+   assumes sole access to the barometers.
+*/
+static Error_Returns step_calibration()
+{
+	Error_Returns to_return = RPi_Success;
+	do
+	{
+		if (get_filtered_readings() == 0)
 		{
-			sleep_ms(ALTITUDE_WAIT_TIME);
-			to_return = get_filtered_readings();			
-			if (to_return != RPi_Success)
+			if (get_usable_barometer_count() == 0)
 			{
-				printf("altitude_package: reset_base_pressure() failed to get filtered reading: %u\n", to_return);
-				break;
+				printf("altitude_package: step_calibration() no barometers could be read\n");
+				to_return = RPi_OperationFailed;
 			}
+			break;
 		}
-
-		for (uint32_t count = 0; count < barometer_count; count++)
+		
+		calibration_sample_count++;
+		if (calibration_sample_count < CALIBRATION_MINIMUM_SAMPLES)
 		{
-			base_pressure[barometer_ids[count]] = kalman_filter_data[barometer_ids[count]].estimate;
+			break;
+		}
+		
+		if (is_calibration_converged() || (calibration_sample_count >= CALIBRATION_MAXIMUM_SAMPLES))
+		{
+			printf("altitude_package: calibrated after %u samples\n", calibration_sample_count);
+			set_base_pressure();
+			calibration_state = calibration_complete;
 		}
 	} while(0);
 	return to_return;
@@ -165,7 +707,10 @@ Error_Returns altimeter_initialize(uint32_t *barometer_id_array, uint32_t number
 		for(uint32_t count = 0; count < barometer_count; count++)
 		{
 			barometer_ids[count] = barometer_id_array[count];
+			barometers.sample_period[count] = 0;
 		}
+		
+		altimeter_set_sampling_profile(barometer_profile_pad);
 				
 		to_return = altimeter_reset();
 	}
@@ -175,40 +720,171 @@ Error_Returns altimeter_initialize(uint32_t *barometer_id_array, uint32_t number
 }
 
 //Resets the base pressure to the current stable pressure readings
+//Starts a new calibration, altimeter_update_altitude() steps it until altimeter_is_ready()
 Error_Returns altimeter_reset()
+{
+	start_calibration();
+	return RPi_Success;
+}
+
+//Re-zeros on the current filtered pressure without restarting the filters
+Error_Returns altimeter_rezero()
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (calibration_state == calibration_complete)
+	{
+		set_base_pressure();
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+Error_Returns altimeter_set_sampling_profile(Barometer_Sampling_Profile profile)
+{
+	Error_Returns to_return = RPi_Success;
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		Error_Returns status = barometer_set_sampling_profile(barometer_ids[slot], profile, &barometers.sample_period[slot]);
+		barometers.time_stamp[slot] = time_us_32();  //Only stale after enough periods on the new profile
+		if (status != RPi_Success)
+		{
+			//Left on its old profile, still usable so carry on with the others
+			printf("altitude_package: barometer %u sampling profile failed: %u\n", slot, status);
+			to_return = status;
+		}
+	}
+	return to_return;
+}
+
+Error_Returns altimeter_set_raw_logging(bool enable)
 {
 	Error_Returns to_return = RPi_Success;
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		Error_Returns status = barometer_set_raw_logging(barometer_ids[slot], enable);
+		if (status != RPi_Success)
+		{
+			printf("altitude_package: barometer %u raw logging failed: %u\n", slot, status);
+			to_return = status;
+		}
+	}
+	return to_return;
+}
+
+void altimeter_set_altitude_model(Altimeter_Altitude_Model model)
+{
+	altitude_model = model;
+	for (uint32_t slot = 0; slot < barometer_count; slot++)
+	{
+		barometers.log_ratio_valid[slot] = 0;
+	}
+}
 
+bool altimeter_is_ready()
+{
+	return calibration_state == calibration_complete;
+}
+
+Error_Returns altimeter_update_altitude()
+{
+	Error_Returns to_return = RPi_Success;
 	do
 	{
-		to_return = reset_base_pressure();
-		if (to_return != RPi_Success)
+		if (calibration_state != calibration_complete)
 		{
-			printf("altimeter: reset_base_pressure failed: %u\n", to_return);
+			to_return = step_calibration();
 			break;
 		}
-
+		
+		int32_t raw_altitude;
+		int32_t filtered_altitude;
+		if ((get_filtered_readings() == 0) || (convert_readings(&raw_altitude, &filtered_altitude) != RPi_Success))
+		{
+			//Nothing new this pass, only an error once every barometer has been dropped
+			if (get_usable_barometer_count() == 0)
+			{
+				to_return = RPi_OperationFailed;
+			}
+			break;
+		}
+		
+		publish_altitude(filtered_altitude, raw_pressure_time_stamp);
+		altitude_history_add(raw_altitude, raw_pressure_time_stamp);
+		
+		PROFILE_STAGE_BEGIN(profile_stage_estimation);
+		predict_vertical_estimator(raw_pressure_time_stamp);
+		update_vertical_estimator(estimator_altitude, KALMAN_FROM_FRACTION(raw_altitude, MILLIMETERS_PER_METER),
+			ESTIMATOR_BAROMETER_VARIANCE);
+		publish_vertical_estimate();
+		PROFILE_STAGE_END(profile_stage_estimation);
 	} while(0);
+	return to_return;
+}
 
+Error_Returns altimeter_update_acceleration(int32_t acceleration, uint32_t time_stamp)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	if (calibration_state == calibration_complete)
+	{
+		PROFILE_STAGE_BEGIN(profile_stage_estimation);
+		predict_vertical_estimator(time_stamp);
+		update_vertical_estimator(estimator_acceleration, KALMAN_FROM_FRACTION(acceleration, MILLIMETERS_PER_METER),
+			ESTIMATOR_ACCELEROMETER_VARIANCE);
+		publish_vertical_estimate();
+		PROFILE_STAGE_END(profile_stage_estimation);
+		to_return = RPi_Success;
+	}
 	return to_return;
 }
 
-Error_Returns altimeter_update_altitude()
+//Extrapolates the last published estimate to the current time without touching
+//the filter, safe to call from the repeating timer callbacks.
+void altimeter_get_state(Altimeter_State_t *state)
 {
-	return get_filtered_readings();
+	uint32_t interrupt_status = save_and_disable_interrupts();
+	*state = published_state;
+	restore_interrupts(interrupt_status);
+
+	int32_t elapsed = (int32_t)(time_us_32() - state->time_stamp);
+	if (elapsed > 0)
+	{
+		//Integer only, dt is seconds in Q16
+		int64_t dt = ((int64_t)elapsed * EXTRAPOLATION_SECONDS_PER_MICROSECOND) >> EXTRAPOLATION_SHIFT;
+		int64_t velocity_change = (state->acceleration * dt) >> EXTRAPOLATION_SHIFT;
+		state->altitude += (int32_t)(((state->velocity * dt) >> EXTRAPOLATION_SHIFT) + ((velocity_change * dt) >> (EXTRAPOLATION_SHIFT + 1)));
+		state->velocity += (int32_t)velocity_change;
+		state->time_stamp += elapsed;
+	}
 }
 
 //Returns the current difference between the base altitude that is obtained at start up
-//or after a call to altitude_reset.
+//or after a call to altitude_reset, in meters.  This is the altitude cached when the
+//last sample was filtered, nothing is recalculated.
 int32_t altimeter_get_delta()
 {
-	double altitude = 0.0;
+	Altimeter_Altitude_t altitude;
+	altimeter_get_altitude(&altitude);
+	return altitude.altitude/MILLIMETERS_PER_METER;
+}
 
-	for (uint32_t count = 0; count < barometer_count; count++)
-	{		
-		altitude += convert_pressure_to_altitude(base_pressure[barometer_ids[count]],
-				kalman_filter_data[barometer_ids[count]].estimate);
-	}
+void altimeter_get_altitude(Altimeter_Altitude_t *altitude)
+{
+	uint32_t interrupt_status = save_and_disable_interrupts();
+	*altitude = published_altitude;
+	restore_interrupts(interrupt_status);
+}
 
-	return (int32_t)altitude/(int32_t)barometer_count;
+uint32_t altimeter_get_conversion_count()
+{
+	return conversion_count;
+}
+
+uint32_t altimeter_get_sample_count()
+{
+	return sample_count;
+}
+
+uint32_t altimeter_get_barometer_count()
+{
+	return get_usable_barometer_count();
 }
@@ -0,0 +1,166 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altitude_history.c
+
+Keeps a ring of the most recent timestamped altitude samples and fits a
+straight line through them to get the climb rate.  The sums the least squares
+fit needs are updated as samples enter and leave the ring so each sample costs
+the same no matter how large the ring is.
+
+Times are kept in 100 microsecond ticks from an epoch inside the ring so the
+sums, and the slope scaled up to millimeters/second, stay well within 64 bits.
+Once the newest sample gets too far from the epoch the epoch is moved up to the
+oldest sample and the sums are rebuilt.  When the ring spans longer than that,
+on the pad profile, it waits until the oldest sample is at least a span from
+the epoch so the rebuild happens once per ring of samples and not on every one.
+
+*/
+
+#include "altitude_history.h"
+
+#define ALTITUDE_HISTORY_TICK			100  //In microseconds
+#define ALTITUDE_HISTORY_TICKS_PER_SECOND	10000
+#define ALTITUDE_HISTORY_REBASE_TIME	(1L << 14)  //In ticks
+#define MILLISECONDS_PER_SECOND			1000
+#define STANDARD_GRAVITY				9807  //In millimeters/second2
+
+typedef struct Altitude_Sample_S
+{
+	int32_t altitude;  //In millimeters
+	int32_t time;  //In ticks from the epoch
+} Altitude_Sample_t;
+
+static Altitude_Sample_t history[ALTITUDE_HISTORY_CAPACITY];
+static uint32_t oldest_sample = 0;
+static uint32_t sample_count = 0;
+static uint32_t epoch = 0;  //In microseconds since boot
+
+static int64_t sum_time = 0;
+static int64_t sum_altitude = 0;
+static int64_t sum_time_squared = 0;
+static int64_t sum_time_altitude = 0;
+
+static void add_to_sums(Altitude_Sample_t *sample)
+{
+	sum_time += sample->time;
+	sum_altitude += sample->altitude;
+	sum_time_squared += (int64_t)sample->time * sample->time;
+	sum_time_altitude += (int64_t)sample->time * sample->altitude;
+}
+
+static void remove_from_sums(Altitude_Sample_t *sample)
+{
+	sum_time -= sample->time;
+	sum_altitude -= sample->altitude;
+	sum_time_squared -= (int64_t)sample->time * sample->time;
+	sum_time_altitude -= (int64_t)sample->time * sample->altitude;
+}
+
+//Move the epoch up to the oldest sample and rebuild the sums from the ring
+static void rebase_history()
+{
+	int32_t shift = history[oldest_sample].time;
+
+	epoch += shift * ALTITUDE_HISTORY_TICK;
+	sum_time = sum_altitude = sum_time_squared = sum_time_altitude = 0;
+	for (uint32_t count = 0; count < sample_count; count++)
+	{
+		Altitude_Sample_t *sample = &history[(oldest_sample + count) % ALTITUDE_HISTORY_CAPACITY];
+		sample->time -= shift;
+		add_to_sums(sample);
+	}
+}
+
+void altitude_history_reset()
+{
+	oldest_sample = 0;
+	sample_count = 0;
+	sum_time = sum_altitude = sum_time_squared = sum_time_altitude = 0;
+}
+
+void altitude_history_add(int32_t altitude, uint32_t time_stamp)
+{
+	Altitude_Sample_t *sample;
+
+	if (sample_count == 0)
+	{
+		epoch = time_stamp;
+	}
+
+	if (sample_count == ALTITUDE_HISTORY_CAPACITY)
+	{
+		sample = &history[oldest_sample];
+		remove_from_sums(sample);
+		oldest_sample = (oldest_sample + 1) % ALTITUDE_HISTORY_CAPACITY;
+	}
+	else
+	{
+		sample = &history[(oldest_sample + sample_count) % ALTITUDE_HISTORY_CAPACITY];
+		sample_count++;
+	}
+
+	sample->altitude = altitude;
+	sample->time = (int32_t)(time_stamp - epoch) / ALTITUDE_HISTORY_TICK;
+	add_to_sums(sample);
+
+	//Times stay within the rebase time, or twice the span of the ring if that is longer
+	int32_t oldest_time = history[oldest_sample].time;
+	if ((sample->time > ALTITUDE_HISTORY_REBASE_TIME) && (oldest_time >= (sample->time - oldest_time)))
+	{
+		rebase_history();
+	}
+}
+
+Error_Returns altitude_history_get_climb_rate(int32_t *climb_rate_ptr)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	do
+	{
+		if (sample_count < ALTITUDE_HISTORY_MINIMUM_SAMPLES)
+		{
+			break;
+		}
+
+		//Slope of the least squares line, n*Sth - St*Sh / n*Stt - St*St
+		int64_t numerator = (int64_t)sample_count * sum_time_altitude - sum_time * sum_altitude;
+		int64_t denominator = (int64_t)sample_count * sum_time_squared - sum_time * sum_time;
+		if (denominator <= 0)
+		{
+			//All the samples have the same time stamp
+			to_return = RPi_InvalidParam;
+			break;
+		}
+
+		*climb_rate_ptr = (int32_t)((numerator * ALTITUDE_HISTORY_TICKS_PER_SECOND) / denominator);
+		to_return = RPi_Success;
+	} while(0);
+	return to_return;
+}
+
+Error_Returns altitude_history_get_time_to_apogee(uint32_t *time_ptr)
+{
+	int32_t climb_rate = 0;
+	Error_Returns to_return = altitude_history_get_climb_rate(&climb_rate);
+	if (to_return == RPi_Success)
+	{
+		*time_ptr = (climb_rate > 0) ? ((uint32_t)climb_rate * MILLISECONDS_PER_SECOND) / STANDARD_GRAVITY : 0;
+	}
+	return to_return;
+}
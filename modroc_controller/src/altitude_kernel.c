@@ -0,0 +1,111 @@
+/*Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining 
+a copy of this software and associated documentation files (the "Software"), 
+to deal in the Software without restriction, including without limitation 
+the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+and/or sell copies of the Software, and to permit persons to whom the Software 
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION 
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  altitude_kernel.c
+
+Implements the pressure to altitude conversion without floating point, the
+RP2040 has no FPU so the pow() the barometric formula needs is a long soft float
+call.  Instead the ratio of the current to the base pressure is formed with one
+32x32 bit multiply against a reciprocal of the base pressure calculated when it
+is set, and the altitude for that ratio is interpolated from altitude_table.h.
+Every call takes the same path so the cost is fixed.
+
+The hypsometric model interpolates ln(ratio) from the same table layout, the
+altitude then comes from summing (R/g) * T * the fall in ln(ratio) per sample,
+one 64 bit multiply.
+
+*/
+
+#include "altitude_kernel.h"
+#include "altitude_table.h"
+
+#define ALTITUDE_RECIPROCAL_SHIFT	25
+#define ALTITUDE_MINIMUM_BASE_PRESSURE	(1UL << (ALTITUDE_RECIPROCAL_SHIFT - 2))
+
+#define ALTITUDE_SEGMENT_SHIFT		(ALTITUDE_RATIO_FRACTION_BITS - ALTITUDE_INDEX_BITS)
+#define ALTITUDE_INTERPOLATION_SHIFT	(ALTITUDE_SEGMENT_SHIFT - ALTITUDE_INTERPOLATION_BITS)
+#define ALTITUDE_INTERPOLATION_MASK	((1UL << ALTITUDE_INTERPOLATION_BITS) - 1)
+#define ALTITUDE_RATIO_MAXIMUM		(ALTITUDE_RATIO_MINIMUM + \
+										((uint32_t)ALTITUDE_TABLE_SEGMENTS << ALTITUDE_SEGMENT_SHIFT) - 1)
+
+/* Dry air gas constant over standard gravity, 287.053 / 9.80665 meters per
+   kelvin, scaled to millimeters per hundredth of a kelvin in Q8.
+*/
+#define HYPSOMETRIC_GAIN			74934
+#define HYPSOMETRIC_GAIN_BITS		8
+#if (ALTITUDE_LOG_FRACTION_BITS + HYPSOMETRIC_GAIN_BITS) != ALTITUDE_CLIMB_FRACTION_BITS
+#error "Hypsometric climb fraction does not match the log table and gain"
+#endif
+
+#define KELVIN_OFFSET				27315  //0C in hundredths of a kelvin
+
+/* The reciprocal is 2^55 / base pressure, that stays within 32 bits as long
+   as the base pressure is at least 2^23 (32768 pascals in Q24.8).  Multiplying
+   a pressure by it and shifting down by 25 leaves the ratio in Q2.30.
+*/
+uint32_t altitude_kernel_get_base_reciprocal(uint32_t base_pressure)
+{
+	uint32_t to_return = 0;
+	if (base_pressure >= ALTITUDE_MINIMUM_BASE_PRESSURE)
+	{
+		to_return = (uint32_t)((1ULL << (ALTITUDE_RATIO_FRACTION_BITS + ALTITUDE_RECIPROCAL_SHIFT)) / base_pressure);
+	}
+	return to_return;
+}
+
+//Interpolates between the entries of a generated table at the pressure ratio
+static inline int32_t lookup(const int32_t *table, uint32_t pressure, uint32_t base_reciprocal)
+{
+	uint64_t ratio = ((uint64_t)pressure * base_reciprocal) >> ALTITUDE_RECIPROCAL_SHIFT;
+	
+	if (ratio < ALTITUDE_RATIO_MINIMUM)
+	{
+		ratio = ALTITUDE_RATIO_MINIMUM;
+	}
+	else if (ratio > ALTITUDE_RATIO_MAXIMUM)
+	{
+		ratio = ALTITUDE_RATIO_MAXIMUM;
+	}
+	
+	uint32_t offset = (uint32_t)ratio - ALTITUDE_RATIO_MINIMUM;
+	uint32_t index = offset >> ALTITUDE_SEGMENT_SHIFT;
+	int32_t fraction = (int32_t)((offset >> ALTITUDE_INTERPOLATION_SHIFT) & ALTITUDE_INTERPOLATION_MASK);
+	int32_t low = table[index];
+	
+	//Adjacent altitude entries are at most ~51m apart, log entries at most 2^17,
+	//so the product fits in 32 bits
+	return low + (((table[index + 1] - low) * fraction) >> ALTITUDE_INTERPOLATION_BITS);
+}
+
+int32_t altitude_kernel_get_altitude(uint32_t pressure, uint32_t base_reciprocal)
+{
+	return lookup(altitude_table, pressure, base_reciprocal);
+}
+
+int32_t altitude_kernel_get_log_ratio(uint32_t pressure, uint32_t base_reciprocal)
+{
+	return lookup(log_ratio_table, pressure, base_reciprocal);
+}
+
+//Product is in millimeters with 31 fraction bits already, no shift needed
+int64_t altitude_kernel_get_hypsometric_climb(int32_t log_ratio_fall, int32_t temperature)
+{
+	uint32_t gain = (uint32_t)(temperature + KELVIN_OFFSET) * HYPSOMETRIC_GAIN;
+	return (int64_t)log_ratio_fall * gain;
+}
@@ -27,12 +27,20 @@ File:  input_task.c
 #include "common.h"
 #include "flight_monitor.h"
 #include "altimeter.h"
+#include "altitude_history.h"
 #include "thermometer.h"
+#include "kinematics.h"
 
 #define DEFAULT_ASCENT_TIMER_MS 1000
 #define DEFAULT_DESCENT_TIMER_MS 1000
 
 #define APOGEE_DETECTION_DELTA 1
+//Climb rate that has to be seen before a drop to zero counts as apogee, keeps
+//pad and early boost noise from triggering it
+#define APOGEE_ARMING_CLIMB_RATE 5000  //In millimeters/second
+#define MILLIMETERS_PER_METER 1000
+//How often the altimeter is re-zeroed while sitting on the pad, follows the weather
+#define PAD_REZERO_INTERVAL 10000000  //In microseconds
 
 typedef struct Critical_Flight_Params_S
 {
@@ -40,22 +48,48 @@ typedef struct Critical_Flight_Params_S
 	int32_t maximum_altitude;
 } Critical_Flight_Params_t;
 
-typedef enum {
-	phase_initial,
-	phase_pad_idle,
-	phase_ascent,
-	phase_descent,
-	phase_ground_idle
-} Flight_Phase;
-
 static int32_t ascent_timer_interval = DEFAULT_ASCENT_TIMER_MS;
 static int32_t descent_timer_interval = DEFAULT_DESCENT_TIMER_MS;
+static Flight_Phase current_flight_phase = phase_initial;
+static volatile bool descent_log_due = false;
+static bool kinematics_failing = false;  //Flying on the barometers alone until it recovers
+
+//A barometer left on the old profile still works, so only log a failure
+static void set_sampling_profile(Barometer_Sampling_Profile profile)
+{
+	Error_Returns status = altimeter_set_sampling_profile(profile);
+	if (status != RPi_Success)
+	{
+		message_send_log("flight_state_machine(): altimeter_set_sampling_profile %u failed: %u\n", profile, status);
+	}
+}
+
+//Every barometer sample is logged during ascent, the output task compensates them
+static void set_raw_logging(bool enable)
+{
+	Error_Returns status = altimeter_set_raw_logging(enable);
+	if (status != RPi_Success)
+	{
+		message_send_log("flight_state_machine(): altimeter_set_raw_logging failed: %u\n", status);
+	}
+}
+
+//Humidity is logged during descent for density altitude, off the rest of the time
+static void set_humidity(bool enable)
+{
+	Error_Returns status = thermometer_set_humidity(enable);
+	if (status != RPi_Success)
+	{
+		message_send_log("flight_state_machine(): thermometer_set_humidity failed: %u\n", status);
+	}
+}
 
 //Handler for logging during descent, called from the
 //repeating timer code provided in the SDK.
 static bool log_ascent_parameters(repeating_timer_t *rt) 
 {
 	Log_Ascent_Parameters_t entry;
+	Altimeter_State_t vertical_state;
 	Critical_Flight_Params_t *critical_flight_params = (Critical_Flight_Params_t *) rt->user_data;
 		
 	critical_flight_params->current_altitude = entry.altitude = altimeter_get_delta();
@@ -63,27 +97,38 @@ static bool log_ascent_parameters(repeating_timer_t *rt)
 	{
 		critical_flight_params->maximum_altitude = critical_flight_params->current_altitude;
 	}
-	entry.z_acceleration = 0;
-	entry.z_velocity = 0;
+	altimeter_get_state(&vertical_state);
+	entry.z_acceleration = (int16_t)(vertical_state.acceleration / MILLIMETERS_PER_METER);
+	entry.z_velocity = (int16_t)(vertical_state.velocity / MILLIMETERS_PER_METER);
 	message_log_ascent_params(&entry);
 
 	return true; // keep repeating	
 }
 
 //Handler for logging during descent, called from the
-//repeating timer code provided in the SDK.
-static bool log_descent_parameters(repeating_timer_t *rt) 
+//repeating timer code provided in the SDK.  The thermometer shares a bus
+//with the flight loop, so its read is left to log_descent_parameters().
+static bool mark_descent_log_due(repeating_timer_t *rt) 
 {
-	Log_Descent_Parameters_t entry;
 	Critical_Flight_Params_t *critical_flight_params = (Critical_Flight_Params_t *) rt->user_data;
 	
-	critical_flight_params->current_altitude = entry.altitude = altimeter_get_delta();
-	entry.temperature = thermometer_get_current_temperature();
-	message_log_descent_params(&entry);
+	critical_flight_params->current_altitude = altimeter_get_delta();
+	descent_log_due = true;
 
 	return true; // keep repeating	
 }
 
+static void log_descent_parameters()
+{
+	Log_Descent_Parameters_t entry;
+	
+	descent_log_due = false;
+	entry.altitude = altimeter_get_delta();
+	entry.temperature = thermometer_get_current_temperature();
+	entry.humidity = thermometer_get_current_humidity();
+	message_log_descent_params(&entry);
+}
+
 //Finite state machine to handle flight phases, see
 //design document for the graphic representation.  Decided
 //on switch statement design rather than 2D table since this
@@ -91,9 +136,10 @@ static bool log_descent_parameters(repeating_timer_t *rt)
 //table taking up memory.
 static Error_Returns flight_state_machine()
 {
-	static Flight_Phase current_flight_phase = phase_initial;
 	static repeating_timer_t timer;
 	static Critical_Flight_Params_t critical_flight_params;
+	static bool apogee_armed = false;
+	static uint32_t last_rezero_time = 0;
 	Error_Returns to_return = RPi_Success;
 	
 	switch(current_flight_phase)
@@ -109,8 +155,21 @@ static Error_Returns flight_state_machine()
 		
 		case phase_pad_idle:  //Check to see if we have lifted off, if so start logging.
 		{			
+			if (!altimeter_is_ready())
+			{
+				//Base pressure calibration still converging, altimeter_update_altitude() steps it
+				last_rezero_time = time_us_32();
+				break;
+			}
+			
 			//When available  also transition from pad_idle to ascent when z acceleration is greater than 1G
-			if (altimeter_get_delta() >= 1)
+			int32_t delta = altimeter_get_delta();
+			if ((delta == 0) && ((time_us_32() - last_rezero_time) >= PAD_REZERO_INTERVAL))
+			{
+				altimeter_rezero();
+				last_rezero_time = time_us_32();
+			}
+			else if (delta >= 1)
 			{
 				if (!add_repeating_timer_ms(ascent_timer_interval, log_ascent_parameters, &critical_flight_params, &timer)) 
 				{
@@ -120,6 +179,8 @@ static Error_Returns flight_state_machine()
 				else
 				{
 					message_send_log("Liftoff!\n");
+					set_sampling_profile(barometer_profile_ascent);
+					set_raw_logging(true);
 					current_flight_phase = phase_ascent;
 				}
 			}
@@ -128,17 +189,34 @@ static Error_Returns flight_state_machine()
 		
 		case phase_ascent:  //Check for apogee, if found transition to descent
 		{
-			if ((critical_flight_params.maximum_altitude - critical_flight_params.current_altitude) >= APOGEE_DETECTION_DELTA)
+			//Apogee is where the fitted climb rate crosses zero, the drop from
+			//maximum altitude is kept as a backstop.
+			bool apogee_found = false;
+			int32_t climb_rate;
+			if (altitude_history_get_climb_rate(&climb_rate) == RPi_Success)
+			{
+				if (climb_rate >= APOGEE_ARMING_CLIMB_RATE)
+				{
+					apogee_armed = true;
+				}
+				apogee_found = apogee_armed && (climb_rate <= 0);
+			}
+			
+			if (apogee_found ||
+				((critical_flight_params.maximum_altitude - critical_flight_params.current_altitude) >= APOGEE_DETECTION_DELTA))
 			{
 				cancel_repeating_timer(&timer);
-				if (!add_repeating_timer_ms(descent_timer_interval, log_descent_parameters, &critical_flight_params, &timer)) 
+				if (!add_repeating_timer_ms(descent_timer_interval, mark_descent_log_due, &critical_flight_params, &timer)) 
 				{
 					message_send_log("flight_state_machine(): Failed to add log_descent_parameters timer\n");	
 					to_return = RPi_OperationFailed;					
 				}
 				else
 				{
-					message_send_log("Apogee!\n");
+					message_send_log(apogee_found ? "Apogee, climb rate!\n" : "Apogee, altitude drop!\n");
+					set_raw_logging(false);
+					set_humidity(true);  //First, so the descent sample period includes it
+					set_sampling_profile(barometer_profile_descent);
 					current_flight_phase = phase_descent;
 				}
 			}
@@ -147,10 +225,16 @@ static Error_Returns flight_state_machine()
 		
 		case phase_descent:  //Check for landing
 		{
+			if (descent_log_due)
+			{
+				log_descent_parameters();
+			}
 			if (critical_flight_params.current_altitude == 0)
 			{
 				cancel_repeating_timer(&timer);
 				message_send_log("Landed!\n");
+				set_humidity(false);
+				set_sampling_profile(barometer_profile_pad);
 				current_flight_phase = phase_ground_idle;
 			}
 			break;
@@ -170,35 +254,57 @@ static Error_Returns flight_state_machine()
 	return to_return;
 }
 
-//Basic loop to handle monitoring and control of the flight
-void flight_monitor() 
+Error_Returns flight_monitor_update()
 {
+	Error_Returns status = RPi_Success;
 	do
 	{
-		Error_Returns status = RPi_Success;
-		//Set a go indicator here
-		while (1) 
+		status = flight_state_machine();
+		if (status != RPi_Success)
 		{
-			status = flight_state_machine();
-			if (status != RPi_Success)
-			{
-				message_send_log("flight_monitor(): flight_state_machine failed: %u\n", status);
-				sleep_ms(500); //Let the message get sent...
-				break;
-			}	
+			message_send_log("flight_monitor(): flight_state_machine failed: %u\n", status);
+			break;
+		}	
 
-			status = altimeter_update_altitude();
-			if (status != RPi_Success)
-			{
-				message_send_log("flight_monitor(): altimeter_update_altitude failed: %u\n", status);
-				sleep_ms(500); //Let the message get sent...
-				break;
-			}
+		status = altimeter_update_altitude();
+		if (status != RPi_Success)
+		{
+			message_send_log("flight_monitor(): altimeter_update_altitude failed: %u\n", status);
+			break;
+		}
+
+		/* The altimeter flies on its barometers without the accelerometer, so a
+		   failure is only logged when it starts and ends, the log is blocking. */
+		Error_Returns kinematics_status = kinematics_update();
+		if ((kinematics_status != RPi_Success) && !kinematics_failing)
+		{
+			message_send_log("flight_monitor(): kinematics_update failed: %u, barometers only\n", kinematics_status);
 		}
+		else if ((kinematics_status == RPi_Success) && kinematics_failing)
+		{
+			message_send_log("flight_monitor(): kinematics_update recovered\n");
+		}
+		kinematics_failing = (kinematics_status != RPi_Success);
 	} while(0);
+	return status;
+}
+
+//Basic loop to handle monitoring and control of the flight
+void flight_monitor() 
+{
+	//Set a go indicator here
+	while (flight_monitor_update() == RPi_Success) 
+	{
+	}
+	sleep_ms(500); //Let the message get sent...
 	//Set a failure indicator here
 }
 
+Flight_Phase flight_monitor_get_phase()
+{
+	return current_flight_phase;
+}
+
 void flight_monitor_set_timer_intervals(int32_t ascent_timer_interval_ms,
 	int32_t descent_timer_interval_ms)
 {
@@ -42,6 +42,8 @@ hardware (e.g. altimeter).
 
 #define DESIRED_I2C_BAUD_RATE 400 * 1000
 #define I2C_BAUD_RATE_TOLERANCE 10  //10 percent tolerance
+#define I2C1_SDA	6
+#define I2C1_SCL	7
 
 #define DESIRED_SPI_BAUD_RATE 1000 * 1000 //500 * 1000 //Conservative because of current setup
 #define SPI_BAUD_RATE_TOLERANCE 10 //10 percent tolerance
@@ -49,50 +51,131 @@ hardware (e.g. altimeter).
 #define SPI0_MOSI	19
 #define SPI0_CLK	18
 #define SPI0_CS		17
+#define SPI0_IMU_INT	21  //ICM-20948 INT1
+#define SPI1_MISO	12
+#define SPI1_MOSI	11
+#define SPI1_CLK	10
 
 #define BAROMETER_ADDRESS 0x76
-#define BAROMETER_COUNT 1
+#define BAROMETER_SPI_CS 20  //For a barometer sharing an SPI bus
+#define BAROMETER_COUNT (sizeof(barometer_configs) / sizeof(barometer_configs[0]))
 
 #define THERMOMETER_ADDRESS 0x76
 
 //#define ACCELEROMETER_ADDRESS 0x69
 #define ACCELEROMETER_COUNT 1
 
+//A barometer is either on I2C at address or, with i2c NULL, on SPI at chip_select
+typedef struct Barometer_Config_S {
+	i2c_inst_t *i2c;
+	uint32_t address;
+	spi_inst_t *spi;
+	uint32_t chip_select;
+} Barometer_Config;
+
+/* Barometers can go on either I2C controller, each bus is read independently
+   so splitting them between i2c0 and i2c1 lets their reads overlap.  Add a
+   second chip with {i2c1, BAROMETER_ADDRESS}, or put one on SPI, sharing the
+   bus with the IMU on its own chip select, with {NULL, 0, spi0, BAROMETER_SPI_CS}.
+*/
+static const Barometer_Config barometer_configs[] = {
+	{i2c0, BAROMETER_ADDRESS, NULL, 0}
+};
+
 static uint32_t barometer_id[BAROMETER_COUNT] = {0xffffffff};
 static uint32_t acceleromter_id[ACCELEROMETER_COUNT] = {0xffffffff};
 
+static bool is_barometer_bus(i2c_inst_t *i2c, spi_inst_t *spi)
+{
+	bool to_return = false;
+	for (uint32_t index = 0; index < BAROMETER_COUNT; index++)
+	{
+		to_return |= (barometer_configs[index].i2c == NULL) ? (barometer_configs[index].spi == spi) :
+			(barometer_configs[index].i2c == i2c);
+	}
+	return to_return;
+}
+
+static Error_Returns configure_i2c(i2c_inst_t *i2c, uint sda_pin, uint scl_pin)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	uint baud_rate = i2c_init(i2c, DESIRED_I2C_BAUD_RATE);
+	if (baud_rate < DESIRED_I2C_BAUD_RATE - (DESIRED_I2C_BAUD_RATE / I2C_BAUD_RATE_TOLERANCE))
+	{
+		printf("configure_busses:  failed to configure i2c%u baud rate was %u\n", i2c_hw_index(i2c), baud_rate);
+	}
+	else
+	{
+		gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+		gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+		//Set pullups to pull the I2C bus high when idle
+		gpio_pull_up(sda_pin);
+		gpio_pull_up(scl_pin);
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+static Error_Returns configure_spi(spi_inst_t *spi, uint miso_pin, uint mosi_pin, uint clock_pin)
+{
+	Error_Returns to_return = RPi_NotInitialized;
+	uint baud_rate = spi_init(spi, DESIRED_SPI_BAUD_RATE);
+	if (baud_rate < DESIRED_SPI_BAUD_RATE - (DESIRED_SPI_BAUD_RATE / SPI_BAUD_RATE_TOLERANCE))
+	{
+		printf("configure_busses:  failed to configure spi%u baud rate was %u\n", spi_get_index(spi), baud_rate);
+	}
+	else
+	{
+		gpio_set_function(miso_pin, GPIO_FUNC_SPI);
+		gpio_set_function(clock_pin, GPIO_FUNC_SPI);
+		gpio_set_function(mosi_pin, GPIO_FUNC_SPI);
+		to_return = RPi_Success;
+	}
+	return to_return;
+}
+
+//Chip selects are active low, every chip on a shared bus has to start deselected
+static void configure_chip_select(uint chip_select)
+{
+	gpio_init(chip_select);
+	gpio_set_dir(chip_select, GPIO_OUT);
+	gpio_put(chip_select, 1);
+}
+
 static Error_Returns configure_busses()
 {
 	Error_Returns to_return = RPi_NotInitialized;
     do
 	{
-		uint baud_rate = i2c_init(i2c0, DESIRED_I2C_BAUD_RATE);
-		if (baud_rate < DESIRED_I2C_BAUD_RATE - (DESIRED_I2C_BAUD_RATE / I2C_BAUD_RATE_TOLERANCE))
+		if (configure_i2c(i2c0, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN) != RPi_Success)
 		{
-			printf("configure_busses:  failed to configure i2c baud rate was %u\n", baud_rate);
 			break;
 		}
-
-		gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
-		gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
-		//Set pullups to pull the I2C bus high when idle
-		gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
-		gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
 		
-		baud_rate = spi_init(spi0, DESIRED_SPI_BAUD_RATE);
-		if (baud_rate < DESIRED_SPI_BAUD_RATE - (DESIRED_SPI_BAUD_RATE / SPI_BAUD_RATE_TOLERANCE))
+		//Only claim the pins when something is wired to i2c1
+		if (is_barometer_bus(i2c1, NULL) && (configure_i2c(i2c1, I2C1_SDA, I2C1_SCL) != RPi_Success))
 		{
-			printf("configure_busses:  failed to configure spi baud rate was %u\n", baud_rate);
 			break;
 		}
 		
-		gpio_set_function(SPI0_MISO, GPIO_FUNC_SPI);
-		gpio_set_function(SPI0_CLK, GPIO_FUNC_SPI);
-		gpio_set_function(SPI0_MOSI, GPIO_FUNC_SPI);
+		if (configure_spi(spi0, SPI0_MISO, SPI0_MOSI, SPI0_CLK) != RPi_Success)
+		{
+			break;
+		}
+		configure_chip_select(SPI0_CS);
 		
-		gpio_init(SPI0_CS);
-		gpio_set_dir(SPI0_CS, GPIO_OUT);
-		gpio_put(SPI0_CS, 1);
+		if (is_barometer_bus(NULL, spi1) && (configure_spi(spi1, SPI1_MISO, SPI1_MOSI, SPI1_CLK) != RPi_Success))
+		{
+			break;
+		}
+		
+		for (uint32_t index = 0; index < BAROMETER_COUNT; index++)
+		{
+			if (barometer_configs[index].i2c == NULL)
+			{
+				configure_chip_select(barometer_configs[index].chip_select);
+			}
+		}
 
 		to_return = RPi_Success;
 	} while(0);
@@ -105,13 +188,18 @@ static Error_Returns configure_altimeter()
 	
 	do
 	{
-		//Current design has all barometeric chips on i2c0
-		to_return = barometer_init(&barometer_id[0], i2c0, BAROMETER_ADDRESS);
-		if (to_return != RPi_Success)
+		for (uint32_t index = 0; index < BAROMETER_COUNT; index++)
 		{
-			message_send_log("configure_altimeter():  barometer_init failed: %u\n", to_return);
-			break;
+			const Barometer_Config *config_ptr = &barometer_configs[index];
+			to_return = (config_ptr->i2c != NULL) ? barometer_init(&barometer_id[index], config_ptr->i2c, config_ptr->address) :
+				barometer_init_spi(&barometer_id[index], config_ptr->spi, config_ptr->chip_select);
+			if (to_return != RPi_Success)
+			{
+				message_send_log("configure_altimeter():  barometer_init %u failed: %u\n", index, to_return);
+				break;
+			}
 		}
+		if (to_return != RPi_Success) break;
 		
 		to_return = altimeter_initialize(&barometer_id[0], BAROMETER_COUNT);
 		if (to_return != RPi_Success)
@@ -135,7 +223,7 @@ static Error_Returns configure_kinematics()
 	do
 	{
 		//Current design has all accelerometers, gyroscopes, etc. chips on spi0
-		to_return = accelerometer_init(&acceleromter_id[0], spi0, SPI0_CS);
+		to_return = accelerometer_init(&acceleromter_id[0], spi0, SPI0_CS, SPI0_IMU_INT);
 		if (to_return != RPi_Success)
 		{
 			message_send_log("configure_kinematics():  accelerometer_init failed: %u\n", to_return);
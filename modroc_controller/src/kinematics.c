@@ -23,10 +23,33 @@ File:  altimeter.c
 
 #include "kinematics.h"
 #include "accelerometer.h"
+#include "altimeter.h"
 #include "message.h"
 
+#define STANDARD_GRAVITY	9807  //In millimeters/second2
+
 static uint32_t accelerometer_count = 0;
 static uint32_t accelerometer_ids[ACCELEROMETER_NUMBER_SUPPORTED_DEVICES];
+static uint32_t accelerometer_sequences[ACCELEROMETER_NUMBER_SUPPORTED_DEVICES];  //Of the last sample fed to the altimeter
+
+/* Orientation isn't tracked yet so the airframe's Z axis is taken as vertical,
+   which holds nose up on the pad and through the ascent.  Samples are only fed
+   once the altimeter has a base pressure, its estimator is reset then.
+*/
+static Error_Returns feed_altimeter(uint32_t count)
+{
+	Accelerometer_Sample_t sample;
+	Error_Returns to_return = accelerometer_get_sample(accelerometer_ids[count], &sample);
+	if ((to_return == RPi_Success) && (sample.sequence != accelerometer_sequences[count]))
+	{
+		accelerometer_sequences[count] = sample.sequence;
+		if (altimeter_is_ready())
+		{
+			to_return = altimeter_update_acceleration(sample.acceleration[2] - STANDARD_GRAVITY, sample.time_stamp);
+		}
+	}
+	return to_return;
+}
 
 Error_Returns kinematics_initialize(uint32_t *accelerometer_id_array, uint32_t number_of_accelerometers)
 {
@@ -66,8 +89,31 @@ Error_Returns kinematics_reset()
 				message_send_log("kinematics_reset:  Failed to reset accel %u\n", count);
 				break;
 			}
+			accelerometer_sequences[count] = 0;
 			count++;
 		} while(count < accelerometer_count);
 	}
 	return to_return;
-}
\ No newline at end of file
+}
+
+Error_Returns kinematics_update()
+{
+	Error_Returns to_return = RPi_Success;
+	for (uint32_t count = 0; count < accelerometer_count; count++)
+	{
+		to_return = accelerometer_update(accelerometer_ids[count]);
+		if (to_return != RPi_Success)
+		{
+			message_send_log("kinematics_update:  Failed to update accel %u\n", count);
+			break;
+		}
+		
+		to_return = feed_altimeter(count);
+		if (to_return != RPi_Success)
+		{
+			message_send_log("kinematics_update:  Failed to feed accel %u to the altimeter\n", count);
+			break;
+		}
+	}
+	return to_return;
+}
@@ -25,8 +25,30 @@ File:  output_task.c
 #include "pico/stdlib.h"
 
 #include "common.h"
+#include "barometer.h"
 #include "output_task.h"
 
+//Raw barometer samples are compensated here so core 0 only does the ones it flies on
+static void log_raw_batch(uint32_t id, Barometer_Raw_Batch *batch_ptr)
+{
+	uint32_t pressure;
+	int32_t temperature;
+	
+	if (batch_ptr->dropped)
+	{
+		printf("barometer %u: %u raw sample batches dropped\n", id, batch_ptr->dropped);
+	}
+	for (uint32_t index = 0; index < batch_ptr->count; index++)
+	{
+		Barometer_Raw_Sample *sample_ptr = &batch_ptr->samples[index];
+		if (barometer_compensate_raw_sample(id, sample_ptr, &pressure, &temperature) == RPi_Success)
+		{
+			printf("%u: barometer %u pressure: %u temperature: %d raw: %d %d\n", sample_ptr->time_stamp / 1000, id,
+				pressure, temperature, sample_ptr->raw_pressure, sample_ptr->raw_temperature);
+		}
+	}
+}
+
 void output_task() {
 
 	do
@@ -35,21 +57,23 @@ void output_task() {
 		{
 			Intertask_Param_Message_t param_entry;
 			Log_Message_t log_entry;
+			Barometer_Raw_Batch raw_batch;
 
 			if (message_log_get_params(&param_entry))
 			{
 				switch (param_entry.message_type)
 				{
 					case message_log_ascent_parameters:
-						printf("%u: altitude: %d z accel: %hu z velocity %hu\n", 
+						printf("%u: altitude: %d z accel: %hd z velocity %hd\n", 
 						   param_entry.time_stamp, param_entry.message.log_ascent_parameters.altitude, 
 						   param_entry.message.log_ascent_parameters.z_acceleration,
 						   param_entry.message.log_ascent_parameters.z_velocity);				
 						break;
 					
 					case message_log_descent_parameters:
-						printf("%u: altitude %d temperature: %f\n", 
-						   param_entry.time_stamp, param_entry.message.log_descent_parameters.altitude, param_entry.message.log_descent_parameters.temperature);
+						printf("%u: altitude %d temperature: %f humidity: %f\n", 
+						   param_entry.time_stamp, param_entry.message.log_descent_parameters.altitude, param_entry.message.log_descent_parameters.temperature,
+						   param_entry.message.log_descent_parameters.humidity);
 						break;
 					default:
 						message_send_log("output_task:  Rx'd unknown message %u\n", param_entry.message_type);
@@ -61,6 +85,14 @@ void output_task() {
 			{
 				printf("%u: %s", log_entry.time_stamp, log_entry.log_message);
 			}
+			
+			for (uint32_t id = 0; id < BAROMETER_NUMBER_SUPPORTED_DEVICES; id++)
+			{
+				if (barometer_get_raw_batch(id, &raw_batch))
+				{
+					log_raw_batch(id, &raw_batch);
+				}
+			}
 		}
 	} while(0);
 
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  generate_altitude_table.py
+
+Generates altitude_table.h, the pressure ratio to altitude lookup table used by
+altitude_kernel.c.  Run by the build, the output goes into the build directory.
+
+The table holds the barometric formula from the Bosch BMP180 datasheet,
+44330 * (1 - ratio^0.1902225603956629), in millimeters at evenly spaced
+pressure ratios.  The integer interpolation done by altitude_kernel.c is
+replayed here across the whole table range and the worst case error against
+the formula is written into the header.  Generation fails if that error
+exceeds MAXIMUM_ERROR_MM.
+
+A second table holds ln(ratio) at the same points for the hypsometric model,
+its worst case error is written as the altitude error it causes at
+LOG_ERROR_TEMPERATURE_K and checked against LOG_MAXIMUM_ERROR_MM.
+"""
+
+import math
+import sys
+
+MAGIC_EXPONENT = 0.1902225603956629
+MAGIC_MULTIPLIER = 44330.0
+
+# These must match altitude_kernel.h
+RATIO_FRACTION_BITS = 30
+RATIO_MINIMUM = 0.25
+INDEX_BITS = 9
+INTERPOLATION_BITS = 14
+LOG_FRACTION_BITS = 23
+
+MAXIMUM_ERROR_MM = 50
+LOG_MAXIMUM_ERROR_MM = 100
+
+# Dry air gas constant over standard gravity, meters per kelvin
+GAS_CONSTANT_OVER_GRAVITY = 287.053 / 9.80665
+LOG_ERROR_TEMPERATURE_K = 300.0
+
+SEGMENTS = 1 << INDEX_BITS
+SEGMENT_SHIFT = RATIO_FRACTION_BITS - INDEX_BITS
+INTERPOLATION_SHIFT = SEGMENT_SHIFT - INTERPOLATION_BITS
+RATIO_ONE = 1 << RATIO_FRACTION_BITS
+RATIO_MINIMUM_Q = int(RATIO_MINIMUM * RATIO_ONE)
+
+
+def formula_mm(ratio):
+    return MAGIC_MULTIPLIER * (1.0 - ratio ** MAGIC_EXPONENT) * 1000.0
+
+
+def log_ratio_q(ratio):
+    return math.log(ratio) * (1 << LOG_FRACTION_BITS)
+
+
+def build_table(function):
+    table = []
+    for index in range(SEGMENTS + 1):
+        ratio = (RATIO_MINIMUM_Q + (index << SEGMENT_SHIFT)) / RATIO_ONE
+        table.append(int(round(function(ratio))))
+    return table
+
+
+def kernel_mm(table, ratio_q):
+    # Mirrors altitude_kernel_get_altitude() for ratios inside the table
+    offset = ratio_q - RATIO_MINIMUM_Q
+    index = offset >> SEGMENT_SHIFT
+    fraction = (offset >> INTERPOLATION_SHIFT) & ((1 << INTERPOLATION_BITS) - 1)
+    low = table[index]
+    step = table[index + 1] - low
+    # C right shift of a negative product rounds toward minus infinity, as does Python
+    return low + ((step * fraction) >> INTERPOLATION_BITS)
+
+
+def worst_case_error(table, function):
+    worst = 0.0
+    samples_per_segment = 257
+    for index in range(SEGMENTS):
+        base = RATIO_MINIMUM_Q + (index << SEGMENT_SHIFT)
+        for sample in range(samples_per_segment):
+            ratio_q = base + ((sample << SEGMENT_SHIFT) // samples_per_segment)
+            error = abs(kernel_mm(table, ratio_q) - function(ratio_q / RATIO_ONE))
+            worst = max(worst, error)
+    return worst
+
+
+def append_table(lines, name, table):
+    lines.append("static const int32_t %s[ALTITUDE_TABLE_SEGMENTS + 1] = {" % name)
+    for start in range(0, len(table), 8):
+        row = ", ".join("%d" % value for value in table[start:start + 8])
+        lines.append("\t" + row + ",")
+    lines.append("};")
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: generate_altitude_table.py <output header>")
+        return 1
+
+    table = build_table(formula_mm)
+    error_mm = worst_case_error(table, formula_mm)
+    if error_mm > MAXIMUM_ERROR_MM:
+        print("generate_altitude_table.py: table error %.1f mm exceeds %d mm" %
+              (error_mm, MAXIMUM_ERROR_MM))
+        return 1
+
+    log_table = build_table(log_ratio_q)
+    log_error_mm = (worst_case_error(log_table, log_ratio_q) / (1 << LOG_FRACTION_BITS) *
+                    GAS_CONSTANT_OVER_GRAVITY * LOG_ERROR_TEMPERATURE_K * 1000.0)
+    if log_error_mm > LOG_MAXIMUM_ERROR_MM:
+        print("generate_altitude_table.py: log table error %.1f mm exceeds %d mm" %
+              (log_error_mm, LOG_MAXIMUM_ERROR_MM))
+        return 1
+
+    lines = []
+    lines.append("/* Generated by tools/generate_altitude_table.py, do not edit. */")
+    lines.append("")
+    lines.append("#pragma once")
+    lines.append("#include <stdint.h>")
+    lines.append("")
+    lines.append("#define ALTITUDE_TABLE_SEGMENTS %d" % SEGMENTS)
+    lines.append("//Worst case difference from the floating point formula, in millimeters")
+    lines.append("#define ALTITUDE_TABLE_MAXIMUM_ERROR_MM %d" % (int(error_mm) + 1))
+    lines.append("")
+    lines.append("//Worst case hypsometric altitude difference caused by the log table at %d K, in millimeters" %
+                 LOG_ERROR_TEMPERATURE_K)
+    lines.append("#define LOG_RATIO_TABLE_MAXIMUM_ERROR_MM %d" % (int(log_error_mm) + 1))
+    lines.append("")
+    append_table(lines, "altitude_table", table)
+    lines.append("")
+    lines.append("//ln(pressure ratio) in Q8.%d" % LOG_FRACTION_BITS)
+    append_table(lines, "log_ratio_table", log_table)
+
+    with open(sys.argv[1], "w") as output:
+        output.write("\n".join(lines) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
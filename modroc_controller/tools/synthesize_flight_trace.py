@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""Copyright 2022 Eric Baxter <ericwbaxter85@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+File:  synthesize_flight_trace.py
+
+Writes a barometer trace, in the format described in host/src/trace.h, for a
+simulated flight so the host replay harness has something with a known ground
+truth to run against.
+
+The flight sits on the pad, boosts at a constant thrust, coasts against
+quadratic drag to apogee, then comes down under a parachute at its terminal
+rate and sits on the ground again.  The atmosphere has a constant lapse rate
+and can be offset from the standard temperature.  Pressure noise is added
+before the pressure and temperature are turned back into the raw ADC values a
+BME280 with the calibration below would report, by searching over the
+integer compensation formulas bme280_compensation.c uses.  The accelerometer
+is flown nose up the whole way, its noise comes from a generator of its own so
+the pressure noise for a seed doesn't depend on the accelerometer options.
+"""
+
+import argparse
+import math
+import random
+import sys
+
+GRAVITY = 9.80665
+GAS_CONSTANT = 287.053
+STANDARD_SEA_LEVEL_TEMPERATURE = 288.15
+STANDARD_SEA_LEVEL_PRESSURE = 101325.0
+LAPSE_RATE = 0.0065
+
+# Calibration from the Bosch datasheet's compensation example, humidity values
+# are typical of a real part
+CALIBRATION = {
+    "T1": 27504, "T2": 26435, "T3": -1000,
+    "P1": 36477, "P2": -10685, "P3": 3024, "P4": 2855, "P5": 140,
+    "P6": -7, "P7": 15500, "P8": -14600, "P9": 6000,
+    "H1": 75, "H2": 362, "H3": 0, "H4": 313, "H5": 50, "H6": 30,
+}
+
+ADC_MAXIMUM = (1 << 20) - 1
+SIMULATION_STEP = 0.001  # In seconds
+
+
+def c_divide(numerator, denominator):
+    # C integer division truncates toward zero, Python's floors
+    quotient = abs(numerator) // abs(denominator)
+    return quotient if (numerator >= 0) == (denominator >= 0) else -quotient
+
+
+def compensate_temperature(adc_t):
+    # Mirrors bme280_compensate_temperature(), returns (hundredths C, t_fine)
+    var1 = c_divide((adc_t // 8 - CALIBRATION["T1"] * 2) * CALIBRATION["T2"], 2048)
+    var2 = adc_t // 16 - CALIBRATION["T1"]
+    var2 = c_divide(c_divide(var2 * var2, 4096) * CALIBRATION["T3"], 16384)
+    t_fine = var1 + var2
+    temperature = c_divide(t_fine * 5 + 128, 256)
+    return max(-4000, min(8500, temperature)), t_fine
+
+
+def compensate_pressure(adc_p, t_fine):
+    # Mirrors bme280_compensate_pressure_64bit(), returns pascals * 100
+    var1 = t_fine - 128000
+    var2 = var1 * var1 * CALIBRATION["P6"]
+    var2 = var2 + var1 * CALIBRATION["P5"] * 131072
+    var2 = var2 + CALIBRATION["P4"] * 34359738368
+    var1 = c_divide(var1 * var1 * CALIBRATION["P3"], 256) + var1 * CALIBRATION["P2"] * 4096
+    var1 = c_divide((140737488355328 + var1) * CALIBRATION["P1"], 8589934592)
+    if var1 == 0:
+        return 3000000
+    var4 = 1048576 - adc_p
+    var4 = c_divide((var4 * 2147483648 - var2) * 3125, var1)
+    var1 = c_divide(CALIBRATION["P9"] * c_divide(var4, 8192) * c_divide(var4, 8192), 33554432)
+    var2 = c_divide(CALIBRATION["P8"] * var4, 524288)
+    var4 = c_divide(var4 + var1 + var2, 256) + CALIBRATION["P7"] * 16
+    pressure = c_divide(c_divide(var4, 2) * 100, 128)
+    return max(3000000, min(11000000, pressure))
+
+
+def search_adc(target, function, increasing):
+    # Binary search for the ADC value whose compensated output is closest to target
+    low, high = 0, ADC_MAXIMUM
+    while low < high:
+        middle = (low + high) // 2
+        if (function(middle) < target) == increasing:
+            low = middle + 1
+        else:
+            high = middle
+    candidates = [value for value in (low - 1, low) if 0 <= value <= ADC_MAXIMUM]
+    return min(candidates, key=lambda value: abs(function(value) - target))
+
+
+def raw_adc(pressure, temperature):
+    adc_t = search_adc(round(temperature * 100.0),
+                       lambda value: compensate_temperature(value)[0], True)
+    t_fine = compensate_temperature(adc_t)[1]
+    adc_p = search_adc(round(pressure * 100.0),
+                       lambda value: compensate_pressure(value, t_fine), False)
+    return adc_p, adc_t
+
+
+def calibration_bytes():
+    def little_endian(value):
+        return list((value & 0xFFFF).to_bytes(2, "little"))
+
+    pressure_temperature = []
+    for name in ("T1", "T2", "T3", "P1", "P2", "P3", "P4", "P5", "P6", "P7", "P8", "P9"):
+        pressure_temperature += little_endian(CALIBRATION[name])
+    pressure_temperature += [0, CALIBRATION["H1"]]  # 0xA0 is unused, 0xA1 is H1
+
+    h4 = CALIBRATION["H4"]
+    h5 = CALIBRATION["H5"]
+    humidity = little_endian(CALIBRATION["H2"])
+    humidity += [CALIBRATION["H3"], (h4 >> 4) & 0xFF, (h4 & 0x0F) | ((h5 & 0x0F) << 4),
+                 (h5 >> 4) & 0xFF, CALIBRATION["H6"] & 0xFF]
+    return bytes(pressure_temperature).hex(), bytes(humidity).hex()
+
+
+class Atmosphere:
+    def __init__(self, site_elevation, temperature_offset):
+        self.site_temperature = (STANDARD_SEA_LEVEL_TEMPERATURE + temperature_offset -
+                                 LAPSE_RATE * site_elevation)
+        standard_site_temperature = STANDARD_SEA_LEVEL_TEMPERATURE - LAPSE_RATE * site_elevation
+        self.site_pressure = STANDARD_SEA_LEVEL_PRESSURE * (
+            standard_site_temperature / STANDARD_SEA_LEVEL_TEMPERATURE) ** (GRAVITY / (GAS_CONSTANT * LAPSE_RATE))
+
+    def temperature(self, altitude):
+        return self.site_temperature - LAPSE_RATE * altitude
+
+    def pressure(self, altitude):
+        return self.site_pressure * (self.temperature(altitude) / self.site_temperature) ** (
+            GRAVITY / (GAS_CONSTANT * LAPSE_RATE))
+
+
+def simulate_flight(arguments):
+    # Returns [(time, altitude, acceleration)] every SIMULATION_STEP along with apogee and landing
+    drag = GRAVITY / (arguments.coast_terminal_velocity ** 2)
+    parachute_drag = GRAVITY / (arguments.descent_rate ** 2)
+    time = 0.0
+    altitude = 0.0
+    velocity = 0.0
+    apogee = None
+    landing = None
+    path = []
+    acceleration = 0.0
+    while True:
+        path.append((time, altitude, acceleration))
+        if landing is not None and time >= landing[0] + arguments.ground_time:
+            break
+
+        flight_time = time - arguments.pad_time
+        if flight_time < 0 or landing is not None:
+            acceleration = 0.0
+        else:
+            thrust = arguments.thrust if flight_time < arguments.burn_time else 0.0
+            if apogee is None:
+                acceleration = thrust - GRAVITY - drag * velocity * abs(velocity)
+            else:
+                acceleration = -GRAVITY - parachute_drag * velocity * abs(velocity)
+
+        previous_velocity = velocity
+        velocity += acceleration * SIMULATION_STEP
+        altitude += velocity * SIMULATION_STEP
+        time += SIMULATION_STEP
+
+        if apogee is None and flight_time > arguments.burn_time and previous_velocity > 0 >= velocity:
+            apogee = (time, altitude)
+        if apogee is not None and landing is None and altitude <= 0.0:
+            altitude = 0.0
+            velocity = 0.0
+            landing = (time, altitude)
+    return path, apogee, landing
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Writes a synthetic BME280 flight trace")
+    parser.add_argument("output")
+    parser.add_argument("--rate", type=float, default=200.0, help="samples per second")
+    parser.add_argument("--noise", type=float, default=2.0, help="pressure noise, pascals rms")
+    parser.add_argument("--acceleration-rate", type=float, default=100.0, help="accelerometer samples per second")
+    parser.add_argument("--acceleration-noise", type=float, default=0.2, help="meters/second2 rms per axis")
+    parser.add_argument("--temperature-offset", type=float, default=0.0,
+                        help="kelvin warmer than the standard atmosphere")
+    parser.add_argument("--site-elevation", type=float, default=300.0, help="meters")
+    parser.add_argument("--pad-time", type=float, default=10.0, help="seconds")
+    parser.add_argument("--thrust", type=float, default=80.0, help="meters/second2")
+    parser.add_argument("--burn-time", type=float, default=1.6, help="seconds")
+    parser.add_argument("--coast-terminal-velocity", type=float, default=150.0, help="meters/second")
+    parser.add_argument("--descent-rate", type=float, default=6.0, help="meters/second")
+    parser.add_argument("--ground-time", type=float, default=5.0, help="seconds")
+    parser.add_argument("--seed", type=int, default=1)
+    arguments = parser.parse_args()
+
+    random.seed(arguments.seed)
+    acceleration_random = random.Random(arguments.seed)
+    atmosphere = Atmosphere(arguments.site_elevation, arguments.temperature_offset)
+    path, apogee, landing = simulate_flight(arguments)
+    calibration, humidity_calibration = calibration_bytes()
+
+    with open(arguments.output, "w") as output:
+        output.write("# Synthesized by tools/synthesize_flight_trace.py %s\n" % " ".join(sys.argv[2:]))
+        output.write("calibration %s %s\n" % (calibration, humidity_calibration))
+        output.write("apogee %d %d\n" % (round(apogee[0] * 1e6), round(apogee[1] * 1000)))
+        output.write("landing %d\n" % round(landing[0] * 1e6))
+
+        steps_per_sample = max(1, round(1.0 / (arguments.rate * SIMULATION_STEP)))
+        steps_per_acceleration = max(1, round(1.0 / (arguments.acceleration_rate * SIMULATION_STEP)))
+        for step, (time, altitude, acceleration) in enumerate(path):
+            if step % steps_per_sample == 0:
+                pressure = atmosphere.pressure(altitude) + random.gauss(0.0, arguments.noise)
+                adc_p, adc_t = raw_adc(pressure, atmosphere.temperature(altitude) - 273.15)
+                output.write("sample %d %d %d %d\n" % (round(time * 1e6), adc_p, adc_t, round(altitude * 1000)))
+            if step % steps_per_acceleration == 0:
+                # The specific force, what an accelerometer reads, is +1 g at rest
+                force = [acceleration_random.gauss(0.0, arguments.acceleration_noise) for axis in range(3)]
+                force[2] += acceleration + GRAVITY
+                output.write("acceleration %d %d %d %d\n" % (round(time * 1e6),
+                                                            *(round(axis * 1000) for axis in force)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())